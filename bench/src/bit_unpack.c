@@ -0,0 +1,103 @@
+/* Compare the layout 2 probability decoding through `bgen_unpack_bits` against the former
+ * bit-by-bit extraction followed by a division. */
+#include "unpack.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NVALUES (1 << 22)
+#define BLOCK 2048
+#define NREPEATS 5
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static inline int get_bit(char const* mem, uint64_t bit_idx)
+{
+    return (mem[bit_idx / 8] & (1 << (bit_idx % 8))) != 0;
+}
+
+static void decode_reference(double* dst, char const* chunk, size_t n, unsigned nbits)
+{
+    double   denom = (double)((((uint64_t)1 << nbits)) - 1);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t ui_prob = 0;
+        for (uint8_t bi = 0; bi < nbits; ++bi) {
+            if (get_bit(chunk, bi + offset))
+                ui_prob |= ((uint64_t)1 << bi);
+        }
+        dst[i] = (double)ui_prob / denom;
+        offset += nbits;
+    }
+}
+
+static void decode_unpack(double* dst, char const* chunk, char const* end, size_t n,
+                          unsigned nbits)
+{
+    double   inv = 1 / (double)((((uint64_t)1 << nbits)) - 1);
+    uint32_t values[BLOCK];
+    for (size_t i = 0; i < n; i += BLOCK) {
+        size_t m = n - i < BLOCK ? n - i : BLOCK;
+        bgen_unpack_bits(values, chunk, end, i * nbits, m, nbits);
+        for (size_t j = 0; j < m; ++j)
+            dst[i + j] = (double)values[j] * inv;
+    }
+}
+
+static double seconds(clock_t start) { return (double)(clock() - start) / CLOCKS_PER_SEC; }
+
+int main(void)
+{
+    unsigned const nbits_list[] = {1, 2, 8, 10, 16, 23, 32};
+    double*        expected = malloc(NVALUES * sizeof(double));
+    double*        actual = malloc(NVALUES * sizeof(double));
+    int            status = 0;
+
+    printf("%6s %16s %16s %8s\n", "nbits", "bit loop (ns)", "unpack (ns)", "speedup");
+    for (size_t k = 0; k < sizeof(nbits_list) / sizeof(nbits_list[0]); ++k) {
+        unsigned nbits = nbits_list[k];
+        size_t   size = ((size_t)NVALUES * nbits + 7) / 8;
+        char*    chunk = malloc(size);
+        for (size_t i = 0; i < size; ++i)
+            chunk[i] = (char)next_random();
+
+        double  reference = INFINITY;
+        double  unpack = INFINITY;
+        clock_t start;
+        for (int r = 0; r < NREPEATS; ++r) {
+            start = clock();
+            decode_reference(expected, chunk, NVALUES, nbits);
+            reference = fmin(reference, seconds(start));
+
+            start = clock();
+            decode_unpack(actual, chunk, chunk + size, NVALUES, nbits);
+            unpack = fmin(unpack, seconds(start));
+        }
+
+        for (size_t i = 0; i < NVALUES; ++i) {
+            if (fabs(actual[i] - expected[i]) > DBL_EPSILON) {
+                fprintf(stderr, "mismatch at %zu for %u bits\n", i, nbits);
+                status = 1;
+                break;
+            }
+        }
+
+        printf("%6u %16.3f %16.3f %7.1fx\n", nbits, 1e9 * reference / NVALUES,
+               1e9 * unpack / NVALUES, reference / unpack);
+        free(chunk);
+    }
+
+    free(expected);
+    free(actual);
+    return status;
+}
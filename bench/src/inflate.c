@@ -0,0 +1,257 @@
+/* Compare the zlib and libdeflate backends at inflating the genotype blocks of layout 2
+ * files (compression flag 1), and of a large synthetic file. */
+#include <libdeflate.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define NREPEATS 5
+#define SYNTHETIC_NSAMPLES 500000
+#define SYNTHETIC_NVARIANTS 16
+
+struct block
+{
+    unsigned char const* data;
+    size_t               size;
+    size_t               inflated_size;
+};
+
+struct blocks
+{
+    struct block*  items;
+    size_t         count;
+    size_t         inflated_size; /* Sum over all blocks. */
+    unsigned char* storage;
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15;
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static uint32_t read_u32(unsigned char const* p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint16_t read_u16(unsigned char const* p)
+{
+    uint16_t v = 0;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void add_block(struct blocks* blocks, unsigned char const* data, size_t size,
+                      size_t inflated_size)
+{
+    struct block* items = realloc(blocks->items, (blocks->count + 1) * sizeof(struct block));
+    if (items == NULL)
+        exit(1);
+    blocks->items = items;
+    blocks->items[blocks->count++] = (struct block){data, size, inflated_size};
+    blocks->inflated_size += inflated_size;
+}
+
+/* Collect the compressed genotype blocks of a layout 2, zlib-compressed bgen file. */
+static int load_file(char const* filepath, struct blocks* blocks)
+{
+    FILE* fp = fopen(filepath, "rb");
+    if (fp == NULL)
+        return 1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char* mem = malloc((size_t)size);
+    if (mem == NULL || fread(mem, 1, (size_t)size, fp) != (size_t)size) {
+        fclose(fp);
+        free(mem);
+        return 1;
+    }
+    fclose(fp);
+    blocks->storage = mem;
+
+    uint32_t header_length = read_u32(mem + 4);
+    uint32_t nvariants = read_u32(mem + 8);
+    uint32_t flags = read_u32(mem + 4 + header_length - 4);
+    if ((flags & 3) != 1 || ((flags >> 2) & 15) != 2)
+        return 1;
+
+    unsigned char const* p = mem + 4 + read_u32(mem);
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        for (int i = 0; i < 3; ++i)
+            p += 2 + read_u16(p);
+        p += 4;
+        uint16_t nalleles = read_u16(p);
+        p += 2;
+        for (uint16_t i = 0; i < nalleles; ++i)
+            p += 4 + read_u32(p);
+
+        uint32_t length = read_u32(p);
+        add_block(blocks, p + 8, length - 4, read_u32(p + 4));
+        p += 4 + length;
+    }
+    return 0;
+}
+
+/* Biallelic, diploid, unphased variants stored with 8 bits, most genotypes being certain. */
+static void make_synthetic(struct blocks* blocks)
+{
+    size_t const   nsamples = SYNTHETIC_NSAMPLES;
+    size_t const   inflated_size = 10 + nsamples + 2 * nsamples;
+    unsigned char* raw = malloc(inflated_size);
+    uLong const    bound = compressBound((uLong)inflated_size);
+    unsigned char* storage = malloc(SYNTHETIC_NVARIANTS * bound);
+    if (raw == NULL || storage == NULL)
+        exit(1);
+    blocks->storage = storage;
+
+    for (size_t v = 0; v < SYNTHETIC_NVARIANTS; ++v) {
+        uint32_t n = SYNTHETIC_NSAMPLES;
+        uint16_t nalleles = 2;
+        memcpy(raw, &n, 4);
+        memcpy(raw + 4, &nalleles, 2);
+        raw[6] = 2;
+        raw[7] = 2;
+        memset(raw + 8, 2, nsamples);
+        raw[8 + nsamples] = 0;
+        raw[9 + nsamples] = 8;
+
+        unsigned char* probs = raw + 10 + nsamples;
+        for (size_t j = 0; j < nsamples; ++j) {
+            uint64_t r = next_random();
+            unsigned first = (unsigned)(r % 3 == 0 ? 255 : 0);
+            unsigned second = (unsigned)(r % 3 == 1 ? 255 : 0);
+            if ((r >> 8) % 10 == 0) {
+                first = (unsigned)((r >> 16) % 256);
+                second = (unsigned)((r >> 24) % (256 - first));
+            }
+            probs[2 * j] = (unsigned char)first;
+            probs[2 * j + 1] = (unsigned char)second;
+        }
+
+        unsigned char* dst = storage + v * bound;
+        uLongf         size = bound;
+        if (compress2(dst, &size, raw, (uLong)inflated_size, Z_DEFAULT_COMPRESSION) != Z_OK)
+            exit(1);
+        add_block(blocks, dst, size, inflated_size);
+    }
+    free(raw);
+}
+
+static int inflate_zlib(z_stream* strm, struct block const* block, unsigned char* dst)
+{
+    inflateReset(strm);
+    strm->next_in = (unsigned char*)block->data;
+    strm->avail_in = (unsigned)block->size;
+    strm->next_out = dst;
+    strm->avail_out = (unsigned)block->inflated_size;
+    return inflate(strm, Z_FINISH) != Z_STREAM_END;
+}
+
+static int inflate_libdeflate(struct libdeflate_decompressor* decompressor,
+                              struct block const* block, unsigned char* dst)
+{
+    return libdeflate_zlib_decompress(decompressor, block->data, block->size, dst,
+                                      block->inflated_size, NULL) != LIBDEFLATE_SUCCESS;
+}
+
+static double seconds(clock_t start) { return (double)(clock() - start) / CLOCKS_PER_SEC; }
+
+static int run(char const* name, struct blocks const* blocks)
+{
+    size_t largest = 0;
+    for (size_t i = 0; i < blocks->count; ++i)
+        largest = blocks->items[i].inflated_size > largest ? blocks->items[i].inflated_size
+                                                           : largest;
+
+    unsigned char* expected = malloc(largest);
+    unsigned char* actual = malloc(largest);
+    z_stream       strm;
+    memset(&strm, 0, sizeof(strm));
+    inflateInit(&strm);
+    struct libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
+
+    int status = 0;
+    for (size_t i = 0; i < blocks->count; ++i) {
+        struct block const* block = blocks->items + i;
+        status |= inflate_zlib(&strm, block, expected);
+        status |= inflate_libdeflate(decompressor, block, actual);
+        status |= memcmp(expected, actual, block->inflated_size) != 0;
+    }
+    if (status)
+        fprintf(stderr, "%s: backends disagree\n", name);
+
+    double  zlib = INFINITY;
+    double  libdeflate = INFINITY;
+    clock_t start;
+    for (int r = 0; r < NREPEATS; ++r) {
+        start = clock();
+        for (size_t i = 0; i < blocks->count; ++i)
+            inflate_zlib(&strm, blocks->items + i, actual);
+        zlib = fmin(zlib, seconds(start));
+
+        start = clock();
+        for (size_t i = 0; i < blocks->count; ++i)
+            inflate_libdeflate(decompressor, blocks->items + i, actual);
+        libdeflate = fmin(libdeflate, seconds(start));
+    }
+
+    double megabytes = (double)blocks->inflated_size / 1e6;
+    printf("%-32s %8zu %14.1f %18.1f %7.1fx\n", name, blocks->count, megabytes / zlib,
+           megabytes / libdeflate, zlib / libdeflate);
+
+    libdeflate_free_decompressor(decompressor);
+    inflateEnd(&strm);
+    free(actual);
+    free(expected);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    char const*  default_files[] = {BENCH_DATADIR "example.14bits.bgen",
+                                    BENCH_DATADIR "example.32bits.bgen",
+                                    BENCH_DATADIR "complex.23bits.bgen"};
+    char const** files = default_files;
+    size_t       nfiles = sizeof(default_files) / sizeof(default_files[0]);
+    if (argc > 1) {
+        files = (char const**)(argv + 1);
+        nfiles = (size_t)(argc - 1);
+    }
+
+    int status = 0;
+    printf("%-32s %8s %14s %18s %8s\n", "data", "blocks", "zlib (MB/s)", "libdeflate (MB/s)",
+           "speedup");
+
+    for (size_t i = 0; i < nfiles; ++i) {
+        struct blocks blocks = {NULL, 0, 0, NULL};
+        char const*   name = strrchr(files[i], '/') ? strrchr(files[i], '/') + 1 : files[i];
+        if (load_file(files[i], &blocks)) {
+            fprintf(stderr, "%s: not a zlib-compressed layout 2 file\n", files[i]);
+            status = 1;
+        } else {
+            status |= run(name, &blocks);
+        }
+        free(blocks.items);
+        free(blocks.storage);
+    }
+
+    struct blocks blocks = {NULL, 0, 0, NULL};
+    make_synthetic(&blocks);
+    status |= run("synthetic (500k samples)", &blocks);
+    free(blocks.items);
+    free(blocks.storage);
+
+    return status;
+}
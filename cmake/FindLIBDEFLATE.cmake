@@ -0,0 +1,81 @@
+# FindLIBDEFLATE
+# --------------
+#
+# Find libdeflate include dirs and libraries
+#
+# This module reads hints about search locations from variables::
+#
+#   LIBDEFLATE_INCLUDEDIR - Preferred include directory e.g. <prefix>/include
+#   LIBDEFLATE_LIBRARYDIR - Preferred library directory e.g. <prefix>/lib
+#
+# IMPORTED Targets
+# ^^^^^^^^^^^^^^^^
+#
+# This module defines :prop_tgt:`IMPORTED` target ``LIBDEFLATE::libdeflate``, if
+# libdeflate has been found.
+#
+# Result Variables
+# ^^^^^^^^^^^^^^^^
+#
+# This module defines the following variables:
+#
+# ::
+#
+#   LIBDEFLATE_INCLUDE_DIR - Where to find the header files.
+#   LIBDEFLATE_LIBRARY     - Library when using libdeflate.
+#   LIBDEFLATE_FOUND       - True if libdeflate library is found.
+
+
+set(libdeflate_incl_dirs "/usr/include" "/usr/local/include")
+if(${CMAKE_SYSTEM_NAME} MATCHES "Windows")
+    set(_LIBDEFLATE_x86 "(x86)")
+    set(libdeflate_incl_dirs ${libdeflate_incl_dirs} "$ENV{PROGRAMFILES}/libdeflate/include")
+    set(libdeflate_incl_dirs ${libdeflate_incl_dirs} "$ENV{PROGRAMFILES${_LIBDEFLATE_x86}}/libdeflate/include")
+    unset(_LIBDEFLATE_x86)
+endif()
+
+if(LIBDEFLATE_INCLUDEDIR)
+    list(APPEND libdeflate_incl_dirs ${LIBDEFLATE_INCLUDEDIR})
+endif()
+
+find_path(
+    LIBDEFLATE_INCLUDE_DIR
+    NAMES libdeflate.h
+    HINTS ${libdeflate_incl_dirs}
+)
+
+set(libdeflate_lib_dirs "/usr/lib" "/usr/local/lib")
+if(${CMAKE_SYSTEM_NAME} MATCHES "Windows")
+    set(_LIBDEFLATE_x86 "(x86)")
+    set(libdeflate_lib_dirs ${libdeflate_lib_dirs} "$ENV{PROGRAMFILES}/libdeflate/lib")
+    set(libdeflate_lib_dirs ${libdeflate_lib_dirs} "$ENV{PROGRAMFILES${_LIBDEFLATE_x86}}/libdeflate/lib")
+    unset(_LIBDEFLATE_x86)
+endif()
+
+if(LIBDEFLATE_LIBRARYDIR)
+    list(APPEND libdeflate_lib_dirs ${LIBDEFLATE_LIBRARYDIR})
+endif()
+
+find_library(
+    LIBDEFLATE_LIBRARY
+    NAMES deflate libdeflate
+    HINTS ${libdeflate_lib_dirs}
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LIBDEFLATE DEFAULT_MSG
+                                  LIBDEFLATE_LIBRARY LIBDEFLATE_INCLUDE_DIR)
+
+mark_as_advanced(LIBDEFLATE_INCLUDE_DIR LIBDEFLATE_LIBRARY LIBDEFLATE_FOUND)
+
+set(LIBDEFLATE_LIBRARIES ${LIBDEFLATE_LIBRARY})
+set(LIBDEFLATE_INCLUDE_DIRS ${LIBDEFLATE_INCLUDE_DIR})
+
+if(LIBDEFLATE_FOUND)
+    if(NOT TARGET LIBDEFLATE::libdeflate)
+        add_library(LIBDEFLATE::libdeflate UNKNOWN IMPORTED)
+        set_target_properties(LIBDEFLATE::libdeflate PROPERTIES
+            IMPORTED_LOCATION "${LIBDEFLATE_LIBRARY}"
+            INTERFACE_INCLUDE_DIRECTORIES "${LIBDEFLATE_INCLUDE_DIR}")
+    endif()
+endif()
@@ -0,0 +1,67 @@
+# FindLIBURING
+# ------------
+#
+# Find liburing include dirs and libraries
+#
+# This module reads hints about search locations from variables::
+#
+#   LIBURING_INCLUDEDIR - Preferred include directory e.g. <prefix>/include
+#   LIBURING_LIBRARYDIR - Preferred library directory e.g. <prefix>/lib
+#
+# IMPORTED Targets
+# ^^^^^^^^^^^^^^^^
+#
+# This module defines :prop_tgt:`IMPORTED` target ``LIBURING::uring``, if
+# liburing has been found.
+#
+# Result Variables
+# ^^^^^^^^^^^^^^^^
+#
+# This module defines the following variables:
+#
+# ::
+#
+#   LIBURING_INCLUDE_DIR - Where to find the header files.
+#   LIBURING_LIBRARY     - Library when using liburing.
+#   LIBURING_FOUND       - True if liburing library is found.
+
+
+set(liburing_incl_dirs "/usr/include" "/usr/local/include")
+if(LIBURING_INCLUDEDIR)
+    list(APPEND liburing_incl_dirs ${LIBURING_INCLUDEDIR})
+endif()
+
+find_path(
+    LIBURING_INCLUDE_DIR
+    NAMES liburing.h
+    HINTS ${liburing_incl_dirs}
+)
+
+set(liburing_lib_dirs "/usr/lib" "/usr/local/lib")
+if(LIBURING_LIBRARYDIR)
+    list(APPEND liburing_lib_dirs ${LIBURING_LIBRARYDIR})
+endif()
+
+find_library(
+    LIBURING_LIBRARY
+    NAMES uring
+    HINTS ${liburing_lib_dirs}
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LIBURING DEFAULT_MSG
+                                  LIBURING_LIBRARY LIBURING_INCLUDE_DIR)
+
+mark_as_advanced(LIBURING_INCLUDE_DIR LIBURING_LIBRARY LIBURING_FOUND)
+
+set(LIBURING_LIBRARIES ${LIBURING_LIBRARY})
+set(LIBURING_INCLUDE_DIRS ${LIBURING_INCLUDE_DIR})
+
+if(LIBURING_FOUND)
+    if(NOT TARGET LIBURING::uring)
+        add_library(LIBURING::uring UNKNOWN IMPORTED)
+        set_target_properties(LIBURING::uring PROPERTIES
+            IMPORTED_LOCATION "${LIBURING_LIBRARY}"
+            INTERFACE_INCLUDE_DIRECTORIES "${LIBURING_INCLUDE_DIR}")
+    endif()
+endif()
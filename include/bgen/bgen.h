@@ -31,11 +31,11 @@
 /** Major bgen version. */
 #define BGEN_VERSION_MAJOR 4
 /** Minor bgen version. */
-#define BGEN_VERSION_MINOR 1
+#define BGEN_VERSION_MINOR 2
 /** Minor bgen version. */
-#define BGEN_VERSION_PATCH 1
+#define BGEN_VERSION_PATCH 0
 /** Bgen version. */
-#define BGEN_VERSION "4.1.1"
+#define BGEN_VERSION "4.2.0"
 
 #ifdef __cplusplus
 extern "C"
@@ -47,8 +47,11 @@ extern "C"
 #include "bgen/genotype.h"
 #include "bgen/metafile.h"
 #include "bgen/partition.h"
+#include "bgen/reader.h"
 #include "bgen/samples.h"
+#include "bgen/scan.h"
 #include "bgen/variant.h"
+#include "bgen/variant_table.h"
 
 #ifdef __cplusplus
 }
@@ -13,6 +13,18 @@
  */
 struct bgen_file;
 
+/** Options for reading a block of variants into a matrix.
+ * @struct bgen_read_options
+ */
+struct bgen_read_options
+{
+    unsigned        ncombs;       /**< Probabilities stored per sample and variant. */
+    bool            sample_major; /**< `true` for samples-by-variants; `false` otherwise. */
+    unsigned        nthreads;     /**< Decoding threads. `0` or `1` for the calling one. */
+    uint32_t const* samples;      /**< Indices of the samples to read; `NULL` for all. */
+    uint32_t        nselected;    /**< Number of indices in `samples`. */
+};
+
 /** Open bgen file and return a handler.
  *
  * Remember to call @ref bgen_file_close to close the file and release
@@ -22,6 +34,19 @@ struct bgen_file;
  * @return Bgen file handler. Return `NULL` on failure.
  */
 BGEN_EXPORT struct bgen_file* bgen_file_open(char const* filepath);
+/** Open bgen file and memory-map it.
+ *
+ * It behaves as @ref bgen_file_open, except that variant genotypes are read directly
+ * from the mapped file. Uncompressed genotypes are therefore decoded without copying
+ * them out of the mapped region.
+ *
+ * Remember to call @ref bgen_file_close to unmap and close the file after the
+ * interaction has finished.
+ *
+ * @param filepath File path to the bgen file.
+ * @return Bgen file handler. Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_file* bgen_file_open_mmap(char const* filepath);
 /** Close bgen file handler.
  *
  * @param bgen_file Bgen file handler.
@@ -52,6 +77,11 @@ BGEN_EXPORT bool bgen_file_contain_samples(struct bgen_file const* bgen_file);
  */
 BGEN_EXPORT struct bgen_samples* bgen_file_read_samples(struct bgen_file* bgen_file);
 /** Open a variant for genotype queries.
+ *
+ * The variant is fetched through positional reads, leaving the file cursor untouched.
+ * Therefore, several threads can concurrently open genotypes from the same handler as long
+ * as no cursor-based function (e.g., @ref bgen_file_read_samples or
+ * @ref bgen_metafile_create) is called on it at the same time.
  *
  * @param bgen_file Bgen file handler.
  * @param genotype_offset Genotype offset obtained from @ref bgen_variant.genotype_offset.
@@ -59,5 +89,127 @@ BGEN_EXPORT struct bgen_samples* bgen_file_read_samples(struct bgen_file* bgen_f
  */
 BGEN_EXPORT struct bgen_genotype* bgen_file_open_genotype(struct bgen_file* bgen_file,
                                                           uint64_t          genotype_offset);
+/** Open a variant genotype, leaving its probabilities compressed until they are read.
+ *
+ * Only the start of the variant block is decompressed: @ref bgen_genotype_nalleles,
+ * @ref bgen_genotype_min_ploidy, @ref bgen_genotype_max_ploidy, @ref bgen_genotype_phased,
+ * @ref bgen_genotype_ncombs, @ref bgen_genotype_ploidy and @ref bgen_genotype_missing are
+ * ready as soon as it returns. The rest of the block is decompressed by the first call
+ * reading probabilities (e.g., @ref bgen_genotype_read), so that variants filtered out on
+ * those fields alone cost little more than their header. Layout 1 variants keep missingness
+ * among their probabilities, and are therefore decompressed at once, as by
+ * @ref bgen_file_open_genotype. Uncompressed files are opened as @ref bgen_file_open_genotype
+ * would.
+ *
+ * The same restrictions as for @ref bgen_file_open_genotype apply.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offset Genotype offset obtained from @ref bgen_variant.genotype_offset.
+ * @return Variant genotype handler. Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_genotype* bgen_file_open_genotype_lazy(struct bgen_file* bgen_file,
+                                                               uint64_t genotype_offset);
+/** Ask the operating system to start reading variant genotypes ahead of time.
+ *
+ * It returns without waiting for the data, which is read into the page cache in the
+ * background (through `posix_fadvise` or, for memory-mapped files, `posix_madvise`), so
+ * that decoding and disk reads overlap. Nothing is read from the file meanwhile: each
+ * variant is prefetched up to the offset that follows it, so that consecutive variants make
+ * up a single request, and offsets far apart, out of order, or last are prefetched from the
+ * start of their block only. It does nothing on platforms without read-ahead hints. Refer
+ * to @ref bgen_reader_stream for a way of keeping a window of upcoming variants prefetched.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @return `0`. Invalid offsets are reported when their variants are opened.
+ */
+BGEN_EXPORT int bgen_file_prefetch(struct bgen_file* bgen_file,
+                                   uint64_t const*   genotype_offsets, uint32_t nvariants);
+/** Open several variant genotypes at once.
+ *
+ * The genotype blocks are read concurrently, many requests being in flight at the same
+ * time, which suits random access on solid-state drives. Reads go through io_uring on Linux
+ * if the library has been built with `BGEN_USE_IO_URING` (and the kernel allows it), and
+ * through a small pool of threads otherwise. Each block is parsed as soon as it arrives,
+ * whatever the order. Memory-mapped files are parsed straight from the mapping.
+ *
+ * The same restrictions as for @ref bgen_file_open_genotype apply.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @param genotypes Array of @p nvariants elements receiving the variant genotype handlers,
+ * in the order of @p genotype_offsets. Each one has to be closed by
+ * @ref bgen_genotype_close.
+ * @return `0` if it succeeds; `1` otherwise, in which case no handler is left open.
+ */
+BGEN_EXPORT int bgen_file_open_genotypes(struct bgen_file*      bgen_file,
+                                         uint64_t const*        genotype_offsets,
+                                         uint32_t               nvariants,
+                                         struct bgen_genotype** genotypes);
+/** Read the genotype probabilities of a block of variants (64-bits).
+ *
+ * The probabilities are written into a caller-provided matrix of
+ * `nvariants * nsamples * ncombs` elements, where `nsamples` is the value returned by
+ * @ref bgen_file_nsamples and `ncombs` is @ref bgen_read_options.ncombs. The element
+ * `(v, s, c)` for variant `v`, sample `s`, and genotype combination `c` is found at
+ * `(v * nsamples + s) * ncombs + c` (variants-by-samples) or at
+ * `(s * nvariants + v) * ncombs + c` (samples-by-variants, if
+ * @ref bgen_read_options.sample_major is `true`). Variants having less than `ncombs`
+ * combinations are padded with `NAN`; having more is an error.
+ *
+ * If @ref bgen_read_options.samples is not `NULL`, only the selected samples are decoded
+ * and `nsamples` above is @ref bgen_read_options.nselected instead, the samples following
+ * the given order.
+ *
+ * Decoding buffers are allocated once and reused across the whole block. If
+ * @ref bgen_read_options.nthreads is greater than one, variants are decompressed and decoded
+ * in parallel by that many threads, each variant being written by a single one. The
+ * file handler must not be used by other cursor-based functions in the meantime (refer to
+ * @ref bgen_file_open_genotype).
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @param probabilities Matrix of probabilities.
+ * @param options Read options. If `NULL`, variants are read as biallelic and diploid
+ * (`ncombs` equal to `3`) into a variants-by-samples matrix by the calling thread.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_file_read_genotypes(struct bgen_file* bgen_file,
+                                         uint64_t const*   genotype_offsets,
+                                         uint32_t nvariants, double* probabilities,
+                                         struct bgen_read_options const* options);
+/** Read the genotype probabilities of a block of variants (64-bits).
+ *
+ * Refer to @ref bgen_file_read_genotypes.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @param probabilities Matrix of probabilities.
+ * @param options Read options. It can be `NULL`.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_file_read_genotypes64(struct bgen_file* bgen_file,
+                                           uint64_t const*   genotype_offsets,
+                                           uint32_t nvariants, double* probabilities,
+                                           struct bgen_read_options const* options);
+/** Read the genotype probabilities of a block of variants (32-bits).
+ *
+ * Refer to @ref bgen_file_read_genotypes.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @param probabilities Matrix of probabilities.
+ * @param options Read options. It can be `NULL`.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_file_read_genotypes32(struct bgen_file* bgen_file,
+                                           uint64_t const*   genotype_offsets,
+                                           uint32_t nvariants, float* probabilities,
+                                           struct bgen_read_options const* options);
 
 #endif
@@ -65,6 +65,103 @@ BGEN_EXPORT int bgen_genotype_read64(struct bgen_genotype* genotype, double* pro
  * @return `0` if it succeeds; `1` otherwise.
  */
 BGEN_EXPORT int bgen_genotype_read32(struct bgen_genotype* genotype, float* probabilities);
+/** Read the probabilities of a subset of samples (64-bits).
+ *
+ * Only the selected samples are decoded, and their probabilities are stored in the order
+ * given by `samples`. The length of this array is equal to the product of `nselected` and
+ * the value returned by @ref bgen_genotype_ncombs. Sample indices may repeat.
+ *
+ * @param genotype Variant genotype handler.
+ * @param samples Indices of the selected samples.
+ * @param nselected Number of selected samples.
+ * @param probabilities Array of probabilities.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_subset(struct bgen_genotype* genotype,
+                                          uint32_t const* samples, uint32_t nselected,
+                                          double* probabilities);
+/** Read the probabilities of a subset of samples (64-bits).
+ *
+ * Refer to @ref bgen_genotype_read_subset.
+ *
+ * @param genotype Variant genotype handler.
+ * @param samples Indices of the selected samples.
+ * @param nselected Number of selected samples.
+ * @param probabilities Array of probabilities.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_subset64(struct bgen_genotype* genotype,
+                                            uint32_t const* samples, uint32_t nselected,
+                                            double* probabilities);
+/** Read the probabilities of a subset of samples (32-bits).
+ *
+ * Refer to @ref bgen_genotype_read_subset.
+ *
+ * @param genotype Variant genotype handler.
+ * @param samples Indices of the selected samples.
+ * @param nselected Number of selected samples.
+ * @param probabilities Array of probabilities.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_subset32(struct bgen_genotype* genotype,
+                                            uint32_t const* samples, uint32_t nselected,
+                                            float* probabilities);
+/** Read the expected number of copies of the second allele of each sample (64-bits).
+ *
+ * The dosages are computed straight from the stored genotype data, without building
+ * the array of probabilities. The length of this array is equal to the value returned by
+ * @ref bgen_file_nsamples. Missing genotypes are set to `NAN`. Only biallelic variants
+ * are supported, either phased or unphased, of any ploidy.
+ *
+ * @param genotype Variant genotype handler.
+ * @param dosages Array of dosages.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_dosage(struct bgen_genotype* genotype, double* dosages);
+/** Read the expected number of copies of the second allele of each sample (64-bits).
+ *
+ * Refer to @ref bgen_genotype_read_dosage.
+ *
+ * @param genotype Variant genotype handler.
+ * @param dosages Array of dosages.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_dosage64(struct bgen_genotype* genotype, double* dosages);
+/** Read the expected number of copies of the second allele of each sample (32-bits).
+ *
+ * Refer to @ref bgen_genotype_read_dosage.
+ *
+ * @param genotype Variant genotype handler.
+ * @param dosages Array of dosages.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_dosage32(struct bgen_genotype* genotype, float* dosages);
+/** Read the expected number of copies of the second allele of each sample (8-bits).
+ *
+ * Each dosage is scaled from `[0, ploidy]` to `[0, 254]` and rounded to the nearest
+ * integer, using integer arithmetic only. Missing genotypes are set to `255`.
+ * Refer to @ref bgen_genotype_read_dosage.
+ *
+ * @param genotype Variant genotype handler.
+ * @param dosages Array of quantized dosages.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_dosage8(struct bgen_genotype* genotype, uint8_t* dosages);
+/** Read the hard call of each sample.
+ *
+ * The hard call is the number of copies of the second allele in the most likely genotype,
+ * provided its probability is at least `threshold`. Otherwise, and for missing genotypes,
+ * the call is `-1`. Ties are resolved in favour of the fewest copies. Phased haplotypes
+ * are assumed to be independent. The length of this array is equal to the value returned
+ * by @ref bgen_file_nsamples. Only biallelic variants are supported.
+ *
+ * @param genotype Variant genotype handler.
+ * @param calls Array of hard calls.
+ * @param threshold Minimum probability of a call, from `0` to `1`.
+ * @return `0` if it succeeds; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_genotype_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                             double threshold);
 /** Get the number of alleles.
  *
  * @param genotype Variant genotype handler.
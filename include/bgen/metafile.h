@@ -4,8 +4,13 @@
 #ifndef BGEN_METAFILE_H
 #define BGEN_METAFILE_H
 
+#include "bgen/bstring.h"
 #include "bgen/export.h"
 #include <inttypes.h>
+#include <stdbool.h>
+
+/** Variant index given to names that are not found (see @ref bgen_metafile_lookup_ids). */
+#define BGEN_METAFILE_NOT_FOUND UINT32_MAX
 
 struct bgen_file;
 /** Metafile handler.
@@ -14,12 +19,41 @@ struct bgen_file;
 struct bgen_metafile;
 struct bgen_variant;
 struct bgen_partition;
+struct bgen_variant_table;
+
+/** Options of metafile creation.
+ * @struct bgen_metafile_options
+ */
+struct bgen_metafile_options
+{
+    unsigned nthreads; /**< Threads. `0` reads the variants one after another. */
+    bool     stats;    /**< Decode every variant to store its statistics. */
+    int      verbose;  /**< `1` for showing progress; `0` otherwise. */
+};
+
+/** Statistics of a variant, computed from its genotypes when the metafile was created.
+ * @struct bgen_variant_stats
+ */
+struct bgen_variant_stats
+{
+    uint32_t block_size;       /**< Size of the genotype block, after its length field. */
+    uint8_t  nbits;            /**< Bits per probability. */
+    bool     phased;           /**< Whether the genotypes are phased. */
+    uint8_t  min_ploidy;       /**< Minimum ploidy. */
+    uint8_t  max_ploidy;       /**< Maximum ploidy. */
+    uint32_t nmissing;         /**< Samples whose genotype is missing. */
+    double   allele_frequency; /**< Frequency of the second allele. */
+    double   info;             /**< Info score. */
+};
 
 /** Create a bgen metafile.
  *
  * A bgen metafile contains variant metadata (id, rsid, chrom, alleles) and variant
  * addresses. Those variants are grouped in partitions.
  *
+ * The metafile is written in version 05 of the format, which lays the metadata out as
+ * fixed-width columns (see @ref bgen_metafile_genotype_offset).
+ *
  * @param bgen_file Bgen file handler.
  * @param filepath File path to the metafile.
  * @param npartitions Number of partitions. It has to be a number between `1` and
@@ -30,11 +64,38 @@ struct bgen_partition;
 BGEN_EXPORT struct bgen_metafile* bgen_metafile_create(struct bgen_file* bgen_file,
                                                        char const*       filepath,
                                                        uint32_t npartitions, int verbose);
+/** Create a bgen metafile, with options.
+ *
+ * With @ref bgen_metafile_options.nthreads set, the bgen file is first walked through by
+ * following the variant lengths only, and the metadata is then parsed by that many threads,
+ * in batches written out in order. The resulting metafile is identical to the one
+ * @ref bgen_metafile_create writes. The file handler must not be used by cursor-based
+ * functions (refer to @ref bgen_file_open_genotype) until this function returns.
+ *
+ * With @ref bgen_metafile_options.stats set, the genotypes of every variant are decoded
+ * once the metadata is written, by the same threads (or by the calling one if `0`), so as
+ * to store their statistics (see @ref bgen_metafile_variant_stats) alongside.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param filepath File path to the metafile.
+ * @param npartitions Number of partitions. It has to be a number between `1` and
+ * the number of samples.
+ * @param options Creation options.
+ * @return Metafile handler. `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_metafile* bgen_metafile_create_with_options(
+    struct bgen_file* bgen_file, char const* filepath, uint32_t npartitions,
+    struct bgen_metafile_options const* options);
 /** Open a bgen metafile.
  *
  * Remember to call @ref bgen_metafile_close to close the file and release
  * resources after the interaction has finished.
  *
+ * Metafiles of version 05 are memory-mapped: nothing is read up front, and processes
+ * opening the same metafile share its pages in the page cache. Metafiles of version 04
+ * can be opened as well, although only through partitions
+ * (@ref bgen_metafile_read_partition).
+ *
  * @param filepath File path to the metafile.
  * @return Metafile handler. `NULL` on failure.
  */
@@ -51,6 +112,12 @@ BGEN_EXPORT uint32_t bgen_metafile_npartitions(struct bgen_metafile const* metaf
  * @return Number of variants.
  */
 BGEN_EXPORT uint32_t bgen_metafile_nvariants(struct bgen_metafile const* metafile);
+/** Get the version of the metafile format.
+ *
+ * @param metafile Metafile handler.
+ * @return `4` or `5`.
+ */
+BGEN_EXPORT unsigned bgen_metafile_version(struct bgen_metafile const* metafile);
 /** Read a partition of variants.
  *
  * Remember to call @ref bgen_partition_destroy to release resources after the
@@ -62,6 +129,191 @@ BGEN_EXPORT uint32_t bgen_metafile_nvariants(struct bgen_metafile const* metafil
  */
 BGEN_EXPORT struct bgen_partition const* bgen_metafile_read_partition(
     struct bgen_metafile const* metafile, uint32_t partition);
+/** Get the genotype offset of a variant.
+ *
+ * Variants are indexed from `0` to @ref bgen_metafile_nvariants minus one, throughout
+ * every partition. The value is read straight from the metafile, without reading the
+ * partition of the variant. This and the following per-variant functions require a
+ * metafile of version 05 (see @ref bgen_metafile_version).
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Genotype offset (as @ref bgen_variant.genotype_offset). Return `0` if the variant
+ * does not exist.
+ */
+BGEN_EXPORT uint64_t bgen_metafile_genotype_offset(struct bgen_metafile const* metafile,
+                                                   uint32_t                    index);
+/** Get the position of a variant.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Base-pair position. Return `0` if the variant does not exist.
+ */
+BGEN_EXPORT uint32_t bgen_metafile_position(struct bgen_metafile const* metafile,
+                                            uint32_t                    index);
+/** Get the number of alleles of a variant.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Number of alleles. Return `0` if the variant does not exist.
+ */
+BGEN_EXPORT uint16_t bgen_metafile_nalleles(struct bgen_metafile const* metafile,
+                                            uint32_t                    index);
+/** Get the identification of a variant.
+ *
+ * The string points into the metafile and remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Variant id. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_metafile_id(struct bgen_metafile const* metafile,
+                                                uint32_t                    index);
+/** Get the RSID of a variant.
+ *
+ * The string points into the metafile and remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Variant RSID. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_metafile_rsid(struct bgen_metafile const* metafile,
+                                                  uint32_t                    index);
+/** Get the chromosome name of a variant.
+ *
+ * The string points into the metafile and remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @return Chromosome name. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_metafile_chrom(struct bgen_metafile const* metafile,
+                                                   uint32_t                    index);
+/** Get an allele id of a variant.
+ *
+ * The string points into the metafile and remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @param allele Allele index, lower than @ref bgen_metafile_nalleles.
+ * @return Allele id. Return an empty string if the allele does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_metafile_allele_id(struct bgen_metafile const* metafile,
+                                                       uint32_t index, uint16_t allele);
+/** Get the statistics of a variant.
+ *
+ * The allele frequency and the info score are those of the second allele: they are `NAN`
+ * for variants that are not biallelic, or whose samples are all missing. The info score is
+ * the one of IMPUTE, phased haplotypes being taken as independent, and is `1` for
+ * monomorphic variants.
+ *
+ * @param metafile Metafile handler.
+ * @param index Variant index.
+ * @param stats Receives the statistics.
+ * @return `0` on success; `1` if the variant does not exist, or if the metafile was
+ * created without statistics (see @ref bgen_metafile_options.stats).
+ */
+BGEN_EXPORT int bgen_metafile_variant_stats(struct bgen_metafile const* metafile,
+                                            uint32_t index, struct bgen_variant_stats* stats);
+/** Get the allele frequency of every variant.
+ *
+ * Refer to @ref bgen_metafile_variant_stats. The array points into the metafile and
+ * remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @return Allele frequencies, by variant index. `NULL` if the metafile has no statistics.
+ */
+BGEN_EXPORT double const* bgen_metafile_allele_frequencies(
+    struct bgen_metafile const* metafile);
+/** Get the info score of every variant.
+ *
+ * Refer to @ref bgen_metafile_variant_stats. The array points into the metafile and
+ * remains valid until it is closed.
+ *
+ * @param metafile Metafile handler.
+ * @return Info scores, by variant index. `NULL` if the metafile has no statistics.
+ */
+BGEN_EXPORT double const* bgen_metafile_info_scores(struct bgen_metafile const* metafile);
+/** Find the variants of a genomic region.
+ *
+ * Metafiles of version 05 keep the variants of each chromosome sorted by position, so that
+ * a region is found by binary search. The variants are given by index (e.g., for
+ * @ref bgen_metafile_genotype_offset), ordered by position and then by index.
+ *
+ * @param metafile Metafile handler.
+ * @param chrom Chromosome, as stored in the bgen file (e.g., `"6"` or `"chr6"`).
+ * @param start First position of the region.
+ * @param end Last position of the region (inclusive).
+ * @param indices Receives the variant indices. They point into the metafile and remain
+ * valid until it is closed.
+ * @param nvariants Receives the number of variants found.
+ * @return `0` on success, even if no variant is found; `1` if the metafile has no region
+ * index (version 04).
+ */
+BGEN_EXPORT int bgen_metafile_query_region(struct bgen_metafile const* metafile,
+                                           char const* chrom, uint32_t start, uint32_t end,
+                                           uint32_t const** indices, uint32_t* nvariants);
+/** Tell whether a partition may hold variants of a genomic region.
+ *
+ * Each partition is summarised by the range of positions of every chromosome it holds,
+ * which allows skipping partitions without reading them.
+ *
+ * @param metafile Metafile handler.
+ * @param partition Partition index.
+ * @param chrom Chromosome.
+ * @param start First position of the region.
+ * @param end Last position of the region (inclusive).
+ * @return `1` if the partition overlaps the region, or if the metafile has no region
+ * index; `0` otherwise.
+ */
+BGEN_EXPORT int bgen_metafile_partition_overlaps(struct bgen_metafile const* metafile,
+                                                 uint32_t partition, char const* chrom,
+                                                 uint32_t start, uint32_t end);
+/** Find variants by id.
+ *
+ * Metafiles of version 05 hold a hash index of the variant ids, so that only a few pages of
+ * the metafile are read per id. Ids are looked up as a batch, in the order of the index.
+ *
+ * @param metafile Metafile handler.
+ * @param ids Variant ids.
+ * @param nids Number of ids.
+ * @param indices Receives, for each id, the index of the first variant having it (e.g., for
+ * @ref bgen_metafile_genotype_offset), or @ref BGEN_METAFILE_NOT_FOUND.
+ * @return `0` on success; `1` if the metafile has no id index (version 04).
+ */
+BGEN_EXPORT int bgen_metafile_lookup_ids(struct bgen_metafile const* metafile,
+                                         char const* const* ids, uint32_t nids,
+                                         uint32_t* indices);
+/** Find variants by rsid.
+ *
+ * Same as @ref bgen_metafile_lookup_ids, for rsids.
+ *
+ * @param metafile Metafile handler.
+ * @param rsids Variant rsids.
+ * @param nrsids Number of rsids.
+ * @param indices Receives, for each rsid, the index of the first variant having it, or
+ * @ref BGEN_METAFILE_NOT_FOUND.
+ * @return `0` on success; `1` if the metafile has no rsid index (version 04).
+ */
+BGEN_EXPORT int bgen_metafile_lookup_rsids(struct bgen_metafile const* metafile,
+                                           char const* const* rsids, uint32_t nrsids,
+                                           uint32_t* indices);
+/** Load the metadata of every variant as columns.
+ *
+ * Partitions are read by @p nthreads threads into a single @ref bgen_variant_table, whose
+ * fixed-width columns (e.g., @ref bgen_variant_table.positions) suit scanning every
+ * variant, and whose genotype offsets can be handed as they are to batch readers (refer to
+ * @ref bgen_file_read_genotypes). Chromosomes are given as codes, shared by the variants
+ * of a chromosome. The table holds its own copy of the metadata, and outlives the
+ * metafile.
+ *
+ * @param metafile Metafile handler.
+ * @param nthreads Number of threads. `0` or `1` for the calling one.
+ * @return Variant table. Remember to call @ref bgen_variant_table_destroy once done.
+ * Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_variant_table* bgen_metafile_load_table(
+    struct bgen_metafile const* metafile, unsigned nthreads);
 /** Close a metafile handler.
  *
  * @param metafile Metafile handler.
@@ -19,6 +19,10 @@ struct bgen_variant;
  */
 BGEN_EXPORT void bgen_partition_destroy(struct bgen_partition const* partition);
 /** Get metadata from a specific variant.
+ *
+ * Strings are held by the partition and remain valid until it is destroyed. Chromosome
+ * names and allele ids are stored once per partition: equal ones are the same
+ * @ref bgen_string, and can be compared by address.
  *
  * @param partition Partition of variants metadata.
  * @param index Variant index.
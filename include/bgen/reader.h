@@ -0,0 +1,70 @@
+/** Read variant genotypes with reusable decompression state.
+ * @file bgen/reader.h
+ */
+#ifndef BGEN_READER_H
+#define BGEN_READER_H
+
+#include "bgen/export.h"
+#include <stdint.h>
+
+/** Genotype reader.
+ *
+ * It keeps the zlib and zstd decompression contexts alive across variants, so that
+ * they are reset instead of being set up from scratch for every genotype. A reader must
+ * not be used by more than one thread at a time; threads willing to decode variants
+ * concurrently should each create their own reader on the same file handler.
+ *
+ * @struct bgen_reader
+ */
+struct bgen_reader;
+struct bgen_file;
+struct bgen_genotype;
+
+/** Create a genotype reader.
+ *
+ * Remember to call @ref bgen_reader_destroy to release resources after the interaction
+ * has finished. The file handler must remain open for the lifetime of the reader.
+ *
+ * @param bgen_file Bgen file handler.
+ * @return Genotype reader. Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_reader* bgen_reader_create(struct bgen_file* bgen_file);
+/** Destroy a genotype reader.
+ *
+ * Genotypes opened by this reader must be closed beforehand.
+ *
+ * @param reader Genotype reader.
+ */
+BGEN_EXPORT void bgen_reader_destroy(struct bgen_reader const* reader);
+/** Read upcoming variants ahead of time.
+ *
+ * It tells the reader that variants are going to be opened in the order given by
+ * `genotype_offsets`. From then on, every call to @ref bgen_reader_open_genotype keeps
+ * the next `window` variants of the sequence prefetched (refer to
+ * @ref bgen_file_prefetch), so that disk reads overlap with decoding. Opening variants
+ * out of order is allowed but pauses the read-ahead until the expected one is opened.
+ * The array must remain valid while the stream is in use; a `window` of `0` ends it.
+ *
+ * @param reader Genotype reader.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset.
+ * @param nvariants Number of variants.
+ * @param window Number of variants to keep prefetched.
+ */
+BGEN_EXPORT void bgen_reader_stream(struct bgen_reader* reader,
+                                    uint64_t const*     genotype_offsets, uint32_t nvariants,
+                                    uint32_t window);
+/** Open a variant for genotype queries.
+ *
+ * It behaves as @ref bgen_file_open_genotype, except that decompression goes through the
+ * contexts of the reader. Moreover, the last genotype handler closed is kept by the reader
+ * and reused, buffers included, by the next call. Scanning variants one at a time (open,
+ * read, close) therefore stops allocating memory once the buffers have grown large enough.
+ *
+ * @param reader Genotype reader.
+ * @param genotype_offset Genotype offset obtained from @ref bgen_variant.genotype_offset.
+ * @return Variant genotype handler. Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_genotype* bgen_reader_open_genotype(struct bgen_reader* reader,
+                                                            uint64_t genotype_offset);
+
+#endif
@@ -0,0 +1,76 @@
+/** Stream variant genotypes through a multi-threaded pipeline.
+ * @file bgen/scan.h
+ */
+#ifndef BGEN_SCAN_H
+#define BGEN_SCAN_H
+
+#include "bgen/export.h"
+#include <stdint.h>
+
+/** Pipelined scan over a sequence of variants.
+ *
+ * Variants go through three stages, each running on its own threads: a reader thread
+ * fetches the genotype blocks from the file, decompression threads inflate them, and
+ * decoding threads turn them into probabilities. Variants are handed to the caller in the
+ * requested order, while the stages work on the upcoming ones. At most
+ * @ref bgen_scan_options.nbuffers variants are held at any time: the reader waits for the
+ * caller to catch up once they are all taken.
+ *
+ * @struct bgen_scan
+ */
+struct bgen_scan;
+struct bgen_file;
+struct bgen_genotype;
+
+/** Options of a pipelined scan.
+ * @struct bgen_scan_options
+ */
+struct bgen_scan_options
+{
+    unsigned ndecompress; /**< Decompression threads. */
+    unsigned ndecode;     /**< Decoding threads. */
+    unsigned nbuffers;    /**< Variants held in memory at most (queued or being delivered). */
+};
+
+/** Start scanning variants.
+ *
+ * Remember to call @ref bgen_scan_close once done. The file handler must remain open, and
+ * must not be used by cursor-based functions (refer to @ref bgen_file_open_genotype),
+ * until then.
+ *
+ * @param bgen_file Bgen file handler.
+ * @param genotype_offsets Genotype offsets obtained from @ref bgen_variant.genotype_offset,
+ * in the order variants are to be delivered. The array must outlive the scan.
+ * @param nvariants Number of variants.
+ * @param options Scan options. If `NULL`, two decompression and two decoding threads are
+ * used, with up to 16 variants buffered.
+ * @return Scan handler. Return `NULL` on failure.
+ */
+BGEN_EXPORT struct bgen_scan* bgen_scan_create(struct bgen_file* bgen_file,
+                                               uint64_t const*   genotype_offsets,
+                                               uint32_t          nvariants,
+                                               struct bgen_scan_options const* options);
+/** Wait for the next variant.
+ *
+ * The genotype handler and the probabilities remain valid until the next call. The
+ * handler can be queried (e.g., @ref bgen_genotype_ncombs) but must not be closed.
+ *
+ * @param scan Scan handler.
+ * @param probabilities Receives the probabilities of the variant (64-bits), as
+ * @ref bgen_genotype_read would have written them.
+ * @return Variant genotype handler. Return `NULL` once every variant has been delivered.
+ * If a variant fails to be read, it also returns `NULL` in its place, the variants before
+ * it having been delivered (see @ref bgen_scan_close).
+ */
+BGEN_EXPORT struct bgen_genotype* bgen_scan_next(struct bgen_scan* scan,
+                                                 double const**    probabilities);
+/** Stop scanning and release resources.
+ *
+ * It can be called before every variant has been delivered.
+ *
+ * @param scan Scan handler.
+ * @return `0` if no variant has failed to be read; `1` otherwise.
+ */
+BGEN_EXPORT int bgen_scan_close(struct bgen_scan* scan);
+
+#endif
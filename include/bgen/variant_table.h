@@ -0,0 +1,76 @@
+/** Variant metadata laid out as columns.
+ * @file bgen/variant_table.h
+ */
+#ifndef BGEN_VARIANT_TABLE_H
+#define BGEN_VARIANT_TABLE_H
+
+#include "bgen/bstring.h"
+#include "bgen/export.h"
+#include <stdint.h>
+
+/** Metadata of every variant of a metafile, as contiguous arrays indexed by variant.
+ *
+ * Variants are indexed as in the metafile (e.g., @ref bgen_metafile_genotype_offset).
+ * Strings are stored back to back, without null terminator, in @ref heap: string `k` lies
+ * between `heap + string_offsets[k]` and `heap + string_offsets[k + 1]`. Those of variant
+ * `i` are its id, its rsid, and then its allele ids, starting from string
+ * `first_string[i]`.
+ *
+ * Everything is held by the table, in a single allocation.
+ *
+ * @struct bgen_variant_table
+ */
+struct bgen_variant_table
+{
+    uint32_t                  nvariants;        /**< Number of variants. */
+    uint64_t const*           genotype_offsets; /**< Genotype offsets (bgen file). */
+    uint32_t const*           positions;        /**< Base-pair positions. */
+    uint16_t const*           nalleles;         /**< Numbers of alleles. */
+    uint32_t const*           chroms;      /**< Chromosomes, as indices of `chrom_names`. */
+    uint32_t                  nchroms;     /**< Number of distinct chromosomes. */
+    struct bgen_string const* chrom_names; /**< Chromosome names, by first appearance. */
+    uint64_t const*           first_string;   /**< First string of each variant, and total. */
+    uint64_t const*           string_offsets; /**< Bounds of each string in `heap`. */
+    char const*               heap;           /**< Characters of the strings. */
+};
+
+/** Destroy a variant table by releasing its resources.
+ *
+ * @param table Variant table.
+ */
+BGEN_EXPORT void bgen_variant_table_destroy(struct bgen_variant_table const* table);
+/** Get the identification of a variant.
+ *
+ * @param table Variant table.
+ * @param index Variant index.
+ * @return Variant id. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_variant_table_id(struct bgen_variant_table const* table,
+                                                     uint32_t                         index);
+/** Get the RSID of a variant.
+ *
+ * @param table Variant table.
+ * @param index Variant index.
+ * @return Variant RSID. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_variant_table_rsid(struct bgen_variant_table const* table,
+                                                       uint32_t index);
+/** Get the chromosome name of a variant.
+ *
+ * @param table Variant table.
+ * @param index Variant index.
+ * @return Chromosome name. Return an empty string if the variant does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_variant_table_chrom(
+    struct bgen_variant_table const* table, uint32_t index);
+/** Get an allele id of a variant.
+ *
+ * @param table Variant table.
+ * @param index Variant index.
+ * @param allele Allele index, lower than the number of alleles of the variant.
+ * @return Allele id. Return an empty string if the allele does not exist.
+ */
+BGEN_EXPORT struct bgen_string bgen_variant_table_allele_id(
+    struct bgen_variant_table const* table, uint32_t index, uint16_t allele);
+
+#endif
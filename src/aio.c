@@ -0,0 +1,203 @@
+#include "aio.h"
+#include "io.h"
+#include "pool.h"
+#include "report.h"
+
+#if defined(BGEN_HAVE_IO_URING)
+#include <errno.h>
+#include <liburing.h>
+#include <stdlib.h>
+
+/* Larger requests are split into several reads. */
+#define URING_MAX_READ (1u << 30)
+/* Waiting is given up after that many failures in a row, the ring being torn down instead. */
+#define URING_MAX_WAIT_FAILURES 8
+
+struct uring_batch
+{
+    struct io_uring          ring;
+    int                      fd;
+    struct bgen_aio_request* requests;
+    uint32_t                 again[BGEN_AIO_DEPTH]; /* Requests to be submitted again. */
+    uint32_t                 nagain;
+};
+
+/* Queue a read of whatever is left of the request. Return `1` if the ring is full. */
+static int uring_prepare(struct uring_batch* batch, uint32_t index)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&batch->ring);
+    if (sqe == NULL)
+        return 1;
+
+    struct bgen_aio_request* request = batch->requests + index;
+    size_t const             done = (size_t)request->nread;
+    size_t                   size = request->size - done;
+    if (size > URING_MAX_READ)
+        size = URING_MAX_READ;
+
+    io_uring_prep_read(sqe, batch->fd, request->dst + done, (unsigned)size,
+                       request->offset + done);
+    io_uring_sqe_set_data(sqe, (void*)(uintptr_t)index);
+    return 0;
+}
+
+/* Handle the completion of a read. A request is only handed to `complete` once it has
+ * been fully read, hit the end of file, or failed. */
+static int uring_complete(struct uring_batch* batch, uint32_t index, int res,
+                          int (*complete)(void*, uint32_t), void* arg)
+{
+    struct bgen_aio_request* request = batch->requests + index;
+
+    if (res == -EINTR || res == -EAGAIN) {
+        batch->again[batch->nagain++] = index;
+        return BGEN_AIO_AGAIN;
+    }
+
+    if (res > 0) {
+        request->nread += res;
+        if ((size_t)request->nread < request->size) {
+            batch->again[batch->nagain++] = index;
+            return BGEN_AIO_AGAIN;
+        }
+    } else if (res < 0) {
+        errno = -res;
+        request->nread = -1;
+    }
+
+    int status = complete(arg, index);
+    if (status == BGEN_AIO_AGAIN) {
+        request->nread = 0;
+        batch->again[batch->nagain++] = index;
+    }
+    return status;
+}
+
+static int uring_read(struct uring_batch* batch, uint32_t nrequests,
+                      int (*complete)(void*, uint32_t), void* arg)
+{
+    uint32_t next = 0;      /* Next request never submitted. */
+    uint32_t active = 0;    /* Requests started but not yet done. */
+    uint32_t queued = 0;    /* Reads prepared but not yet submitted. */
+    uint32_t inflight = 0;  /* Reads submitted but not yet completed. */
+    unsigned nfailures = 0; /* Waits failed in a row. */
+    int      error = 0;
+
+    for (;;) {
+        while (!error &&
+               (batch->nagain > 0 || (next < nrequests && active < BGEN_AIO_DEPTH))) {
+            uint32_t index = batch->nagain > 0 ? batch->again[batch->nagain - 1] : next;
+            if (batch->nagain == 0)
+                batch->requests[index].nread = 0;
+            if (uring_prepare(batch, index))
+                break;
+            if (batch->nagain > 0) {
+                --batch->nagain;
+            } else {
+                ++next;
+                ++active;
+            }
+            ++queued;
+        }
+
+        if (queued > 0) {
+            int ret = io_uring_submit(&batch->ring);
+            if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+                errno = -ret;
+                bgen_perror("could not submit reads");
+                error = 1;
+            }
+            if (ret > 0) {
+                queued -= (uint32_t)ret;
+                inflight += (uint32_t)ret;
+            }
+        }
+
+        if (inflight == 0) {
+            if (error || active == 0)
+                break;
+            continue;
+        }
+
+        struct io_uring_cqe* cqe = NULL;
+        int                  ret = io_uring_wait_cqe(&batch->ring, &cqe);
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0) {
+            if (!error) {
+                errno = -ret;
+                bgen_perror("could not wait for reads");
+            }
+            error = 1;
+            /* Reads still in flight write into the caller's buffers: wait for them, unless
+             * waiting keeps failing. Tearing down the ring cancels them then. */
+            if (++nfailures < URING_MAX_WAIT_FAILURES)
+                continue;
+            break;
+        }
+        nfailures = 0;
+
+        uint32_t index = (uint32_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int      res = cqe->res;
+        io_uring_cqe_seen(&batch->ring, cqe);
+        --inflight;
+
+        /* Once failed, outstanding reads are only waited for. */
+        if (error) {
+            --active;
+            continue;
+        }
+
+        int status = uring_complete(batch, index, res, complete, arg);
+        if (status == BGEN_AIO_FAIL)
+            error = 1;
+        if (status != BGEN_AIO_AGAIN)
+            --active;
+    }
+
+    return error;
+}
+#endif
+
+struct pread_batch
+{
+    FILE*                    stream;
+    struct bgen_aio_request* requests;
+    int (*complete)(void* arg, uint32_t index);
+    void* arg;
+};
+
+static int pread_task(void* arg, unsigned worker, uint32_t index)
+{
+    struct pread_batch const* batch = arg;
+    struct bgen_aio_request*  request = batch->requests + index;
+
+    int status = BGEN_AIO_AGAIN;
+    while (status == BGEN_AIO_AGAIN) {
+        request->nread =
+            bgen_pread(batch->stream, request->dst, request->size, request->offset);
+        status = batch->complete(batch->arg, index);
+    }
+    return status == BGEN_AIO_FAIL;
+}
+
+int bgen_aio_read(FILE* stream, struct bgen_aio_request* requests, uint32_t nrequests,
+                  int (*complete)(void* arg, uint32_t index), void* arg)
+{
+#if defined(BGEN_HAVE_IO_URING)
+    struct uring_batch* uring = malloc(sizeof(struct uring_batch));
+    /* The kernel might lack io_uring or forbid it (e.g., seccomp filters in containers). */
+    if (uring != NULL && io_uring_queue_init(BGEN_AIO_DEPTH, &uring->ring, 0) == 0) {
+        uring->fd = fileno(stream);
+        uring->requests = requests;
+        uring->nagain = 0;
+        int error = uring_read(uring, nrequests, complete, arg);
+        io_uring_queue_exit(&uring->ring);
+        free(uring);
+        return error;
+    }
+    free(uring);
+#endif
+
+    struct pread_batch batch = {stream, requests, complete, arg};
+    return bgen_pool_run(BGEN_AIO_NTHREADS, nrequests, pread_task, &batch);
+}
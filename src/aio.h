@@ -0,0 +1,40 @@
+#ifndef BGEN_AIO_H
+#define BGEN_AIO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Maximum number of reads in flight. */
+#define BGEN_AIO_DEPTH 64
+/* Number of threads issuing reads where io_uring is not available. */
+#define BGEN_AIO_NTHREADS 8
+
+/* Values returned by the completion callback of `bgen_aio_read`. */
+#define BGEN_AIO_DONE 0
+#define BGEN_AIO_AGAIN 1
+#define BGEN_AIO_FAIL 2
+
+/* Read `size` bytes found at `offset` into `dst`. */
+struct bgen_aio_request
+{
+    uint64_t offset;
+    char*    dst;
+    size_t   size;
+    int64_t  nread; /**< Bytes read, less than `size` at end of file; `-1` on error. */
+};
+
+/* Perform every request, up to `BGEN_AIO_DEPTH` at a time. `complete(arg, index)` is called
+ * as each request completes, in whatever order that happens, and possibly from several
+ * threads at once for different requests. It returns `BGEN_AIO_AGAIN` after pointing the
+ * request somewhere else to have it performed once more (e.g., to read the rest of a block
+ * whose length is now known), and `BGEN_AIO_FAIL` to cancel the requests not yet started.
+ *
+ * The reads go through io_uring if the library has been built with it and the kernel
+ * allows it; they are spread over `BGEN_AIO_NTHREADS` threads calling `bgen_pread`
+ * otherwise.
+ *
+ * Return `0` if every request completes; `1` otherwise. */
+int bgen_aio_read(FILE* stream, struct bgen_aio_request* requests, uint32_t nrequests,
+                  int (*complete)(void* arg, uint32_t index), void* arg);
+
+#endif
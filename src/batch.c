@@ -0,0 +1,188 @@
+#include "bgen/file.h"
+#include "bgen/genotype.h"
+#include "bgen/reader.h"
+#include "buffer.h"
+#include "file.h"
+#include "genotype.h"
+#include "pool.h"
+#include "reader.h"
+#include "report.h"
+#include <math.h>
+#include <stdlib.h>
+
+static struct bgen_read_options const default_options = {3, false, 1, NULL, 0};
+
+/* Decoding state owned by a single worker thread. */
+struct worker
+{
+    struct bgen_reader*   reader;
+    struct bgen_genotype* genotype;
+    struct bgen_buffer    scratch;
+};
+
+struct batch
+{
+    struct bgen_file*               bgen_file;
+    uint64_t const*                 genotype_offsets;
+    uint32_t                        nvariants;
+    uint32_t                        nsamples; /* Selected samples only. */
+    void*                           probabilities;
+    struct bgen_read_options const* options;
+    struct worker*                  workers;
+};
+
+static int read_genotypes(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                          uint32_t nvariants, void* probabilities,
+                          struct bgen_read_options const* options,
+                          int (*read_variant)(void*, unsigned, uint32_t));
+
+static int load_variant(struct batch const* batch, struct worker* worker, uint32_t v)
+{
+    struct bgen_genotype* genotype = worker->genotype;
+    if (bgen_reader_load_genotype(worker->reader, genotype, batch->genotype_offsets[v]))
+        return 1;
+
+    if (genotype->nsamples != bgen_file_nsamples(batch->bgen_file)) {
+        bgen_error("number of samples mismatch (corrupted file?)");
+        return 1;
+    }
+
+    if (genotype->ncombs > batch->options->ncombs) {
+        bgen_error("variant has %u genotype combinations but `ncombs` is %u",
+                   genotype->ncombs, batch->options->ncombs);
+        return 1;
+    }
+    return 0;
+}
+
+#define MAKE_DECODE(BITS, FPTYPE)                                                             \
+    static int decode##BITS(struct batch const* batch, struct bgen_genotype* genotype,        \
+                            FPTYPE* probs)                                                    \
+    {                                                                                         \
+        struct bgen_read_options const* options = batch->options;                             \
+        if (options->samples == NULL)                                                         \
+            return bgen_genotype_read##BITS(genotype, probs);                                 \
+        return bgen_genotype_read_subset##BITS(genotype, options->samples,                    \
+                                               options->nselected, probs);                    \
+    }
+
+MAKE_DECODE(64, double)
+MAKE_DECODE(32, float)
+
+/* Each variant is decoded into its own rows (or columns) of the matrix, so workers never
+ * write to the same elements. */
+#define MAKE_READ_VARIANT(BITS, FPTYPE)                                                       \
+    static int read_variant##BITS(void* arg, unsigned worker, uint32_t v)                     \
+    {                                                                                         \
+        struct batch const*   batch = arg;                                                    \
+        struct bgen_genotype* genotype = batch->workers[worker].genotype;                     \
+        uint32_t const        nsamples = batch->nsamples;                                     \
+        unsigned const        ncombs = batch->options->ncombs;                                \
+        FPTYPE*               probabilities = batch->probabilities;                           \
+                                                                                              \
+        if (load_variant(batch, batch->workers + worker, v))                                  \
+            return 1;                                                                         \
+                                                                                              \
+        /* Decode straight into the matrix whenever the rows line up. */                      \
+        unsigned const vncombs = genotype->ncombs;                                            \
+        if (!batch->options->sample_major && vncombs == ncombs) {                             \
+            FPTYPE* row = probabilities + (size_t)v * nsamples * ncombs;                      \
+            return decode##BITS(batch, genotype, row);                                        \
+        }                                                                                     \
+                                                                                              \
+        size_t  size = (size_t)nsamples * vncombs * sizeof(FPTYPE);                           \
+        FPTYPE* probs = (FPTYPE*)bgen_buffer_reserve(&batch->workers[worker].scratch, size);  \
+        if (probs == NULL) {                                                                  \
+            bgen_error("could not malloc probabilities");                                     \
+            return 1;                                                                         \
+        }                                                                                     \
+        if (decode##BITS(batch, genotype, probs))                                             \
+            return 1;                                                                         \
+                                                                                              \
+        for (uint32_t s = 0; s < nsamples; ++s) {                                             \
+            size_t  cell = batch->options->sample_major ? (size_t)s * batch->nvariants + v    \
+                                                        : (size_t)v * nsamples + s;           \
+            FPTYPE* dst = probabilities + cell * ncombs;                                      \
+            for (unsigned c = 0; c < vncombs; ++c)                                            \
+                dst[c] = probs[(size_t)s * vncombs + c];                                      \
+            for (unsigned c = vncombs; c < ncombs; ++c)                                       \
+                dst[c] = NAN;                                                                 \
+        }                                                                                     \
+        return 0;                                                                             \
+    }
+
+MAKE_READ_VARIANT(64, double)
+MAKE_READ_VARIANT(32, float)
+
+int bgen_file_read_genotypes(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                             uint32_t nvariants, double* probabilities,
+                             struct bgen_read_options const* options)
+{
+    return bgen_file_read_genotypes64(bgen_file, genotype_offsets, nvariants, probabilities,
+                                      options);
+}
+
+int bgen_file_read_genotypes64(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                               uint32_t nvariants, double* probabilities,
+                               struct bgen_read_options const* options)
+{
+    return read_genotypes(bgen_file, genotype_offsets, nvariants, probabilities, options,
+                          read_variant64);
+}
+
+int bgen_file_read_genotypes32(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                               uint32_t nvariants, float* probabilities,
+                               struct bgen_read_options const* options)
+{
+    return read_genotypes(bgen_file, genotype_offsets, nvariants, probabilities, options,
+                          read_variant32);
+}
+
+static int read_genotypes(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                          uint32_t nvariants, void* probabilities,
+                          struct bgen_read_options const* options,
+                          int (*read_variant)(void*, unsigned, uint32_t))
+{
+    if (options == NULL)
+        options = &default_options;
+
+    unsigned nthreads = options->nthreads == 0 ? 1 : options->nthreads;
+    if (nthreads > nvariants)
+        nthreads = nvariants == 0 ? 1 : nvariants;
+
+    uint32_t const nsamples =
+        options->samples == NULL ? bgen_file_nsamples(bgen_file) : options->nselected;
+    struct batch   batch = {bgen_file, genotype_offsets, nvariants, nsamples,
+                            probabilities, options, NULL};
+
+    batch.workers = malloc(sizeof(struct worker) * nthreads);
+    if (batch.workers == NULL) {
+        bgen_error("could not allocate workers");
+        return 1;
+    }
+
+    int error = 0;
+    for (unsigned w = 0; w < nthreads; ++w) {
+        /* One reader per worker: decompression contexts are not shared across threads. */
+        if ((batch.workers[w].reader = bgen_reader_create(bgen_file)) == NULL)
+            error = 1;
+        if ((batch.workers[w].genotype = bgen_genotype_create()) == NULL) {
+            bgen_error("could not malloc genotype");
+            error = 1;
+        }
+        bgen_buffer_init(&batch.workers[w].scratch);
+    }
+
+    if (!error)
+        error = bgen_pool_run(nthreads, nvariants, read_variant, &batch);
+
+    for (unsigned w = 0; w < nthreads; ++w) {
+        bgen_buffer_release(&batch.workers[w].scratch);
+        if (batch.workers[w].genotype != NULL)
+            bgen_genotype_close(batch.workers[w].genotype);
+        if (batch.workers[w].reader != NULL)
+            bgen_reader_destroy(batch.workers[w].reader);
+    }
+    free(batch.workers);
+    return error;
+}
@@ -2,6 +2,7 @@
 #define BGEN_BSTRING_H_PRIVATE
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 struct bgen_string;
@@ -10,4 +11,15 @@ struct bgen_string const* bgen_string_fread(FILE* restrict stream, size_t length
 struct bgen_string const* bgen_string_memfread(char const* restrict* src, size_t length_size);
 int bgen_string_fwrite(struct bgen_string const* str, FILE* stream, size_t length_size);
 
+/* FNV-1a. The name indices of metafiles are built with it, so it must not change. */
+static inline uint32_t bgen_string_hash(char const* data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef BGEN_BUFFER_H
+#define BGEN_BUFFER_H
+
+#include "free.h"
+#include <stdlib.h>
+
+/* Growable memory block, reused across variants to avoid repeated allocations. */
+struct bgen_buffer
+{
+    char*  data;
+    size_t capacity;
+};
+
+static inline void bgen_buffer_init(struct bgen_buffer* buffer)
+{
+    buffer->data = NULL;
+    buffer->capacity = 0;
+}
+
+/* Make sure the buffer can hold at least `size` bytes. Return `NULL` on failure. */
+static inline char* bgen_buffer_reserve(struct bgen_buffer* buffer, size_t size)
+{
+    if (size <= buffer->capacity && buffer->data != NULL)
+        return buffer->data;
+
+    size_t capacity = buffer->capacity + buffer->capacity / 2;
+    if (capacity < size)
+        capacity = size;
+    if (capacity == 0)
+        capacity = 1;
+
+    char* data = realloc(buffer->data, capacity);
+    if (data == NULL)
+        return NULL;
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return data;
+}
+
+static inline void bgen_buffer_release(struct bgen_buffer const* buffer)
+{
+    bgen_free(buffer->data);
+}
+
+#endif
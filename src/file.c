@@ -1,4 +1,5 @@
 #include "file.h"
+#include "aio.h"
 #include "bgen/file.h"
 #include "bgen/genotype.h"
 #include "bstring.h"
@@ -15,15 +16,18 @@
 
 struct bgen_file
 {
-    char*    filepath;
-    FILE*    stream;
-    uint32_t nvariants;
-    uint32_t nsamples;
-    unsigned compression;
-    unsigned layout;
-    bool     contain_sample;
-    int64_t  samples_start;
-    int64_t  variants_start;
+    char*       filepath;
+    FILE*       stream;
+    FILE*       pstream; /* Positional reads go through it: see `bgen_pread_open`. */
+    uint32_t    nvariants;
+    uint32_t    nsamples;
+    unsigned    compression;
+    unsigned    layout;
+    bool        contain_sample;
+    int64_t     samples_start;
+    int64_t     variants_start;
+    char const* map;
+    uint64_t    map_size;
 };
 
 static struct bgen_file* bgen_file_create(char const* filepath);
@@ -61,8 +65,27 @@ err:
     return NULL;
 }
 
+struct bgen_file* bgen_file_open_mmap(char const* filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    if (bgen == NULL)
+        return NULL;
+
+    if ((bgen->map = bgen_mmap(bgen->stream, &bgen->map_size)) == NULL) {
+        bgen_perror("could not memory-map file %s", bgen->filepath);
+        bgen_file_close(bgen);
+        return NULL;
+    }
+
+    return bgen;
+}
+
 void bgen_file_close(struct bgen_file const* bgen)
 {
+    if (bgen->map != NULL && bgen_munmap(bgen->map, bgen->map_size))
+        bgen_perror("could not unmap %s file", bgen->filepath);
+    if (bgen->pstream != NULL && bgen->pstream != bgen->stream && fclose(bgen->pstream))
+        bgen_perror("could not close %s file", bgen->filepath);
     if (bgen->stream != NULL && fclose(bgen->stream))
         bgen_perror("could not close %s file", bgen->filepath);
     bgen_free(bgen->filepath);
@@ -134,34 +157,272 @@ err:
 struct bgen_genotype* bgen_file_open_genotype(struct bgen_file* bgen, uint64_t genotype_offset)
 {
     struct bgen_genotype* genotype = bgen_genotype_create();
-    genotype->layout = bgen->layout;
-    genotype->offset = genotype_offset;
 
-    if (genotype_offset > INT64_MAX) {
-        bgen_error("variant offset overflow");
-        goto err;
+    if (bgen_file_load_genotype(bgen, genotype, genotype_offset)) {
+        bgen_genotype_close(genotype);
+        return NULL;
     }
 
-    if (bgen_fseek(bgen_file_stream(bgen), (int64_t)genotype_offset, SEEK_SET)) {
-        bgen_perror("could not fseek a variant");
-        goto err;
+    return genotype;
+}
+
+struct bgen_genotype* bgen_file_open_genotype_lazy(struct bgen_file* bgen,
+                                                   uint64_t          genotype_offset)
+{
+    struct bgen_genotype* genotype = bgen_genotype_create();
+    genotype->lazy = true;
+
+    if (bgen_file_load_genotype(bgen, genotype, genotype_offset)) {
+        bgen_genotype_close(genotype);
+        return NULL;
+    }
+
+    return genotype;
+}
+
+/* Whether genotype blocks have a fixed size, rather than starting with their length. */
+static bool fixed_block_size(struct bgen_file const* bgen)
+{
+    return bgen->layout == 1 && bgen->compression == 0;
+}
+
+/* Bytes read at once from the start of a genotype block, before its length is known. It
+ * covers the whole block of small variants. */
+#define BLOCK_HEAD_SIZE 4096
+
+struct open_batch
+{
+    struct bgen_file*        bgen_file;
+    uint64_t const*          genotype_offsets;
+    struct bgen_genotype**   genotypes;
+    struct bgen_aio_request* requests;
+};
+
+/* Buffer a genotype block is read into. It stays with the handler, which points into it
+ * once loaded. */
+static struct bgen_buffer* block_buffer(struct bgen_file const* bgen,
+                                        struct bgen_genotype*   genotype)
+{
+    return bgen->compression > 0 ? &genotype->compressed : &genotype->chunk;
+}
+
+static int start_block(struct open_batch* batch, uint32_t index)
+{
+    struct bgen_file*   bgen = batch->bgen_file;
+    struct bgen_buffer* buffer = block_buffer(bgen, batch->genotypes[index]);
+    size_t              size = BLOCK_HEAD_SIZE;
+    if (fixed_block_size(bgen))
+        size = 6 * (size_t)bgen->nsamples;
+
+    struct bgen_aio_request* request = batch->requests + index;
+    if ((request->dst = bgen_buffer_reserve(buffer, size)) == NULL) {
+        bgen_error("could not malloc genotype block");
+        return 1;
     }
+    request->offset = batch->genotype_offsets[index];
+    request->size = size;
+    request->nread = 0;
+    return 0;
+}
 
-    if (bgen_file_layout(bgen) == 1) {
-        if (bgen_layout1_read_header(bgen, genotype))
-            goto err;
-    } else if (bgen_file_layout(bgen) == 2) {
-        if (bgen_layout2_read_header(bgen, genotype))
-            goto err;
+/* Called as each read completes: either read the rest of the block or parse it. */
+static int block_read(void* arg, uint32_t index)
+{
+    struct open_batch*       batch = arg;
+    struct bgen_file*        bgen = batch->bgen_file;
+    struct bgen_aio_request* request = batch->requests + index;
+    struct bgen_genotype*    genotype = batch->genotypes[index];
+    struct bgen_buffer*      buffer = block_buffer(bgen, genotype);
+    uint64_t const           offset = batch->genotype_offsets[index];
+
+    if (request->nread < 0) {
+        bgen_perror("could not read %s", bgen->filepath);
+        return BGEN_AIO_FAIL;
+    }
+
+    /* Bytes of the block read so far. */
+    uint64_t const nread = request->offset - offset + (uint64_t)request->nread;
+    uint64_t       size = 6 * (uint64_t)bgen->nsamples;
+    if (!fixed_block_size(bgen)) {
+        uint32_t length = 0;
+        if (nread < sizeof(length)) {
+            bgen_error("could not read %s (unexpected end of file)", bgen->filepath);
+            return BGEN_AIO_FAIL;
+        }
+        memcpy(&length, buffer->data, sizeof(length));
+        size = sizeof(length) + (uint64_t)length;
+    }
+
+    if (nread < size) {
+        if ((size_t)request->nread < request->size || size > SIZE_MAX) {
+            bgen_error("could not read %s (unexpected end of file)", bgen->filepath);
+            return BGEN_AIO_FAIL;
+        }
+        char* data = bgen_buffer_reserve(buffer, (size_t)size);
+        if (data == NULL) {
+            bgen_error("could not malloc genotype block");
+            return BGEN_AIO_FAIL;
+        }
+        request->offset = offset + nread;
+        request->dst = data + nread;
+        request->size = (size_t)(size - nread);
+        return BGEN_AIO_AGAIN;
+    }
+
+    if (bgen_file_load_genotype_block(bgen, genotype, offset, buffer->data, (size_t)size))
+        return BGEN_AIO_FAIL;
+    return BGEN_AIO_DONE;
+}
+
+static int read_blocks(struct bgen_file* bgen, uint64_t const* genotype_offsets,
+                       uint32_t nvariants, struct bgen_genotype** genotypes)
+{
+    struct bgen_aio_request* requests = malloc(sizeof(struct bgen_aio_request) * nvariants);
+    if (requests == NULL) {
+        bgen_error("could not malloc read requests");
+        return 1;
+    }
+
+    struct open_batch batch = {bgen, genotype_offsets, genotypes, requests};
+    int               error = 0;
+    for (uint32_t i = 0; i < nvariants && !error; ++i)
+        error = start_block(&batch, i);
+
+    if (!error)
+        error = bgen_aio_read(bgen->pstream, requests, nvariants, block_read, &batch);
+
+    free(requests);
+    return error;
+}
+
+int bgen_file_open_genotypes(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                             uint32_t nvariants, struct bgen_genotype** genotypes)
+{
+    for (uint32_t i = 0; i < nvariants; ++i)
+        genotypes[i] = bgen_genotype_create();
+
+    int error = 0;
+    if (bgen_file->map != NULL) {
+        /* Nothing to wait for: blocks are parsed straight from the mapping. */
+        for (uint32_t i = 0; i < nvariants && !error; ++i)
+            error = bgen_file_load_genotype(bgen_file, genotypes[i], genotype_offsets[i]);
     } else {
-        bgen_error("unrecognized layout type %d", bgen_file_layout(bgen));
-        goto err;
+        error = read_blocks(bgen_file, genotype_offsets, nvariants, genotypes);
     }
 
-    return genotype;
-err:
-    bgen_genotype_close(genotype);
-    return NULL;
+    if (error) {
+        for (uint32_t i = 0; i < nvariants; ++i) {
+            bgen_genotype_close(genotypes[i]);
+            genotypes[i] = NULL;
+        }
+    }
+    return error;
+}
+
+/* Size of the genotype block found at `offset`, length fields included. */
+static int genotype_block_size(struct bgen_file* bgen, uint64_t offset, uint64_t* size)
+{
+    if (fixed_block_size(bgen)) {
+        *size = 6 * (uint64_t)bgen->nsamples;
+        return 0;
+    }
+
+    uint32_t length = 0;
+    if (bgen_file_read_at(bgen, offset, &length, sizeof(length)))
+        return 1;
+    *size = sizeof(length) + (uint64_t)length;
+    return 0;
+}
+
+static void advise_willneed(struct bgen_file const* bgen, uint64_t offset, uint64_t size)
+{
+    if (bgen->map != NULL) {
+        if (offset < bgen->map_size)
+            bgen_madvise_willneed(bgen->map, offset, size < bgen->map_size - offset
+                                                         ? size
+                                                         : bgen->map_size - offset);
+    } else {
+        bgen_fadvise_willneed(bgen->stream, offset, size);
+    }
+}
+
+int bgen_file_fetch_block(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                          uint64_t offset, char const** block, size_t* size)
+{
+    *block = NULL;
+    *size = 0;
+
+    uint64_t block_size = 0;
+    if (genotype_block_size(bgen_file, offset, &block_size))
+        return 1;
+
+    if (bgen_file->map != NULL) {
+        advise_willneed(bgen_file, offset, block_size);
+        return 0;
+    }
+
+    if (block_size > SIZE_MAX) {
+        bgen_error("genotype block is too large");
+        return 1;
+    }
+
+    char* data = bgen_buffer_reserve(block_buffer(bgen_file, genotype), (size_t)block_size);
+    if (data == NULL) {
+        bgen_error("could not malloc genotype block");
+        return 1;
+    }
+
+    if (bgen_file_read_at(bgen_file, offset, data, (size_t)block_size))
+        return 1;
+
+    *block = data;
+    *size = (size_t)block_size;
+    return 0;
+}
+
+/* Blocks starting at most this many bytes apart are hinted up to the next one, along with
+ * the metadata of the variants in between. Anything farther is hinted from its head. */
+#define PREFETCH_SPAN (1 << 20)
+/* Bytes hinted from the start of a block whose end is not known. */
+#define PREFETCH_HEAD (64 << 10)
+
+int bgen_file_prefetch(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                       uint32_t nvariants)
+{
+    return bgen_file_prefetch_until(bgen_file, genotype_offsets, nvariants, 0);
+}
+
+int bgen_file_prefetch_until(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                             uint32_t nvariants, uint64_t next_offset)
+{
+    /* Nothing is read here: block sizes are bounded by the offsets that follow them. */
+    uint64_t start = 0;
+    uint64_t end = 0;
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        uint64_t const offset = genotype_offsets[i];
+        uint64_t const next = i + 1 < nvariants ? genotype_offsets[i + 1] : next_offset;
+
+        uint64_t size = PREFETCH_HEAD;
+        if (fixed_block_size(bgen_file))
+            size = 6 * (uint64_t)bgen_file->nsamples;
+        else if (next > offset && next - offset <= PREFETCH_SPAN)
+            size = next - offset;
+
+        if (i > 0 && offset >= start && offset <= end) {
+            if (offset + size > end)
+                end = offset + size;
+            continue;
+        }
+
+        if (i > 0)
+            advise_willneed(bgen_file, start, end - start);
+        start = offset;
+        end = offset + size;
+    }
+
+    if (nvariants > 0)
+        advise_willneed(bgen_file, start, end - start);
+    return 0;
 }
 
 FILE* bgen_file_stream(struct bgen_file const* bgen_file) { return bgen_file->stream; }
@@ -178,6 +439,147 @@ unsigned bgen_file_compression(struct bgen_file const* bgen_file)
     return bgen_file->compression;
 }
 
+uint64_t bgen_file_variants_start(struct bgen_file const* bgen_file)
+{
+    return (uint64_t)bgen_file->variants_start;
+}
+
+int bgen_file_size(struct bgen_file* bgen_file, uint64_t* size)
+{
+    if (bgen_file->map != NULL) {
+        *size = bgen_file->map_size;
+        return 0;
+    }
+
+    if (bgen_fseek(bgen_file->stream, 0, SEEK_END)) {
+        bgen_perror("could not fseek to the end of %s", bgen_file->filepath);
+        return 1;
+    }
+
+    int64_t const end = bgen_ftell(bgen_file->stream);
+    if (end < 0) {
+        bgen_perror("could not ftell %s", bgen_file->filepath);
+        return 1;
+    }
+
+    *size = (uint64_t)end;
+    return 0;
+}
+
+int bgen_file_read_at(struct bgen_file* bgen_file, uint64_t offset, void* dst, size_t size)
+{
+    if (bgen_file->map != NULL) {
+        if (offset > bgen_file->map_size || size > bgen_file->map_size - offset) {
+            bgen_error("could not read from mapped file (unexpected end of file)");
+            return 1;
+        }
+        memcpy(dst, bgen_file->map + offset, size);
+        return 0;
+    }
+
+    int64_t nread = bgen_pread(bgen_file->pstream, dst, size, offset);
+    if (nread < 0) {
+        bgen_perror("could not read %s", bgen_file->filepath);
+        return 1;
+    }
+
+    if ((uint64_t)nread < size) {
+        bgen_error("could not read %s (unexpected end of file)", bgen_file->filepath);
+        return 1;
+    }
+
+    return 0;
+}
+
+char const* bgen_file_view(struct bgen_file* bgen_file, uint64_t offset, size_t size,
+                           struct bgen_buffer* buffer)
+{
+    if (bgen_file->map != NULL) {
+        if (offset > bgen_file->map_size || size > bgen_file->map_size - offset) {
+            bgen_error("could not read from mapped file (unexpected end of file)");
+            return NULL;
+        }
+        return bgen_file->map + offset;
+    }
+
+    char* data = bgen_buffer_reserve(buffer, size);
+    if (data == NULL) {
+        bgen_error("could not malloc buffer");
+        return NULL;
+    }
+
+    if (bgen_file_read_at(bgen_file, offset, data, size))
+        return NULL;
+
+    return data;
+}
+
+/* Bytes of the genotype block held in memory, or `NULL` if they lie outside of it. */
+static char const* block_at(struct bgen_genotype const* genotype, uint64_t offset, size_t size)
+{
+    uint64_t const start = offset - genotype->offset;
+    if (offset < genotype->offset || start > genotype->block_size ||
+        size > genotype->block_size - start) {
+        bgen_error("genotype block is too short (corrupted file?)");
+        return NULL;
+    }
+    return genotype->block + start;
+}
+
+int bgen_file_read_block(struct bgen_file* bgen_file, struct bgen_genotype const* genotype,
+                         uint64_t offset, void* dst, size_t size)
+{
+    if (genotype->block == NULL)
+        return bgen_file_read_at(bgen_file, offset, dst, size);
+
+    char const* src = block_at(genotype, offset, size);
+    if (src == NULL)
+        return 1;
+    memcpy(dst, src, size);
+    return 0;
+}
+
+char const* bgen_file_view_block(struct bgen_file*                 bgen_file,
+                                 struct bgen_genotype const* genotype, uint64_t offset,
+                                 size_t size, struct bgen_buffer* buffer)
+{
+    if (genotype->block == NULL)
+        return bgen_file_view(bgen_file, offset, size, buffer);
+    return block_at(genotype, offset, size);
+}
+
+int bgen_file_load_genotype_block(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                                  uint64_t offset, char const* block, size_t size)
+{
+    genotype->block = block;
+    genotype->block_size = size;
+    int error = bgen_file_load_genotype(bgen_file, genotype, offset);
+    genotype->block = NULL;
+    return error;
+}
+
+int bgen_file_load_genotype(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                            uint64_t offset)
+{
+    genotype->layout = bgen_file->layout;
+    genotype->offset = offset;
+    genotype->deferred = false;
+
+    if (offset > INT64_MAX) {
+        bgen_error("variant offset overflow");
+        return 1;
+    }
+
+    if (bgen_file->layout == 1)
+        return bgen_layout1_read_header(bgen_file, genotype);
+
+    if (bgen_file->layout == 2)
+        return bgen_layout2_read_header(bgen_file, genotype);
+
+    bgen_error("unrecognized layout type %d", bgen_file->layout);
+    return 1;
+}
+
 int bgen_file_seek_variants_start(struct bgen_file* bgen_file)
 {
     if (bgen_fseek(bgen_file->stream, bgen_file->variants_start, SEEK_SET)) {
@@ -192,6 +594,7 @@ static struct bgen_file* bgen_file_create(char const* filepath)
     struct bgen_file* bgen = malloc(sizeof(struct bgen_file));
     bgen->filepath = strdup(filepath);
     bgen->stream = NULL;
+    bgen->pstream = NULL;
     bgen->nvariants = 0;
     bgen->nsamples = 0;
     bgen->compression = 0;
@@ -199,6 +602,8 @@ static struct bgen_file* bgen_file_create(char const* filepath)
     bgen->contain_sample = 0;
     bgen->samples_start = 0;
     bgen->variants_start = 0;
+    bgen->map = NULL;
+    bgen->map_size = 0;
 
     if (!(bgen->stream = fopen(bgen->filepath, "rb"))) {
         bgen_perror("could not open file %s", bgen->filepath);
@@ -206,6 +611,12 @@ static struct bgen_file* bgen_file_create(char const* filepath)
         return NULL;
     }
 
+    if (!(bgen->pstream = bgen_pread_open(bgen->stream, bgen->filepath))) {
+        bgen_perror("could not open file %s", bgen->filepath);
+        bgen_file_close(bgen);
+        return NULL;
+    }
+
     return bgen;
 }
 
@@ -1,14 +1,51 @@
 #ifndef BGEN_FILE_H_PRIVATE
 #define BGEN_FILE_H_PRIVATE
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+struct bgen_buffer;
 struct bgen_file;
+struct bgen_genotype;
 
 FILE*       bgen_file_stream(struct bgen_file const* bgen_file);
 char const* bgen_file_filepath(struct bgen_file const* bgen_file);
 unsigned    bgen_file_layout(struct bgen_file const* bgen_file);
 unsigned    bgen_file_compression(struct bgen_file const* bgen_file);
 int         bgen_file_seek_variants_start(struct bgen_file* bgen_file);
+uint64_t    bgen_file_variants_start(struct bgen_file const* bgen_file);
+/* Size of the file in bytes. The cursor is moved if the file is not memory-mapped. */
+int bgen_file_size(struct bgen_file* bgen_file, uint64_t* size);
+/* Copy `size` bytes found at `offset` into `dst`. */
+int bgen_file_read_at(struct bgen_file* bgen_file, uint64_t offset, void* dst, size_t size);
+/* Return a pointer to `size` bytes found at `offset`. It points straight into the mapped
+ * region if the file has been memory-mapped; otherwise, the bytes are read into `buffer`. */
+char const* bgen_file_view(struct bgen_file* bgen_file, uint64_t offset, size_t size,
+                           struct bgen_buffer* buffer);
+/* Read the variant genotype at `offset` into an existing (possibly reused) handler. */
+int bgen_file_load_genotype(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                            uint64_t offset);
+/* Same as above, for a genotype block of `size` bytes already read into `block`. The
+ * handler might point into `block`, which must then outlive it. */
+int bgen_file_load_genotype_block(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                                  uint64_t offset, char const* block, size_t size);
+/* Read the whole genotype block found at `offset` into a buffer of `genotype`, ready for
+ * `bgen_file_load_genotype_block`. Memory-mapped files are only hinted to be read soon:
+ * `*block` is then set to `NULL`, the genotype being loaded straight from the mapping. */
+int bgen_file_fetch_block(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                          uint64_t offset, char const** block, size_t* size);
+/* Same as `bgen_file_prefetch`, the block of the last variant ending before `next_offset`
+ * (`0` if not known). */
+int bgen_file_prefetch_until(struct bgen_file* bgen_file, uint64_t const* genotype_offsets,
+                             uint32_t nvariants, uint64_t next_offset);
+/* Same as `bgen_file_read_at` and `bgen_file_view`, for bytes of the block of `genotype`
+ * being loaded. They are taken from the block itself if it is already in memory. */
+int         bgen_file_read_block(struct bgen_file*                 bgen_file,
+                                 struct bgen_genotype const* genotype, uint64_t offset,
+                                 void* dst, size_t size);
+char const* bgen_file_view_block(struct bgen_file*                 bgen_file,
+                                 struct bgen_genotype const* genotype, uint64_t offset,
+                                 size_t size, struct bgen_buffer* buffer);
 
 #endif
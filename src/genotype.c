@@ -3,17 +3,36 @@
 #include "free.h"
 #include "layout1.h"
 #include "layout2.h"
+#include "reader.h"
 #include "report.h"
 
 void bgen_genotype_close(struct bgen_genotype const* genotype)
 {
-    bgen_free(genotype->ploidy_missingness);
-    bgen_free(genotype->chunk);
+    if (genotype->reader != NULL && bgen_reader_recycle(genotype->reader, genotype))
+        return;
+    bgen_genotype_destroy(genotype);
+}
+
+void bgen_genotype_destroy(struct bgen_genotype const* genotype)
+{
+    bgen_buffer_release(&genotype->chunk);
+    bgen_buffer_release(&genotype->compressed);
+    bgen_buffer_release(&genotype->sample_offsets);
     bgen_free(genotype);
 }
 
+/* Decompress the probabilities of a handler opened lazily, if not done already. */
+static int decompress_deferred(struct bgen_genotype* genotype)
+{
+    if (!genotype->deferred)
+        return 0;
+    return bgen_layout2_inflate(genotype);
+}
+
 int bgen_genotype_read(struct bgen_genotype* genotype, double* probabilities)
 {
+    if (decompress_deferred(genotype))
+        return 1;
     if (genotype->layout == 1) {
         bgen_layout1_read_genotype64(genotype, probabilities);
     } else if (genotype->layout == 2) {
@@ -32,6 +51,8 @@ int bgen_genotype_read64(struct bgen_genotype* genotype, double* probabilities)
 
 int bgen_genotype_read32(struct bgen_genotype* genotype, float* probabilities)
 {
+    if (decompress_deferred(genotype))
+        return 1;
     if (genotype->layout == 1) {
         bgen_layout1_read_genotype32(genotype, probabilities);
     } else if (genotype->layout == 2) {
@@ -43,6 +64,93 @@ int bgen_genotype_read32(struct bgen_genotype* genotype, float* probabilities)
     return 0;
 }
 
+#define MAKE_READ_SUBSET(BITS, FPTYPE)                                                        \
+    int bgen_genotype_read_subset##BITS(struct bgen_genotype* genotype,                       \
+                                        uint32_t const* samples, uint32_t nselected,          \
+                                        FPTYPE* probabilities)                                \
+    {                                                                                         \
+        for (uint32_t i = 0; i < nselected; ++i) {                                            \
+            if (samples[i] >= genotype->nsamples) {                                           \
+                bgen_error("sample index %" PRIu32 " is out of range (%" PRIu32 " samples)",  \
+                           samples[i], genotype->nsamples);                                   \
+                return 1;                                                                     \
+            }                                                                                 \
+        }                                                                                     \
+        if (decompress_deferred(genotype))                                                    \
+            return 1;                                                                         \
+        if (genotype->layout == 1) {                                                          \
+            bgen_layout1_read_subset##BITS(genotype, samples, nselected, probabilities);      \
+        } else if (genotype->layout == 2) {                                                   \
+            return bgen_layout2_read_subset##BITS(genotype, samples, nselected,               \
+                                                  probabilities);                             \
+        } else {                                                                              \
+            bgen_error("unrecognized layout type %d", genotype->layout);                      \
+            return 1;                                                                         \
+        }                                                                                     \
+        return 0;                                                                             \
+    }
+
+MAKE_READ_SUBSET(64, double)
+MAKE_READ_SUBSET(32, float)
+
+int bgen_genotype_read_subset(struct bgen_genotype* genotype, uint32_t const* samples,
+                              uint32_t nselected, double* probabilities)
+{
+    return bgen_genotype_read_subset64(genotype, samples, nselected, probabilities);
+}
+
+#define MAKE_READ_DOSAGE(BITS, TYPE)                                                          \
+    int bgen_genotype_read_dosage##BITS(struct bgen_genotype* genotype, TYPE* dosages)        \
+    {                                                                                         \
+        if (genotype->nalleles != 2) {                                                        \
+            bgen_error("dosage requires a biallelic variant (found %u alleles)",              \
+                       genotype->nalleles);                                                   \
+            return 1;                                                                         \
+        }                                                                                     \
+        if (decompress_deferred(genotype))                                                    \
+            return 1;                                                                         \
+        if (genotype->layout == 1) {                                                          \
+            bgen_layout1_read_dosage##BITS(genotype, dosages);                                \
+        } else if (genotype->layout == 2) {                                                   \
+            bgen_layout2_read_dosage##BITS(genotype, dosages);                                \
+        } else {                                                                              \
+            bgen_error("unrecognized layout type %d", genotype->layout);                      \
+            return 1;                                                                         \
+        }                                                                                     \
+        return 0;                                                                             \
+    }
+
+MAKE_READ_DOSAGE(64, double)
+MAKE_READ_DOSAGE(32, float)
+
+MAKE_READ_DOSAGE(8, uint8_t)
+
+int bgen_genotype_read_dosage(struct bgen_genotype* genotype, double* dosages)
+{
+    return bgen_genotype_read_dosage64(genotype, dosages);
+}
+
+int bgen_genotype_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                 double threshold)
+{
+    if (genotype->nalleles != 2) {
+        bgen_error("hard calls require a biallelic variant (found %u alleles)",
+                   genotype->nalleles);
+        return 1;
+    }
+    if (decompress_deferred(genotype))
+        return 1;
+    if (genotype->layout == 1) {
+        bgen_layout1_read_hardcalls(genotype, calls, threshold);
+    } else if (genotype->layout == 2) {
+        bgen_layout2_read_hardcalls(genotype, calls, threshold);
+    } else {
+        bgen_error("unrecognized layout type %d", genotype->layout);
+        return 1;
+    }
+    return 0;
+}
+
 uint16_t bgen_genotype_nalleles(struct bgen_genotype const* genotype)
 {
     return genotype->nalleles;
@@ -50,11 +158,16 @@ uint16_t bgen_genotype_nalleles(struct bgen_genotype const* genotype)
 
 bool bgen_genotype_missing(struct bgen_genotype const* genotype, uint32_t index)
 {
+    if (genotype->layout == 1)
+        return bgen_layout1_missing(genotype, index);
     return genotype->ploidy_missingness[index] >> 7;
 }
 
 uint8_t bgen_genotype_ploidy(struct bgen_genotype const* genotype, uint32_t index)
 {
+    /* Layout 1 samples are all diploid. */
+    if (genotype->layout == 1)
+        return 2;
     return genotype->ploidy_missingness[index] & 127;
 }
 
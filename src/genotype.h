@@ -1,28 +1,54 @@
 #ifndef BGEN_GENOTYPE_H_PRIVATE
 #define BGEN_GENOTYPE_H_PRIVATE
 
+#include "buffer.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+struct bgen_reader;
+struct bgen_zlib;
+struct bgen_zstd;
+
 struct bgen_genotype
 {
-    unsigned    layout;
-    uint32_t    nsamples;
-    uint16_t    nalleles;
-    uint8_t     phased;
-    uint8_t     nbits;
-    uint8_t*    ploidy_missingness;
-    unsigned    ncombs;
-    uint8_t     min_ploidy;
-    uint8_t     max_ploidy;
-    char*       chunk;
-    char const* chunk_ptr;
-    uint64_t    offset;
+    unsigned            layout;
+    uint32_t            nsamples;
+    uint16_t            nalleles;
+    uint8_t             phased;
+    uint8_t             nbits;
+    uint8_t const*      ploidy_missingness;
+    unsigned            ncombs;
+    uint8_t             min_ploidy;
+    uint8_t             max_ploidy;
+    struct bgen_buffer  chunk;      /**< Decompressed (or read) probability data. */
+    struct bgen_buffer  compressed; /**< Compressed data read from file. */
+    char const*         chunk_ptr;
+    char const*         chunk_end; /**< End of layout 2 probability data. */
+    uint64_t            offset;
+    struct bgen_buffer  sample_offsets; /**< Bit offset of each sample (varying ploidy). */
+    bool                sample_offsets_ready;
+    struct bgen_zlib*   zlib;   /**< Borrowed inflate stream; `NULL` for a temporary one. */
+    struct bgen_zstd*   zstd;   /**< Borrowed zstd context; `NULL` for a temporary one. */
+    struct bgen_reader* reader; /**< Reader the handler is handed back to when closed. */
+    char const*         block;  /**< Genotype block already in memory, if not `NULL`. */
+    size_t              block_size; /**< Size of the genotype block, length fields included. */
+    bool                lazy;     /**< Leave the probabilities compressed until first read. */
+    bool                deferred; /**< Probabilities still compressed, in `packed`. */
+    unsigned            compression;
+    char const*         packed; /**< Compressed probabilities (mapped or in `compressed`). */
+    size_t              packed_size;
+    size_t              unpacked_size;
+    /* Layout 2 decoders, chosen when the header is parsed. */
+    void (*read64)(struct bgen_genotype* genotype, double* probs);
+    void (*read32)(struct bgen_genotype* genotype, float* probs);
 };
 
 static inline struct bgen_genotype* bgen_genotype_create(void)
 {
     struct bgen_genotype* genotype = malloc(sizeof(struct bgen_genotype));
+    if (genotype == NULL)
+        return NULL;
     genotype->layout = 0;
     genotype->nsamples = 0;
     genotype->nalleles = 0;
@@ -32,10 +58,30 @@ static inline struct bgen_genotype* bgen_genotype_create(void)
     genotype->ncombs = 0;
     genotype->min_ploidy = 0;
     genotype->max_ploidy = 0;
-    genotype->chunk = NULL;
+    bgen_buffer_init(&genotype->chunk);
+    bgen_buffer_init(&genotype->compressed);
     genotype->chunk_ptr = NULL;
+    genotype->chunk_end = NULL;
     genotype->offset = 0;
+    bgen_buffer_init(&genotype->sample_offsets);
+    genotype->sample_offsets_ready = false;
+    genotype->zlib = NULL;
+    genotype->zstd = NULL;
+    genotype->reader = NULL;
+    genotype->block = NULL;
+    genotype->block_size = 0;
+    genotype->lazy = false;
+    genotype->deferred = false;
+    genotype->compression = 0;
+    genotype->packed = NULL;
+    genotype->packed_size = 0;
+    genotype->unpacked_size = 0;
+    genotype->read64 = NULL;
+    genotype->read32 = NULL;
     return genotype;
 }
 
+/* Release the handler for good, even if it belongs to a reader. */
+void bgen_genotype_destroy(struct bgen_genotype const* genotype);
+
 #endif
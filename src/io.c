@@ -53,3 +53,172 @@ int bgen_fseek(FILE* stream, int64_t offset, int origin)
 }
 
 int64_t bgen_ftell(FILE* stream) { return LONG_TELL(stream); }
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+
+char const* bgen_mmap(FILE* stream, uint64_t* size)
+{
+    HANDLE        file = (HANDLE)_get_osfhandle(_fileno(stream));
+    LARGE_INTEGER file_size;
+
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+        return NULL;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+        return NULL;
+
+    /* The view keeps a reference to the mapping object. */
+    void* addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (addr == NULL)
+        return NULL;
+
+    *size = (uint64_t)file_size.QuadPart;
+    return addr;
+}
+
+int bgen_munmap(char const* addr, uint64_t size) { return !UnmapViewOfFile(addr); }
+
+/* ReadFile moves the file pointer of synchronous handles, which `stream` shares with its
+ * cursor. Handles opened for overlapped I/O have no file pointer. */
+FILE* bgen_pread_open(FILE* stream, char const* filepath)
+{
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    int fd = _open_osfhandle((intptr_t)file, _O_RDONLY | _O_BINARY);
+    if (fd == -1) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    FILE* pstream = _fdopen(fd, "rb");
+    if (pstream == NULL)
+        _close(fd);
+    return pstream;
+}
+
+/* `stream` must come from `bgen_pread_open`. Each read waits on its own event, as several
+ * threads might share the handle. */
+int64_t bgen_pread(FILE* stream, void* dst, size_t size, uint64_t offset)
+{
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(stream));
+    HANDLE event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    size_t total = 0;
+
+    if (event == NULL)
+        return -1;
+
+    while (total < size) {
+        OVERLAPPED ov = {0};
+        uint64_t   pos = offset + total;
+        ov.Offset = (DWORD)(pos & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)(pos >> 32);
+        ov.hEvent = event;
+
+        DWORD chunk = size - total > 0x40000000 ? 0x40000000 : (DWORD)(size - total);
+        DWORD nread = 0;
+        if (!ReadFile(file, (char*)dst + total, chunk, NULL, &ov) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            CloseHandle(event);
+            return -1;
+        }
+        if (!GetOverlappedResult(file, &ov, &nread, TRUE)) {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            CloseHandle(event);
+            return -1;
+        }
+        if (nread == 0)
+            break;
+        total += nread;
+    }
+
+    CloseHandle(event);
+    return (int64_t)total;
+}
+
+void bgen_fadvise_willneed(FILE* stream, uint64_t offset, uint64_t size) {}
+
+void bgen_madvise_willneed(char const* addr, uint64_t offset, uint64_t size) {}
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+char const* bgen_mmap(FILE* stream, uint64_t* size)
+{
+    struct stat st;
+    int         fd = fileno(stream);
+
+    if (fstat(fd, &st) || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+        return NULL;
+
+    void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    *size = (uint64_t)st.st_size;
+    return addr;
+}
+
+int bgen_munmap(char const* addr, uint64_t size) { return munmap((void*)addr, (size_t)size); }
+
+FILE* bgen_pread_open(FILE* stream, char const* filepath) { return stream; }
+
+int64_t bgen_pread(FILE* stream, void* dst, size_t size, uint64_t offset)
+{
+    int    fd = fileno(stream);
+    size_t total = 0;
+
+    if (offset > INT64_MAX)
+        return -1;
+
+    while (total < size) {
+        ssize_t n = pread(fd, (char*)dst + total, size - total, (off_t)(offset + total));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        total += (size_t)n;
+    }
+
+    return (int64_t)total;
+}
+
+void bgen_fadvise_willneed(FILE* stream, uint64_t offset, uint64_t size)
+{
+    if (offset > INT64_MAX || size > INT64_MAX)
+        return;
+#if defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fileno(stream), (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+    struct radvisory advice = {(off_t)offset, size > INT_MAX ? INT_MAX : (int)size};
+    fcntl(fileno(stream), F_RDADVISE, &advice);
+#endif
+}
+
+void bgen_madvise_willneed(char const* addr, uint64_t offset, uint64_t size)
+{
+    /* The range has to start at a page boundary. */
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = offset - offset % page;
+    uint64_t length = size + (offset - start);
+    if (length > SIZE_MAX)
+        return;
+    posix_madvise((void*)(addr + start), (size_t)length, POSIX_MADV_WILLNEED);
+}
+#endif
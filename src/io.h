@@ -1,10 +1,22 @@
 #ifndef BGEN_IO_H
 #define BGEN_IO_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
-int     bgen_fseek(FILE* stream, int64_t offset, int origin);
-int64_t bgen_ftell(FILE* stream);
+int         bgen_fseek(FILE* stream, int64_t offset, int origin);
+int64_t     bgen_ftell(FILE* stream);
+char const* bgen_mmap(FILE* stream, uint64_t* size);
+int         bgen_munmap(char const* addr, uint64_t size);
+/* Stream for `bgen_pread` on the file of `stream`: `stream` itself where positional reads
+ * leave the cursor untouched, or a second handle to be closed on its own otherwise (i.e., on
+ * Windows). Return `NULL` on failure. */
+FILE*   bgen_pread_open(FILE* stream, char const* filepath);
+int64_t bgen_pread(FILE* stream, void* dst, size_t size, uint64_t offset);
+/* Hint the operating system that a file range (or a range of a mapping) will be read soon.
+ * It does nothing where no such hint is available. */
+void bgen_fadvise_willneed(FILE* stream, uint64_t offset, uint64_t size);
+void bgen_madvise_willneed(char const* addr, uint64_t offset, uint64_t size);
 
 #endif
@@ -8,35 +8,35 @@
 #include "zip/zlib.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void  read_unphased64(struct bgen_genotype* vg, double* probs);
 static void  read_unphased32(struct bgen_genotype* vg, float* probs);
-static char* decompress(struct bgen_file* bgen_file);
+static int   decompress(struct bgen_file* bgen_file, struct bgen_genotype* genotype);
 
 int bgen_layout1_read_header(struct bgen_file* bgen_file, struct bgen_genotype* genotype)
 {
-    char* chunk = NULL;
-
     if (bgen_file_compression(bgen_file) > 0) {
-        chunk = decompress(bgen_file);
+        if (decompress(bgen_file, genotype))
+            return 1;
     } else {
-        size_t size = 6 * bgen_file_nsamples(bgen_file);
-        chunk = malloc(size);
-
-        FILE* stream = bgen_file_stream(bgen_file);
-        if (fread(chunk, size, 1, stream) < 1) {
-            bgen_free(chunk);
+        size_t      size = 6 * (size_t)bgen_file_nsamples(bgen_file);
+        char const* chunk = bgen_file_view_block(bgen_file, genotype, genotype->offset, size,
+                                                 &genotype->chunk);
+        if ((genotype->chunk_ptr = chunk) == NULL) {
+            bgen_error("could not read chunk");
             return 1;
         }
+        genotype->block_size = size;
     }
 
     genotype->nsamples = bgen_file_nsamples(bgen_file);
     genotype->nalleles = 2;
+    genotype->phased = 0;
+    genotype->ploidy_missingness = NULL;
     genotype->ncombs = 3;
     genotype->min_ploidy = 2;
     genotype->max_ploidy = 2;
-    genotype->chunk = chunk;
-    genotype->chunk_ptr = chunk;
 
     return 0;
 }
@@ -51,63 +51,188 @@ void bgen_layout1_read_genotype32(struct bgen_genotype* genotype, float* probs)
     read_unphased32(genotype, probs);
 }
 
+/* Number of probabilities converted per step by `convert_u16`. */
+#define CONVERT_BLOCK 16
+
+/* Convert `n` little-endian 16-bit probabilities. The fixed-size inner loop is turned into
+ * vector instructions by the compiler, also at `-O2`. */
+#define MAKE_CONVERT_U16(BITS, FPTYPE)                                                        \
+    static void convert_u16_##BITS(FPTYPE* restrict dst, unsigned char const* restrict src,   \
+                                   size_t n)                                                  \
+    {                                                                                         \
+        FPTYPE const inv = (FPTYPE)1 / 32768;                                                 \
+        size_t       i = 0;                                                                   \
+        for (; i + CONVERT_BLOCK <= n; i += CONVERT_BLOCK) {                                  \
+            uint16_t block[CONVERT_BLOCK];                                                    \
+            memcpy(block, src + 2 * i, sizeof(block));                                        \
+            for (size_t k = 0; k < CONVERT_BLOCK; ++k)                                        \
+                dst[i + k] = (FPTYPE)block[k] * inv;                                          \
+        }                                                                                     \
+        for (; i < n; ++i) {                                                                  \
+            uint16_t ui_prob = 0;                                                             \
+            memcpy(&ui_prob, src + 2 * i, sizeof(ui_prob));                                   \
+            dst[i] = (FPTYPE)ui_prob * inv;                                                   \
+        }                                                                                     \
+    }
+
+MAKE_CONVERT_U16(64, double)
+MAKE_CONVERT_U16(32, float)
+
+/* Samples are converted all at once, and those missing (all three values zero) patched. */
 #define MAKE_READ_UNPHASED(BITS, FPTYPE)                                                      \
     static void read_unphased##BITS(struct bgen_genotype* genotype, FPTYPE* probs)            \
     {                                                                                         \
-        uint16_t ui_prob = 0;                                                                 \
+        size_t const n = 3 * (size_t)genotype->nsamples;                                      \
+        convert_u16_##BITS(probs, (unsigned char const*)genotype->chunk_ptr, n);              \
+                                                                                              \
+        for (size_t i = 0; i < n; i += 3) {                                                   \
+            if (probs[i] + probs[i + 1] + probs[i + 2] == 0)                                  \
+                probs[i] = probs[i + 1] = probs[i + 2] = NAN;                                 \
+        }                                                                                     \
+    }
+
+MAKE_READ_UNPHASED(64, double)
+MAKE_READ_UNPHASED(32, float)
+
+#define MAKE_READ_SUBSET(BITS, FPTYPE)                                                        \
+    void bgen_layout1_read_subset##BITS(struct bgen_genotype* genotype,                       \
+                                        uint32_t const* samples, uint32_t nselected,          \
+                                        FPTYPE* probs)                                        \
+    {                                                                                         \
+        uint16_t ui_prob[3] = {0, 0, 0};                                                      \
         FPTYPE   denom = 32768;                                                               \
                                                                                               \
-        char const* restrict chunk = genotype->chunk_ptr;                                     \
+        for (uint32_t i = 0; i < nselected; ++i) {                                            \
+            char const* chunk = genotype->chunk_ptr + 6 * (size_t)samples[i];                 \
+            bgen_memfread(ui_prob, &chunk, sizeof(ui_prob));                                  \
                                                                                               \
-        for (uint32_t j = 0; j < genotype->nsamples; ++j) {                                   \
-            unsigned int ui_prob_sum = 0;                                                     \
+            for (size_t c = 0; c < 3; ++c)                                                    \
+                probs[i * 3 + c] = ui_prob[c] / denom;                                        \
                                                                                               \
-            for (size_t i = 0; i < 3; ++i) {                                                  \
-                bgen_memfread(&ui_prob, &chunk, 2);                                           \
-                probs[j * 3 + i] = ui_prob / denom;                                           \
-                ui_prob_sum += ui_prob;                                                       \
+            if (ui_prob[0] + ui_prob[1] + ui_prob[2] == 0) {                                  \
+                for (size_t c = 0; c < 3; ++c)                                                \
+                    probs[i * 3 + c] = NAN;                                                   \
             }                                                                                 \
+        }                                                                                     \
+    }
+
+MAKE_READ_SUBSET(64, double)
+MAKE_READ_SUBSET(32, float)
+
+#define MAKE_READ_DOSAGE(BITS, FPTYPE)                                                        \
+    void bgen_layout1_read_dosage##BITS(struct bgen_genotype* genotype, FPTYPE* dosages)      \
+    {                                                                                         \
+        uint16_t ui_prob[3] = {0, 0, 0};                                                      \
+        FPTYPE   denom = 32768;                                                               \
                                                                                               \
-            if (ui_prob_sum == 0) {                                                           \
-                for (size_t i = 0; i < 3; ++i)                                                \
-                    probs[j * 3 + i] = NAN;                                                   \
-            }                                                                                 \
+        char const* restrict chunk = genotype->chunk_ptr;                                     \
+                                                                                              \
+        for (uint32_t j = 0; j < genotype->nsamples; ++j) {                                   \
+            bgen_memfread(ui_prob, &chunk, sizeof(ui_prob));                                  \
+                                                                                              \
+            if (ui_prob[0] + ui_prob[1] + ui_prob[2] == 0)                                    \
+                dosages[j] = NAN;                                                             \
+            else                                                                              \
+                dosages[j] = (FPTYPE)(ui_prob[1] + 2 * ui_prob[2]) / denom;                   \
         }                                                                                     \
     }
 
-MAKE_READ_UNPHASED(64, double)
-MAKE_READ_UNPHASED(32, float)
+MAKE_READ_DOSAGE(64, double)
+MAKE_READ_DOSAGE(32, float)
+
+void bgen_layout1_read_dosage8(struct bgen_genotype* genotype, uint8_t* dosages)
+{
+    uint16_t    ui_prob[3] = {0, 0, 0};
+    char const* chunk = genotype->chunk_ptr;
+
+    for (uint32_t j = 0; j < genotype->nsamples; ++j) {
+        bgen_memfread(ui_prob, &chunk, sizeof(ui_prob));
+
+        if (ui_prob[0] + ui_prob[1] + ui_prob[2] == 0) {
+            dosages[j] = 255;
+            continue;
+        }
+        /* Scale from `[0, 2]` (in units of 1/32768) to `[0, 254]` and round. */
+        unsigned dosage = ((unsigned)ui_prob[1] + 2u * ui_prob[2]) * 254u;
+        unsigned scaled = (dosage + 32768) / 65536;
+        dosages[j] = (uint8_t)(scaled > 254 ? 254 : scaled);
+    }
+}
 
-static char* decompress(struct bgen_file* bgen_file)
+void bgen_layout1_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                 double threshold)
+{
+    uint16_t    ui_prob[3] = {0, 0, 0};
+    char const* chunk = genotype->chunk_ptr;
+    unsigned    cut = threshold > 0 ? (unsigned)ceil(threshold * 32768) : 0;
+
+    for (uint32_t j = 0; j < genotype->nsamples; ++j) {
+        bgen_memfread(ui_prob, &chunk, sizeof(ui_prob));
+
+        int8_t best = 0;
+        for (int8_t i = 1; i < 3; ++i) {
+            if (ui_prob[i] > ui_prob[best])
+                best = i;
+        }
+        if (ui_prob[best] == 0 || ui_prob[best] < cut)
+            best = -1;
+        calls[j] = best;
+    }
+}
+
+bool bgen_layout1_missing(struct bgen_genotype const* genotype, uint32_t index)
+{
+    uint16_t    ui_prob[3] = {0, 0, 0};
+    char const* chunk = genotype->chunk_ptr + 6 * (size_t)index;
+    bgen_memfread(ui_prob, &chunk, sizeof(ui_prob));
+    return ui_prob[0] + ui_prob[1] + ui_prob[2] == 0;
+}
+
+static int decompress(struct bgen_file* bgen_file, struct bgen_genotype* genotype)
 {
     uint32_t compressed_length = 0;
-    FILE*    stream = bgen_file_stream(bgen_file);
+    uint64_t offset = genotype->offset;
 
-    if (fread(&compressed_length, sizeof(compressed_length), 1, stream) < 1) {
-        bgen_perror_eof(stream, "could not read chunk size");
-        return NULL;
+    if (bgen_file_read_block(bgen_file, genotype, offset, &compressed_length,
+                             sizeof(compressed_length))) {
+        bgen_error("could not read chunk size");
+        return 1;
     }
 
-    char* compressed_chunk = malloc(compressed_length);
+    offset += sizeof(compressed_length);
+    char const* compressed_chunk = bgen_file_view_block(
+        bgen_file, genotype, offset, compressed_length, &genotype->compressed);
 
-    if (fread(compressed_chunk, compressed_length, 1, stream) < 1) {
-        bgen_perror_eof(stream, "could not read compressed chunk");
-        bgen_free(compressed_chunk);
-        return NULL;
+    if (compressed_chunk == NULL) {
+        bgen_error("could not read compressed chunk");
+        return 1;
     }
+    genotype->block_size = sizeof(compressed_length) + (size_t)compressed_length;
 
     if (bgen_file_compression(bgen_file) != 1) {
         bgen_error("compression flag should be 1; not %u", bgen_file_compression(bgen_file));
-        bgen_free(compressed_chunk);
-        return NULL;
+        return 1;
     }
 
-    size_t length = 10 * compressed_length;
-    char*  chunk = malloc(length);
+    /* Three 16-bit probabilities per sample: the inflated size is known beforehand. Lazy
+     * handlers are inflated at once as well, since missingness lies among the
+     * probabilities. */
+    size_t const expected = 6 * (size_t)bgen_file_nsamples(bgen_file);
+    if (bgen_buffer_reserve(&genotype->chunk, expected) == NULL) {
+        bgen_error("could not malloc chunk");
+        return 1;
+    }
 
-    bgen_unzlib_chunked(compressed_chunk, compressed_length, &chunk, &length);
+    size_t length = expected;
+    if (bgen_unzlib(genotype->zlib, compressed_chunk, compressed_length, &genotype->chunk.data,
+                    &length))
+        return 1;
 
-    bgen_free(compressed_chunk);
+    if (length != expected) {
+        bgen_error("unexpected uncompressed chunk size (corrupted file?)");
+        return 1;
+    }
 
-    return chunk;
+    genotype->chunk_ptr = genotype->chunk.data;
+    return 0;
 }
@@ -1,11 +1,25 @@
 #ifndef BGEN_LAYOUT1_H
 #define BGEN_LAYOUT1_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 struct bgen_file;
 struct bgen_genotype;
 
 int  bgen_layout1_read_header(struct bgen_file* bgen_file, struct bgen_genotype* genotype);
 void bgen_layout1_read_genotype64(struct bgen_genotype* genotype, double* probs);
 void bgen_layout1_read_genotype32(struct bgen_genotype* genotype, float* probs);
+void bgen_layout1_read_subset64(struct bgen_genotype* genotype, uint32_t const* samples,
+                                uint32_t nselected, double* probs);
+void bgen_layout1_read_subset32(struct bgen_genotype* genotype, uint32_t const* samples,
+                                uint32_t nselected, float* probs);
+void bgen_layout1_read_dosage64(struct bgen_genotype* genotype, double* dosages);
+void bgen_layout1_read_dosage32(struct bgen_genotype* genotype, float* dosages);
+void bgen_layout1_read_dosage8(struct bgen_genotype* genotype, uint8_t* dosages);
+void bgen_layout1_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                 double threshold);
+/* Whether the three probabilities of the sample are zero. */
+bool bgen_layout1_missing(struct bgen_genotype const* genotype, uint32_t index);
 
 #endif
@@ -1,32 +1,40 @@
 #include "layout2.h"
+#include "bgen/file.h"
 #include "bmath.h"
 #include "file.h"
 #include "free.h"
 #include "genotype.h"
 #include "mem.h"
+#include "unpack.h"
 #include "zip/zlib.h"
 #include "zip/zstd.h"
 #include <inttypes.h>
 #include <math.h>
+#include <stdbool.h>
 
-#define BIT(var, bit) ((var & (1 << bit)) != 0)
+/* Number of probabilities unpacked at a time by `read_uniform_ploidy`. */
+#define UNPACK_BLOCK 2048
 
 static void  read_phased_genotype64(struct bgen_genotype* genotype, double* probs);
 static void  read_phased_genotype32(struct bgen_genotype* genotype, float* probs);
 static void  read_unphased_genotype64(struct bgen_genotype* genotype, double* probs);
 static void  read_unphased_genotype32(struct bgen_genotype* genotype, float* probs);
-static char* decompress(struct bgen_file* bgen_file);
+static void  read_uniform_ploidy64(struct bgen_genotype* genotype, double* probs);
+static void  read_uniform_ploidy32(struct bgen_genotype* genotype, float* probs);
+static void  read_biallelic_diploid8_64(struct bgen_genotype* genotype, double* probs);
+static void  read_biallelic_diploid8_32(struct bgen_genotype* genotype, float* probs);
+static void  read_biallelic_diploid16_64(struct bgen_genotype* genotype, double* probs);
+static void  read_biallelic_diploid16_32(struct bgen_genotype* genotype, float* probs);
+static void  select_decoder(struct bgen_genotype* genotype);
+static int   decompress(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                        uint32_t length, size_t* chunk_size);
+static int   decompress_head(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                             uint32_t length, size_t* chunk_size);
 
 static inline uint8_t read_ploidy(uint8_t ploidy_miss) { return ploidy_miss & 127; }
 
 static inline int read_missingness(uint8_t ploidy_miss) { return ploidy_miss >> 7; }
 
-static inline int get_bit(char const* mem, uint64_t bit_idx)
-{
-    uint64_t bytes = bit_idx / 8;
-    return BIT(*(mem + bytes), bit_idx % 8);
-}
-
 static inline void set_array_nan64(double* p, size_t n)
 {
     for (size_t i = 0; i < n; ++i)
@@ -41,36 +49,49 @@ static inline void set_array_nan32(float* p, size_t n)
 
 int bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype* genotype)
 {
-    uint32_t nsamples = 0;
-    uint8_t* plo_miss = NULL;
-
+    uint32_t    nsamples = 0;
     char const* chunk_ptr = NULL;
-    char*       chunk = NULL;
+    size_t      chunk_size = 0;
+
+    uint32_t length = 0;
+    if (bgen_file_read_block(bgen_file, genotype, genotype->offset, &length, sizeof(length))) {
+        bgen_error("could not read chunk length");
+        goto err;
+    }
 
     if (bgen_file_compression(bgen_file) > 0) {
 
-        if ((chunk = decompress(bgen_file)) == NULL) {
+        if (genotype->lazy && genotype->block == NULL) {
+            if (decompress_head(bgen_file, genotype, length, &chunk_size))
+                goto err;
+        } else if (decompress(bgen_file, genotype, length, &chunk_size)) {
             goto err;
         }
-
-        chunk_ptr = chunk;
-        bgen_memfread(&nsamples, &chunk_ptr, sizeof(nsamples));
+        chunk_ptr = genotype->chunk.data;
 
     } else {
 
-        if (fread(&nsamples, sizeof(nsamples), 1, bgen_file_stream(bgen_file)) < 1) {
-            bgen_perror_eof(bgen_file_stream(bgen_file), "could not read number of samples");
+        chunk_size = length;
+        uint64_t offset = genotype->offset + sizeof(length);
+        chunk_ptr =
+            bgen_file_view_block(bgen_file, genotype, offset, chunk_size, &genotype->chunk);
+        if (chunk_ptr == NULL) {
+            bgen_error("could not read chunk");
             goto err;
         }
+    }
 
-        chunk = malloc(6 * nsamples);
+    char const* chunk_end = chunk_ptr + chunk_size;
 
-        if (fread(chunk, 6 * nsamples, 1, bgen_file_stream(bgen_file)) < 1) {
-            bgen_perror_eof(bgen_file_stream(bgen_file), "could not read chunk");
-            goto err;
-        }
+    if (chunk_size < sizeof(nsamples)) {
+        bgen_error("chunk is too small (corrupted file?)");
+        goto err;
+    }
+    bgen_memfread(&nsamples, &chunk_ptr, sizeof(nsamples));
 
-        chunk_ptr = chunk;
+    if (chunk_size < (size_t)nsamples + 10) {
+        bgen_error("chunk is too small (corrupted file?)");
+        goto err;
     }
 
     uint16_t nalleles = 0;
@@ -82,11 +103,8 @@ int bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype*
     genotype->min_ploidy = min_ploidy;
     genotype->max_ploidy = max_ploidy;
 
-    plo_miss = malloc(nsamples * sizeof(uint8_t));
-
-    for (uint32_t i = 0; i < nsamples; ++i) {
-        plo_miss[i] = (uint8_t)chunk_ptr[i];
-    }
+    /* Point straight into the chunk: no need for a copy. */
+    genotype->ploidy_missingness = (uint8_t const*)chunk_ptr;
     chunk_ptr += nsamples;
 
     uint8_t phased = 0;
@@ -98,7 +116,6 @@ int bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype*
     genotype->nalleles = nalleles;
     genotype->phased = phased;
     genotype->nbits = nbits;
-    genotype->ploidy_missingness = plo_miss;
 
     if (genotype->max_ploidy == 0) {
         bgen_error("`max_ploidy` cannot be zero");
@@ -108,6 +125,10 @@ int bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype*
         bgen_error("`nalleles` cannot be zero");
         goto err;
     }
+    if (genotype->nbits > 32) {
+        bgen_error("`nbits` cannot be greater than 32");
+        goto err;
+    }
 
     if (phased)
         genotype->ncombs = (unsigned)nalleles * (unsigned)genotype->max_ploidy;
@@ -115,33 +136,78 @@ int bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype*
         genotype->ncombs = choose((unsigned)nalleles + (unsigned)(genotype->max_ploidy - 1),
                                   (unsigned)(nalleles - 1));
 
-    genotype->chunk = chunk;
     genotype->chunk_ptr = chunk_ptr;
+    genotype->chunk_end = chunk_end;
+    genotype->sample_offsets_ready = false;
+    select_decoder(genotype);
+
+    /* Only the header has been decompressed: the probabilities are yet to come. */
+    if (genotype->deferred) {
+        genotype->chunk_ptr = NULL;
+        genotype->chunk_end = NULL;
+    }
+    genotype->block_size = sizeof(length) + (size_t)length;
 
     return 0;
 
 err:
-    bgen_free(chunk);
-    bgen_free(plo_miss);
-    genotype->chunk = NULL;
+    genotype->deferred = false;
+    genotype->chunk_ptr = NULL;
+    genotype->chunk_end = NULL;
     genotype->ploidy_missingness = NULL;
     return 1;
 }
 
 void bgen_layout2_read_genotype64(struct bgen_genotype* genotype, double* probs)
 {
-    if (genotype->phased)
-        read_phased_genotype64(genotype, probs);
-    else
-        read_unphased_genotype64(genotype, probs);
+    genotype->read64(genotype, probs);
 }
 
 void bgen_layout2_read_genotype32(struct bgen_genotype* genotype, float* probs)
 {
-    if (genotype->phased)
-        read_phased_genotype32(genotype, probs);
-    else
-        read_unphased_genotype32(genotype, probs);
+    genotype->read32(genotype, probs);
+}
+
+/* Bytes of probabilities the chunk holds, or will hold once decompressed in full. */
+static size_t probabilities_size(struct bgen_genotype const* genotype)
+{
+    if (genotype->deferred)
+        return genotype->unpacked_size - (10 + (size_t)genotype->nsamples);
+    return (size_t)(genotype->chunk_end - genotype->chunk_ptr);
+}
+
+static void select_decoder(struct bgen_genotype* genotype)
+{
+    uint8_t const nbits = genotype->nbits;
+
+    /* The byte-aligned decoders read every sample unchecked: the chunk must hold them all. */
+    if (!genotype->phased && genotype->nalleles == 2 && genotype->min_ploidy == 2 &&
+        genotype->max_ploidy == 2 &&
+        probabilities_size(genotype) >= 2 * (size_t)(nbits / 8) * genotype->nsamples) {
+        if (nbits == 8) {
+            genotype->read64 = read_biallelic_diploid8_64;
+            genotype->read32 = read_biallelic_diploid8_32;
+            return;
+        }
+        if (nbits == 16) {
+            genotype->read64 = read_biallelic_diploid16_64;
+            genotype->read32 = read_biallelic_diploid16_32;
+            return;
+        }
+    }
+
+    /* Every sample stores the same number of probabilities: unpack them in bulk. */
+    unsigned nvalues = genotype->phased ? genotype->max_ploidy * (genotype->nalleles - 1u)
+                                        : genotype->ncombs - 1;
+    bool const uniform = genotype->min_ploidy == genotype->max_ploidy;
+    if (uniform && nvalues > 0 && nvalues <= UNPACK_BLOCK) {
+        genotype->read64 = read_uniform_ploidy64;
+        genotype->read32 = read_uniform_ploidy32;
+        return;
+    }
+
+    genotype->read64 = genotype->phased ? read_phased_genotype64 : read_unphased_genotype64;
+    genotype->read32 = genotype->phased ? read_phased_genotype32 : read_unphased_genotype32;
 }
 
 #define MAKE_READ_PHASED_GENOTYPE(BITS, FPTYPE)                                               \
@@ -151,6 +217,10 @@ void bgen_layout2_read_genotype32(struct bgen_genotype* genotype, float* probs)
         unsigned nalleles = genotype->nalleles;                                               \
         uint8_t  max_ploidy = genotype->max_ploidy;                                           \
         FPTYPE   denom = (FPTYPE)((((uint64_t)1 << nbits)) - 1);                              \
+        FPTYPE   inv = 1 / denom;                                                             \
+                                                                                              \
+        char const* chunk = genotype->chunk_ptr;                                              \
+        char const* end = genotype->chunk_end;                                                \
                                                                                               \
         uint64_t sample_start = 0;                                                            \
         for (uint32_t j = 0; j < genotype->nsamples; ++j) {                                   \
@@ -171,22 +241,15 @@ void bgen_layout2_read_genotype32(struct bgen_genotype* genotype, float* probs)
                 uint64_t allele_start = 0;                                                    \
                 for (uint16_t ii = 0; ii < nalleles - 1; ++ii) {                              \
                                                                                               \
-                    uint64_t ui_prob = 0;                                                     \
                     uint64_t offset = sample_start + haplo_start + allele_start;              \
+                    uint64_t ui_prob = bgen_read_bits(chunk, end, offset, nbits);             \
                                                                                               \
-                    for (uint8_t bi = 0; bi < nbits; ++bi) {                                  \
-                                                                                              \
-                        if (get_bit(genotype->chunk_ptr, bi + offset)) {                      \
-                            ui_prob |= ((uint64_t)1 << bi);                                   \
-                        }                                                                     \
-                    }                                                                         \
-                                                                                              \
-                    *probs = (FPTYPE)ui_prob / denom;                                         \
+                    *probs = (FPTYPE)ui_prob * inv;                                           \
                     ++probs;                                                                  \
                     uip_sum += ui_prob;                                                       \
                     allele_start += nbits;                                                    \
                 }                                                                             \
-                *probs = (denom - (FPTYPE)uip_sum) / denom;                                   \
+                *probs = (denom - (FPTYPE)uip_sum) * inv;                                     \
                 ++probs;                                                                      \
                 haplo_start += nbits * (nalleles - 1);                                        \
             }                                                                                 \
@@ -207,9 +270,13 @@ MAKE_READ_PHASED_GENOTYPE(32, float)
         uint8_t  max_ploidy = genotype->max_ploidy;                                           \
                                                                                               \
         FPTYPE   denom = (FPTYPE)((((uint64_t)1 << nbits)) - 1);                              \
+        FPTYPE   inv = 1 / denom;                                                             \
         unsigned max_ncombs =                                                                 \
             choose(nalleles + (unsigned)(max_ploidy - 1), (unsigned)(nalleles - 1));          \
                                                                                               \
+        char const* chunk = genotype->chunk_ptr;                                              \
+        char const* end = genotype->chunk_end;                                                \
+                                                                                              \
         uint64_t sample_start = 0;                                                            \
         for (uint32_t j = 0; j < genotype->nsamples; ++j) {                                   \
             FPTYPE*  pend = probs + max_ncombs;                                               \
@@ -229,22 +296,15 @@ MAKE_READ_PHASED_GENOTYPE(32, float)
             uint64_t geno_start = 0;                                                          \
             for (uint8_t i = 0; i < (uint8_t)(ncombs - 1); ++i) {                             \
                                                                                               \
-                uint##BITS##_t ui_prob = 0;                                                   \
                 uint64_t       offset = sample_start + geno_start;                            \
+                uint##BITS##_t ui_prob = bgen_read_bits(chunk, end, offset, nbits);           \
                                                                                               \
-                for (uint8_t bi = 0; bi < (uint8_t)nbits; ++bi) {                             \
-                                                                                              \
-                    if (get_bit(genotype->chunk_ptr, bi + offset)) {                          \
-                        ui_prob |= ((uint##BITS##_t)1 << bi);                                 \
-                    }                                                                         \
-                }                                                                             \
-                                                                                              \
-                *probs = (FPTYPE)ui_prob / denom;                                             \
+                *probs = (FPTYPE)ui_prob * inv;                                               \
                 ++probs;                                                                      \
                 uip_sum += ui_prob;                                                           \
                 geno_start += nbits;                                                          \
             }                                                                                 \
-            *probs = (denom - (FPTYPE)uip_sum) / denom;                                       \
+            *probs = (denom - (FPTYPE)uip_sum) * inv;                                         \
             ++probs;                                                                          \
             sample_start += nbits * (ncombs - 1);                                             \
             set_array_nan##BITS(probs, (size_t)(pend - probs));                               \
@@ -255,65 +315,473 @@ MAKE_READ_PHASED_GENOTYPE(32, float)
 MAKE_UNPHASED_GENOTYPE(64, double)
 MAKE_UNPHASED_GENOTYPE(32, float)
 
-static char* decompress(struct bgen_file* bgen_file)
+/* Same ploidy for every sample: each one is made of `ngroups` groups (haplotypes if phased;
+ * a single one otherwise) of `nfree` packed probabilities, completed by the remaining one. */
+#define MAKE_READ_UNIFORM_PLOIDY(BITS, FPTYPE)                                                \
+    static void read_uniform_ploidy##BITS(struct bgen_genotype* genotype, FPTYPE* probs)      \
+    {                                                                                         \
+        unsigned const nbits = genotype->nbits;                                               \
+        unsigned const ngroups = genotype->phased ? genotype->max_ploidy : 1;                 \
+        unsigned const nfree =                                                                \
+            genotype->phased ? genotype->nalleles - 1u : genotype->ncombs - 1;                \
+        unsigned const nvalues = ngroups * nfree;                                             \
+        uint32_t const block = UNPACK_BLOCK / nvalues;                                        \
+        FPTYPE const   denom = (FPTYPE)((((uint64_t)1 << nbits)) - 1);                        \
+        FPTYPE const   inv = 1 / denom;                                                       \
+        uint32_t       values[UNPACK_BLOCK];                                                  \
+                                                                                              \
+        uint64_t offset = 0;                                                                  \
+        for (uint32_t j = 0; j < genotype->nsamples; j += block) {                            \
+            uint32_t n = genotype->nsamples - j < block ? genotype->nsamples - j : block;     \
+            bgen_unpack_bits(values, genotype->chunk_ptr, genotype->chunk_end, offset,        \
+                             (size_t)n * nvalues, nbits);                                     \
+            offset += (uint64_t)n * nvalues * nbits;                                          \
+                                                                                              \
+            uint32_t const* v = values;                                                       \
+            for (uint32_t k = j; k < j + n; ++k) {                                            \
+                if (read_missingness(genotype->ploidy_missingness[k]) != 0) {                 \
+                    set_array_nan##BITS(probs, nvalues + ngroups);                            \
+                    probs += nvalues + ngroups;                                               \
+                    v += nvalues;                                                             \
+                    continue;                                                                 \
+                }                                                                             \
+                for (unsigned g = 0; g < ngroups; ++g) {                                      \
+                    uint64_t sum = 0;                                                         \
+                    for (unsigned i = 0; i < nfree; ++i) {                                    \
+                        *probs++ = (FPTYPE)v[i] * inv;                                        \
+                        sum += v[i];                                                          \
+                    }                                                                         \
+                    *probs++ = (denom - (FPTYPE)sum) * inv;                                   \
+                    v += nfree;                                                               \
+                }                                                                             \
+            }                                                                                 \
+        }                                                                                     \
+    }
+
+MAKE_READ_UNIFORM_PLOIDY(64, double)
+MAKE_READ_UNIFORM_PLOIDY(32, float)
+
+/* Number of probabilities stored for a sample of the given ploidy. */
+static inline unsigned sample_nvalues(struct bgen_genotype const* genotype, unsigned ploidy)
 {
-    char* compressed_chunk = NULL;
-    char* chunk = NULL;
+    unsigned nalleles = genotype->nalleles;
+    if (genotype->phased)
+        return ploidy * (nalleles - 1);
+    return choose(nalleles + ploidy - 1, nalleles - 1) - 1;
+}
 
-    size_t compressed_length = 0;
-    if (fread(&compressed_length, 4, 1, bgen_file_stream(bgen_file)) < 1) {
-        bgen_perror_eof(bgen_file_stream(bgen_file), "could not read compressed length");
-        goto err;
+/* Bit offset of every sample, built once per variant. Return `NULL` on failure. */
+static uint64_t const* sample_offsets(struct bgen_genotype* genotype)
+{
+    size_t    size = sizeof(uint64_t) * genotype->nsamples;
+    uint64_t* offsets = (uint64_t*)bgen_buffer_reserve(&genotype->sample_offsets, size);
+    if (offsets == NULL) {
+        bgen_error("could not malloc sample offsets");
+        return NULL;
     }
-    if (compressed_length < 4) {
+
+    if (!genotype->sample_offsets_ready) {
+        /* Ploidies are cached as the table is filled: choose() is not cheap. */
+        unsigned nvalues[128] = {0};
+        bool     known[128] = {false};
+        uint64_t offset = 0;
+        for (uint32_t j = 0; j < genotype->nsamples; ++j) {
+            uint8_t ploidy = read_ploidy(genotype->ploidy_missingness[j]);
+            if (!known[ploidy]) {
+                nvalues[ploidy] = sample_nvalues(genotype, ploidy);
+                known[ploidy] = true;
+            }
+            offsets[j] = offset;
+            offset += (uint64_t)nvalues[ploidy] * genotype->nbits;
+        }
+        genotype->sample_offsets_ready = true;
+    }
+    return offsets;
+}
+
+/* Decode the selected samples only, locating each one from its bit offset. */
+#define MAKE_READ_SUBSET(BITS, FPTYPE)                                                        \
+    int bgen_layout2_read_subset##BITS(struct bgen_genotype* genotype,                        \
+                                       uint32_t const* samples, uint32_t nselected,           \
+                                       FPTYPE* probs)                                         \
+    {                                                                                         \
+        unsigned const nbits = genotype->nbits;                                               \
+        FPTYPE const   denom = (FPTYPE)((((uint64_t)1 << nbits)) - 1);                        \
+        FPTYPE const   inv = 1 / denom;                                                       \
+        char const*    chunk = genotype->chunk_ptr;                                           \
+        char const*    end = genotype->chunk_end;                                             \
+        bool const     uniform = genotype->min_ploidy == genotype->max_ploidy;                \
+        uint64_t const stride = (uint64_t)sample_nvalues(genotype, genotype->max_ploidy) *    \
+                                nbits;                                                        \
+                                                                                              \
+        uint64_t const* offsets = NULL;                                                       \
+        if (!uniform && (offsets = sample_offsets(genotype)) == NULL)                         \
+            return 1;                                                                         \
+                                                                                              \
+        for (uint32_t i = 0; i < nselected; ++i) {                                            \
+            uint32_t const j = samples[i];                                                    \
+            uint8_t const  ploidy = read_ploidy(genotype->ploidy_missingness[j]);             \
+            FPTYPE*        pend = probs + genotype->ncombs;                                   \
+                                                                                              \
+            if (read_missingness(genotype->ploidy_missingness[j]) != 0) {                     \
+                set_array_nan##BITS(probs, (size_t)(pend - probs));                           \
+                probs = pend;                                                                 \
+                continue;                                                                     \
+            }                                                                                 \
+                                                                                              \
+            uint64_t       offset = uniform ? j * stride : offsets[j];                        \
+            unsigned const ngroups = genotype->phased ? ploidy : 1;                           \
+            unsigned const nfree = genotype->phased ? genotype->nalleles - 1u                 \
+                                                    : sample_nvalues(genotype, ploidy);       \
+            for (unsigned g = 0; g < ngroups; ++g) {                                          \
+                uint64_t sum = 0;                                                             \
+                for (unsigned a = 0; a < nfree; ++a) {                                        \
+                    uint32_t v = bgen_read_bits(chunk, end, offset, nbits);                   \
+                    *probs++ = (FPTYPE)v * inv;                                               \
+                    sum += v;                                                                 \
+                    offset += nbits;                                                          \
+                }                                                                             \
+                *probs++ = (denom - (FPTYPE)sum) * inv;                                       \
+            }                                                                                 \
+            set_array_nan##BITS(probs, (size_t)(pend - probs));                               \
+            probs = pend;                                                                     \
+        }                                                                                     \
+        return 0;                                                                             \
+    }
+
+MAKE_READ_SUBSET(64, double)
+MAKE_READ_SUBSET(32, float)
+
+#define LOAD8(p) ((unsigned)(p)[0])
+#define LOAD16(p) ((unsigned)(p)[0] | (unsigned)(p)[1] << 8)
+
+/* Biallelic, diploid, and unphased: two byte-aligned probabilities per sample. */
+#define MAKE_READ_BIALLELIC_DIPLOID(NBITS, BITS, FPTYPE)                                      \
+    static void read_biallelic_diploid##NBITS##_##BITS(struct bgen_genotype* genotype,        \
+                                                       FPTYPE*               probs)           \
+    {                                                                                         \
+        FPTYPE const                  denom = (FPTYPE)((1u << NBITS) - 1);                    \
+        FPTYPE const                  inv = 1 / denom;                                        \
+        uint8_t const*                ploidy_miss = genotype->ploidy_missingness;             \
+        unsigned char const* restrict chunk = (unsigned char const*)genotype->chunk_ptr;      \
+                                                                                              \
+        for (uint32_t j = 0; j < genotype->nsamples; ++j) {                                   \
+            if (read_missingness(ploidy_miss[j]) != 0) {                                      \
+                probs[0] = probs[1] = probs[2] = NAN;                                         \
+            } else {                                                                          \
+                unsigned a = LOAD##NBITS(chunk);                                              \
+                unsigned b = LOAD##NBITS(chunk + NBITS / 8);                                  \
+                probs[0] = (FPTYPE)a * inv;                                                   \
+                probs[1] = (FPTYPE)b * inv;                                                   \
+                probs[2] = (denom - (FPTYPE)(a + b)) * inv;                                   \
+            }                                                                                 \
+            chunk += 2 * (NBITS / 8);                                                         \
+            probs += 3;                                                                       \
+        }                                                                                     \
+    }
+
+MAKE_READ_BIALLELIC_DIPLOID(8, 64, double)
+MAKE_READ_BIALLELIC_DIPLOID(8, 32, float)
+MAKE_READ_BIALLELIC_DIPLOID(16, 64, double)
+MAKE_READ_BIALLELIC_DIPLOID(16, 32, float)
+
+/* A biallelic sample of ploidy `n` stores `n` probabilities: the first allele's of each
+ * haplotype if phased, or those of the first `n` genotypes (ordered by the number of copies
+ * of the second allele) if unphased. */
+
+/* Expected number of copies of the second allele, in units of `1 / denom`. */
+static inline int64_t sample_dosage(uint32_t const* v, unsigned ploidy, bool phased,
+                                    int64_t denom)
+{
+    int64_t dosage = (int64_t)ploidy * denom;
+    for (unsigned i = 0; i < ploidy; ++i)
+        dosage -= (int64_t)(phased ? 1 : ploidy - i) * v[i];
+    return dosage;
+}
+
+/* Dosage scaled from `[0, ploidy]` to `[0, 254]` and rounded, leaving `255` for missing. */
+static inline uint8_t quantize_dosage(int64_t dosage, unsigned ploidy, int64_t denom)
+{
+    int64_t total = (int64_t)ploidy * denom;
+    if (total <= 0)
+        return 255;
+    if (dosage <= 0)
+        return 0;
+    if (dosage >= total)
+        return 254;
+    return (uint8_t)((dosage * 508 + total) / (2 * total));
+}
+
+/* Number of copies of the second allele of the most likely genotype, or `-1` if its
+ * probability is below `threshold`. Unphased probabilities are compared to `cut`, the
+ * threshold scaled by `denom` once per variant. */
+static inline int8_t sample_hardcall(uint32_t const* v, unsigned ploidy, bool phased,
+                                     int64_t denom, double threshold, int64_t cut)
+{
+    unsigned best = 0;
+
+    if (!phased) {
+        int64_t rest = denom;
+        int64_t best_value = -1;
+        for (unsigned k = 0; k < ploidy; ++k) {
+            rest -= v[k];
+            if (v[k] > best_value) {
+                best_value = v[k];
+                best = k;
+            }
+        }
+        if (rest > best_value) {
+            best_value = rest;
+            best = ploidy;
+        }
+        return best_value >= cut ? (int8_t)best : -1;
+    }
+
+    /* Haplotypes are independent: convolve their allele probabilities. */
+    double dist[128];
+    dist[0] = 1;
+    for (unsigned h = 0; h < ploidy; ++h) {
+        dist[h + 1] = 0;
+        double q = 1 - (double)v[h] / (double)denom;
+        for (unsigned k = h + 1; k > 0; --k)
+            dist[k] = dist[k] * (1 - q) + dist[k - 1] * q;
+        dist[0] *= 1 - q;
+    }
+    for (unsigned k = 1; k <= ploidy; ++k) {
+        if (dist[k] > dist[best])
+            best = k;
+    }
+    return dist[best] >= threshold ? (int8_t)best : -1;
+}
+
+#define TO_DOSAGE64(v, ploidy, phased, denom, threshold, cut)                                 \
+    ((double)sample_dosage(v, ploidy, phased, denom) * (1 / (double)(denom)))
+#define TO_DOSAGE32(v, ploidy, phased, denom, threshold, cut)                                 \
+    ((float)sample_dosage(v, ploidy, phased, denom) * (1 / (float)(denom)))
+#define TO_DOSAGE8(v, ploidy, phased, denom, threshold, cut)                                  \
+    quantize_dosage(sample_dosage(v, ploidy, phased, denom), ploidy, denom)
+#define TO_HARDCALL(v, ploidy, phased, denom, threshold, cut)                                 \
+    sample_hardcall(v, ploidy, phased, denom, threshold, cut)
+
+/* Reduce each sample of a biallelic variant to a single value, straight from the packed
+ * probabilities. */
+#define MAKE_READ_BIALLELIC(NAME, TYPE, MISSING, CONVERT)                                     \
+    static void read_##NAME(struct bgen_genotype* genotype, TYPE* out, double threshold)      \
+    {                                                                                         \
+        unsigned const nbits = genotype->nbits;                                               \
+        int64_t const  denom = (int64_t)((((uint64_t)1 << nbits)) - 1);                       \
+        int64_t const  cut = (int64_t)ceil(threshold * (double)denom);                        \
+        bool const     phased = genotype->phased;                                             \
+        uint8_t const* ploidy_miss = genotype->ploidy_missingness;                            \
+        uint32_t const nsamples = genotype->nsamples;                                         \
+        uint32_t       values[UNPACK_BLOCK];                                                  \
+        (void)cut; /* Only hard calls need it. */                                             \
+                                                                                              \
+        uint64_t offset = 0;                                                                  \
+        for (uint32_t j = 0; j < nsamples;) {                                                 \
+            /* Unpack the probabilities of as many samples as the block can hold. */          \
+            uint32_t n = 0;                                                                   \
+            size_t   nvalues = 0;                                                             \
+            while (j + n < nsamples &&                                                        \
+                   nvalues + read_ploidy(ploidy_miss[j + n]) <= UNPACK_BLOCK)                 \
+                nvalues += read_ploidy(ploidy_miss[j + n++]);                                 \
+                                                                                              \
+            bgen_unpack_bits(values, genotype->chunk_ptr, genotype->chunk_end, offset,        \
+                             nvalues, nbits);                                                 \
+            offset += nvalues * nbits;                                                        \
+                                                                                              \
+            uint32_t const* v = values;                                                       \
+            for (uint32_t k = j; k < j + n; ++k) {                                            \
+                unsigned ploidy = read_ploidy(ploidy_miss[k]);                                \
+                if (read_missingness(ploidy_miss[k]) != 0)                                    \
+                    out[k] = MISSING;                                                         \
+                else                                                                          \
+                    out[k] = CONVERT(v, ploidy, phased, denom, threshold, cut);               \
+                v += ploidy;                                                                  \
+            }                                                                                 \
+            j += n;                                                                           \
+        }                                                                                     \
+    }
+
+MAKE_READ_BIALLELIC(dosage64, double, NAN, TO_DOSAGE64)
+MAKE_READ_BIALLELIC(dosage32, float, NAN, TO_DOSAGE32)
+MAKE_READ_BIALLELIC(dosage8, uint8_t, 255, TO_DOSAGE8)
+MAKE_READ_BIALLELIC(hardcalls, int8_t, -1, TO_HARDCALL)
+
+void bgen_layout2_read_dosage64(struct bgen_genotype* genotype, double* dosages)
+{
+    read_dosage64(genotype, dosages, 0);
+}
+
+void bgen_layout2_read_dosage32(struct bgen_genotype* genotype, float* dosages)
+{
+    read_dosage32(genotype, dosages, 0);
+}
+
+void bgen_layout2_read_dosage8(struct bgen_genotype* genotype, uint8_t* dosages)
+{
+    read_dosage8(genotype, dosages, 0);
+}
+
+void bgen_layout2_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                 double threshold)
+{
+    read_hardcalls(genotype, calls, threshold);
+}
+
+/* Read the compressed probabilities of a block of `length` bytes, along with the size they
+ * decompress to. */
+static char const* read_compressed(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                                   uint32_t length, size_t* compressed_length,
+                                   size_t* uncompressed_length)
+{
+    uint64_t offset = genotype->offset + sizeof(length);
+
+    if (length < 4) {
         bgen_error("wrong compressed (corrupted file?)");
-        goto err;
+        return NULL;
     }
 
-    compressed_length -= 4;
+    *compressed_length = length - 4;
 
-    size_t length = 0;
-    if (fread(&length, 4, 1, bgen_file_stream(bgen_file)) < 1) {
-        bgen_perror_eof(bgen_file_stream(bgen_file), "could not read length");
-        goto err;
+    uint32_t ulength = 0;
+    if (bgen_file_read_block(bgen_file, genotype, offset, &ulength, sizeof(ulength))) {
+        bgen_error("could not read length");
+        return NULL;
     }
+    *uncompressed_length = ulength;
 
-    compressed_chunk = malloc(compressed_length);
+    char const* compressed_chunk =
+        bgen_file_view_block(bgen_file, genotype, offset + sizeof(ulength), *compressed_length,
+                             &genotype->compressed);
     if (compressed_chunk == NULL) {
-        bgen_error("could not malloc compressed chunk");
-        goto err;
+        bgen_error("could not read chunk");
+        return NULL;
     }
 
-    if (fread(compressed_chunk, compressed_length, 1, bgen_file_stream(bgen_file)) < 1) {
-        bgen_perror_eof(bgen_file_stream(bgen_file), "could not read chunk");
-        goto err;
+    if (bgen_buffer_reserve(&genotype->chunk, *uncompressed_length) == NULL) {
+        bgen_error("could not malloc chunk");
+        return NULL;
     }
 
-    chunk = malloc(length);
-    if (chunk == NULL) {
-        bgen_error("could not malloc chunk");
-        goto err;
+    return compressed_chunk;
+}
+
+/* Decompress a chunk of `*uncompressed_length` bytes, as the block header declares. */
+static int inflate_chunk(struct bgen_genotype* genotype, unsigned compression,
+                         char const* compressed_chunk, size_t compressed_length,
+                         size_t* uncompressed_length)
+{
+    size_t const expected = *uncompressed_length;
+    if (compression == 1) {
+        if (bgen_unzlib(genotype->zlib, compressed_chunk, compressed_length,
+                        &genotype->chunk.data, uncompressed_length))
+            return 1;
+
+    } else if (compression == 2) {
+        if (bgen_unzstd(genotype->zstd, compressed_chunk, compressed_length,
+                        (void**)&genotype->chunk.data, uncompressed_length))
+            return 1;
+
+    } else {
+        bgen_error("unrecognized compression method");
+        return 1;
     }
 
-    if (bgen_file_compression(bgen_file) == 1) {
-        if (bgen_unzlib(compressed_chunk, compressed_length, &chunk, &length))
-            goto err;
+    if (*uncompressed_length != expected) {
+        bgen_error("unexpected uncompressed chunk size (corrupted file?)");
+        return 1;
+    }
 
-    } else if (bgen_file_compression(bgen_file) == 2) {
-        if (bgen_unzstd(compressed_chunk, compressed_length, (void**)&chunk, &length))
-            goto err;
+    return 0;
+}
+
+static int decompress(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                      uint32_t length, size_t* chunk_size)
+{
+    size_t      compressed_length = 0;
+    size_t      uncompressed_length = 0;
+    char const* compressed_chunk = read_compressed(bgen_file, genotype, length,
+                                                   &compressed_length, &uncompressed_length);
+    if (compressed_chunk == NULL)
+        return 1;
+
+    if (inflate_chunk(genotype, bgen_file_compression(bgen_file), compressed_chunk,
+                      compressed_length, &uncompressed_length))
+        return 1;
+
+    *chunk_size = uncompressed_length;
+    return 0;
+}
+
+/* Decompress no more than the header and the ploidy/missingness bytes, keeping the
+ * compressed probabilities for `bgen_layout2_inflate`. The chunk is reserved in full so that
+ * `ploidy_missingness` stays put once the rest gets decompressed. */
+static int decompress_head(struct bgen_file* bgen_file, struct bgen_genotype* genotype,
+                           uint32_t length, size_t* chunk_size)
+{
+    size_t      compressed_length = 0;
+    size_t      uncompressed_length = 0;
+    char const* compressed_chunk = read_compressed(bgen_file, genotype, length,
+                                                   &compressed_length, &uncompressed_length);
+    if (compressed_chunk == NULL)
+        return 1;
+
+    unsigned const compression = bgen_file_compression(bgen_file);
+    size_t const   head = 10 + (size_t)bgen_file_nsamples(bgen_file);
+
+    /* Nothing would be left to defer. */
+    if (uncompressed_length <= head) {
+        if (inflate_chunk(genotype, compression, compressed_chunk, compressed_length,
+                          &uncompressed_length))
+            return 1;
+        *chunk_size = uncompressed_length;
+        return 0;
+    }
 
+    size_t size = head;
+    if (compression == 1) {
+        if (bgen_unzlib_head(genotype->zlib, compressed_chunk, compressed_length,
+                             genotype->chunk.data, &size))
+            return 1;
+    } else if (compression == 2) {
+        if (bgen_unzstd_head(genotype->zstd, compressed_chunk, compressed_length,
+                             genotype->chunk.data, &size))
+            return 1;
     } else {
         bgen_error("unrecognized compression method");
-        goto err;
+        return 1;
     }
 
-    bgen_free(compressed_chunk);
+    if (size != head) {
+        bgen_error("unexpected uncompressed chunk size (corrupted file?)");
+        return 1;
+    }
+
+    genotype->deferred = true;
+    genotype->compression = compression;
+    genotype->packed = compressed_chunk;
+    genotype->packed_size = compressed_length;
+    genotype->unpacked_size = uncompressed_length;
+    *chunk_size = size;
+    return 0;
+}
 
-    return chunk;
+int bgen_layout2_inflate(struct bgen_genotype* genotype)
+{
+    size_t size = genotype->unpacked_size;
+    if (inflate_chunk(genotype, genotype->compression, genotype->packed, genotype->packed_size,
+                      &size))
+        return 1;
+
+    if (size < (size_t)genotype->nsamples + 10) {
+        bgen_error("chunk is too small (corrupted file?)");
+        return 1;
+    }
 
-err:
-    bgen_free(compressed_chunk);
-    bgen_free(chunk);
-    return NULL;
+    char const* chunk = genotype->chunk.data;
+    genotype->chunk_ptr = chunk + 10 + genotype->nsamples;
+    genotype->chunk_end = chunk + size;
+    genotype->deferred = false;
+    return 0;
 }
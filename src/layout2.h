@@ -1,11 +1,24 @@
 #ifndef BGEN_LAYOUT2_H
 #define BGEN_LAYOUT2_H
 
+#include <stdint.h>
+
 struct bgen_file;
 struct bgen_genotype;
 
 int  bgen_layout2_read_header(struct bgen_file* bgen_file, struct bgen_genotype* genotype);
+/* Decompress the probabilities left compressed by a lazy `bgen_layout2_read_header`. */
+int  bgen_layout2_inflate(struct bgen_genotype* genotype);
 void bgen_layout2_read_genotype64(struct bgen_genotype* genotype, double* probs);
 void bgen_layout2_read_genotype32(struct bgen_genotype* genotype, float* probs);
+int  bgen_layout2_read_subset64(struct bgen_genotype* genotype, uint32_t const* samples,
+                                uint32_t nselected, double* probs);
+int  bgen_layout2_read_subset32(struct bgen_genotype* genotype, uint32_t const* samples,
+                                uint32_t nselected, float* probs);
+void bgen_layout2_read_dosage64(struct bgen_genotype* genotype, double* dosages);
+void bgen_layout2_read_dosage32(struct bgen_genotype* genotype, float* dosages);
+void bgen_layout2_read_dosage8(struct bgen_genotype* genotype, uint8_t* dosages);
+void bgen_layout2_read_hardcalls(struct bgen_genotype* genotype, int8_t* calls,
+                                 double threshold);
 
 #endif
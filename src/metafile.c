@@ -2,7 +2,6 @@
 #include "bgen/file.h"
 #include "bgen/variant.h"
 #include "bmath.h"
-#include "bstring.h"
 #include "file.h"
 #include "free.h"
 #include "io.h"
@@ -10,49 +9,46 @@
 #include "metafile.h"
 #include "metafile_write.h"
 #include "partition.h"
+#include "pool.h"
 #include "report.h"
+#include "variant_table.h"
 #include <string.h>
 
-static struct bgen_metafile* metafile_alloc(char const* filepath);
-static uint32_t              compute_nvariants(uint32_t nvariants, uint32_t npartitions,
-                                               uint32_t partition);
+static struct bgen_metafile*        metafile_alloc(char const* filepath);
+static uint32_t                     compute_nvariants(uint32_t nvariants, uint32_t npartitions,
+                                                      uint32_t partition);
+static int                          load_columns(struct bgen_metafile* metafile);
+static struct bgen_partition const* read_partition_04(struct bgen_metafile const* metafile,
+                                                      uint32_t                    partition);
+static struct bgen_partition const* read_partition_05(struct bgen_metafile const* metafile,
+                                                      uint32_t                    partition);
 
 struct bgen_metafile* bgen_metafile_create(struct bgen_file* bgen_file, char const* filepath,
                                            uint32_t npartitions, int verbose)
+{
+    struct bgen_metafile_options const options = {0, false, verbose};
+    return bgen_metafile_create_with_options(bgen_file, filepath, npartitions, &options);
+}
+
+struct bgen_metafile* bgen_metafile_create_with_options(
+    struct bgen_file* bgen_file, char const* filepath, uint32_t npartitions,
+    struct bgen_metafile_options const* options)
 {
     struct bgen_metafile* metafile = metafile_alloc(filepath);
-    metafile->npartitions = npartitions;
-    metafile->nvariants = bgen_file_nvariants(bgen_file);
+    uint32_t const        nvariants = bgen_file_nvariants(bgen_file);
 
     if (!(metafile->stream = fopen(filepath, "w+b"))) {
         bgen_perror("could not create file %s", filepath);
         goto err;
     }
 
-    /* seek to metadata block */
-    int64_t block_seek = (int64_t)BGEN_METAFILE_HEADER_SIZE;
-    block_seek += (int64_t)(sizeof(uint64_t) * npartitions);
-    if (bgen_fseek(metafile->stream, block_seek, SEEK_SET))
-        goto err;
-
-    metafile->partition_offset = malloc(sizeof(uint64_t) * npartitions);
-
-    uint64_t metadata_block_size =
-        write_metafile_metadata_block(metafile->stream, metafile->partition_offset,
-                                      npartitions, metafile->nvariants, bgen_file, verbose);
-
-    if (metadata_block_size == 0)
-        goto err;
-
-    metafile->metadata_block_size = metadata_block_size;
-    rewind(metafile->stream);
-
-    if (write_metafile_header(metafile->stream, metafile->nvariants, npartitions,
-                              metafile->metadata_block_size))
-        goto err;
-
-    if (write_metafile_offsets_block(metafile->stream, npartitions,
-                                     metafile->partition_offset))
+    int error = 0;
+    if (options->nthreads == 0)
+        error = write_metafile(metafile->stream, nvariants, npartitions, bgen_file, options);
+    else
+        error = write_metafile_parallel(metafile->stream, nvariants, npartitions, bgen_file,
+                                        options);
+    if (error)
         goto err;
 
     if (fflush(metafile->stream)) {
@@ -60,6 +56,9 @@ struct bgen_metafile* bgen_metafile_create(struct bgen_file* bgen_file, char con
         goto err;
     }
 
+    if (load_columns(metafile))
+        goto err;
+
     return metafile;
 
 err:
@@ -83,12 +82,19 @@ struct bgen_metafile* bgen_metafile_open(char const* filepath)
         goto err;
     }
 
-    if (strncmp(header, BGEN_METAFILE_SIGNATURE, strlen(BGEN_METAFILE_SIGNATURE))) {
+    if (strncmp(header, BGEN_METAFILE_SIGNATURE, strlen(BGEN_METAFILE_SIGNATURE)) == 0) {
+        if (load_columns(metafile))
+            goto err;
+        return metafile;
+    }
+
+    if (strncmp(header, BGEN_METAFILE_SIGNATURE_04, strlen(BGEN_METAFILE_SIGNATURE_04))) {
         bgen_error("unrecognized bgen index version: %.*s",
                    (int)strlen(BGEN_METAFILE_SIGNATURE), header);
         goto err;
     }
 
+    metafile->version = 4;
     if (fread(&(metafile->nvariants), sizeof(uint32_t), 1, metafile->stream) < 1) {
         bgen_perror_eof(metafile->stream,
                         "could not read the number of variants from metafile");
@@ -132,22 +138,111 @@ uint32_t bgen_metafile_nvariants(struct bgen_metafile const* metafile)
     return metafile->nvariants;
 }
 
+unsigned bgen_metafile_version(struct bgen_metafile const* metafile)
+{
+    return metafile->version;
+}
+
 struct bgen_partition const* bgen_metafile_read_partition(struct bgen_metafile const* metafile,
                                                           uint32_t partition)
 {
-    FILE* stream = metafile->stream;
-    char* block = NULL;
-
     if (partition >= metafile->npartitions) {
         bgen_error("the provided partition number %" PRIu32 " is out-of-range", partition);
         return NULL;
     }
 
+    if (metafile->version == 4)
+        return read_partition_04(metafile, partition);
+    return read_partition_05(metafile, partition);
+}
+
+/* Point `str` to a string preceded by its length stored in `length_size` bytes. */
+static int string_view(char const** ptr, char const* end, size_t length_size,
+                       struct bgen_string* str)
+{
+    uint64_t length = 0;
+
+    if ((size_t)(end - *ptr) < length_size) {
+        bgen_error("variant string out of bounds (corrupted metafile?)");
+        return 1;
+    }
+    bgen_memfread(&length, ptr, length_size);
+
+    if ((uint64_t)(end - *ptr) < length) {
+        bgen_error("variant string out of bounds (corrupted metafile?)");
+        return 1;
+    }
+
+    str->length = (size_t)length;
+    str->data = *ptr;
+    *ptr += length;
+    return 0;
+}
+
+/* Read a version 04 record up to its allele ids, where `*ptr` is left. */
+static int read_record_04(char const** ptr, char const* end, uint64_t* genotype_offset,
+                          struct bgen_string* strings, uint32_t* position, uint16_t* nalleles)
+{
+    size_t const fixed_size = sizeof(*genotype_offset) + sizeof(*position) + sizeof(*nalleles);
+
+    if ((size_t)(end - *ptr) < sizeof(*genotype_offset)) {
+        bgen_error("variant out of bounds (corrupted metafile?)");
+        return 1;
+    }
+    bgen_memfread(genotype_offset, ptr, sizeof(*genotype_offset));
+
+    if (string_view(ptr, end, 2, strings) || string_view(ptr, end, 2, strings + 1) ||
+        string_view(ptr, end, 2, strings + 2))
+        return 1;
+
+    if ((size_t)(end - *ptr) < fixed_size - sizeof(*genotype_offset)) {
+        bgen_error("variant out of bounds (corrupted metafile?)");
+        return 1;
+    }
+    bgen_memfread(position, ptr, sizeof(*position));
+    bgen_memfread(nalleles, ptr, sizeof(*nalleles));
+    return 0;
+}
+
+/* Add the `nvariants` records of a version 04 block to `builder`. */
+static int read_records_04(struct bgen_partition_builder* builder, char const* block,
+                           uint64_t block_size, uint32_t nvariants)
+{
+    char const* ptr = block;
+    char const* end = block + block_size;
+
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        uint64_t           genotype_offset = 0;
+        struct bgen_string strings[3];
+        uint32_t           position = 0;
+        uint16_t           nalleles = 0;
+
+        if (read_record_04(&ptr, end, &genotype_offset, strings, &position, &nalleles) ||
+            bgen_partition_builder_add(builder, genotype_offset, strings, position, nalleles))
+            return 1;
+
+        for (uint16_t j = 0; j < nalleles; ++j) {
+            struct bgen_string allele;
+            if (string_view(&ptr, end, 4, &allele) ||
+                bgen_partition_builder_add_allele(builder, &allele))
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+static struct bgen_partition const* read_partition_04(struct bgen_metafile const* metafile,
+                                                      uint32_t                    partition)
+{
+    FILE*                          stream = metafile->stream;
+    char*                          block = NULL;
+    struct bgen_partition_builder* builder = NULL;
+    struct bgen_partition*         part = NULL;
+
     uint32_t const nvariants =
         compute_nvariants(metafile->nvariants, metafile->npartitions, partition);
 
-    struct bgen_partition* part = bgen_partition_create(nvariants);
-
     if (metafile->partition_offset[partition] > INT64_MAX) {
         bgen_error("`partition_offset` overflow");
         goto err;
@@ -165,42 +260,714 @@ struct bgen_partition const* bgen_metafile_read_partition(struct bgen_metafile c
     else
         block_size = poffset[partition + 1] - poffset[partition];
 
-    block = malloc(block_size);
-    if (fread(block, block_size, 1, stream) < 1) {
+    if (block_size > SIZE_MAX || (block = malloc(block_size > 0 ? block_size : 1)) == NULL) {
+        bgen_error("could not malloc partition block");
+        goto err;
+    }
+
+    if (block_size > 0 && fread(block, block_size, 1, stream) < 1) {
         bgen_perror_eof(stream, "could not read partition");
         goto err;
     }
 
-    char const* block_ptr = block;
+    if ((builder = bgen_partition_builder_create(nvariants)) == NULL ||
+        read_records_04(builder, block, block_size, nvariants) ||
+        (part = bgen_partition_builder_finish(builder)) == NULL)
+        goto err;
+
+    bgen_partition_builder_destroy(builder);
+    bgen_free(block);
+    return part;
+
+err:
+    bgen_partition_builder_destroy(builder);
+    bgen_free(block);
+    return NULL;
+}
+
+/* Bounds of the strings of a variant in the heap. */
+static int variant_strings(struct bgen_metafile const* metafile, uint32_t index,
+                           char const** begin, char const** end)
+{
+    uint64_t const start = metafile->string_offsets[index];
+    uint64_t const stop = metafile->string_offsets[index + 1];
+
+    if (start > stop || stop > metafile->heap_size) {
+        bgen_error("variant strings out of bounds (corrupted metafile?)");
+        return 1;
+    }
+
+    *begin = metafile->heap + start;
+    *end = metafile->heap + stop;
+    return 0;
+}
+
+static struct bgen_partition const* read_partition_05(struct bgen_metafile const* metafile,
+                                                      uint32_t                    partition)
+{
+    uint32_t const nvariants =
+        compute_nvariants(metafile->nvariants, metafile->npartitions, partition);
+    uint32_t const first =
+        bgen_metafile_partition_size(metafile->nvariants, metafile->npartitions) * partition;
+
+    struct bgen_partition_builder* builder = bgen_partition_builder_create(nvariants);
+    struct bgen_partition*         part = NULL;
+    if (builder == NULL)
+        return NULL;
+
     for (uint32_t i = 0; i < nvariants; ++i) {
-        struct bgen_variant* v = bgen_variant_create();
+        uint32_t const     index = first + i;
+        char const*        ptr = NULL;
+        char const*        end = NULL;
+        struct bgen_string strings[3];
 
-        bgen_memfread(&v->genotype_offset, &block_ptr, sizeof(v->genotype_offset));
-        v->id = bgen_string_memfread(&block_ptr, 2);
-        v->rsid = bgen_string_memfread(&block_ptr, 2);
-        v->chrom = bgen_string_memfread(&block_ptr, 2);
-        bgen_memfread(&v->position, &block_ptr, sizeof(v->position));
-        bgen_memfread(&v->nalleles, &block_ptr, sizeof(v->nalleles));
+        if (variant_strings(metafile, index, &ptr, &end))
+            goto err;
 
-        bgen_variant_create_alleles(v, v->nalleles);
+        if (string_view(&ptr, end, 2, strings) || string_view(&ptr, end, 2, strings + 1) ||
+            string_view(&ptr, end, 2, strings + 2))
+            goto err;
 
-        for (uint16_t j = 0; j < v->nalleles; ++j)
-            v->allele_ids[j] = bgen_string_memfread(&block_ptr, 4);
+        uint16_t const nalleles = metafile->nalleles[index];
+        if (bgen_partition_builder_add(builder, metafile->genotype_offsets[index], strings,
+                                       metafile->positions[index], nalleles))
+            goto err;
 
-        bgen_partition_set(part, i, v);
+        for (uint16_t j = 0; j < nalleles; ++j) {
+            struct bgen_string allele;
+            if (string_view(&ptr, end, 4, &allele) ||
+                bgen_partition_builder_add_allele(builder, &allele))
+                goto err;
+        }
     }
 
-    bgen_free(block);
+    part = bgen_partition_builder_finish(builder);
+    bgen_partition_builder_destroy(builder);
     return part;
 
 err:
-    bgen_partition_destroy(part);
-    bgen_free(block);
+    bgen_partition_builder_destroy(builder);
     return NULL;
 }
 
+#define CHECK_VARIANT(metafile, index, value)                                                 \
+    do {                                                                                      \
+        if ((metafile)->version < 5 || (index) >= (metafile)->nvariants)                      \
+            return value;                                                                     \
+    } while (0)
+
+uint64_t bgen_metafile_genotype_offset(struct bgen_metafile const* metafile, uint32_t index)
+{
+    CHECK_VARIANT(metafile, index, 0);
+    return metafile->genotype_offsets[index];
+}
+
+uint32_t bgen_metafile_position(struct bgen_metafile const* metafile, uint32_t index)
+{
+    CHECK_VARIANT(metafile, index, 0);
+    return metafile->positions[index];
+}
+
+uint16_t bgen_metafile_nalleles(struct bgen_metafile const* metafile, uint32_t index)
+{
+    CHECK_VARIANT(metafile, index, 0);
+    return metafile->nalleles[index];
+}
+
+/* Get the `field`-th string of a variant: id, rsid, chrom, and then its allele ids. */
+static struct bgen_string variant_string(struct bgen_metafile const* metafile, uint32_t index,
+                                         uint32_t field)
+{
+    struct bgen_string str = {0, NULL};
+    char const*        ptr = NULL;
+    char const*        end = NULL;
+
+    CHECK_VARIANT(metafile, index, str);
+    if (field >= 3 + (uint32_t)metafile->nalleles[index])
+        return str;
+
+    if (variant_strings(metafile, index, &ptr, &end))
+        return str;
+
+    for (uint32_t i = 0; i <= field; ++i) {
+        if (string_view(&ptr, end, i < 3 ? 2 : 4, &str))
+            return (struct bgen_string){0, NULL};
+    }
+
+    return str;
+}
+
+struct bgen_string bgen_metafile_id(struct bgen_metafile const* metafile, uint32_t index)
+{
+    return variant_string(metafile, index, 0);
+}
+
+struct bgen_string bgen_metafile_rsid(struct bgen_metafile const* metafile, uint32_t index)
+{
+    return variant_string(metafile, index, 1);
+}
+
+struct bgen_string bgen_metafile_chrom(struct bgen_metafile const* metafile, uint32_t index)
+{
+    return variant_string(metafile, index, 2);
+}
+
+struct bgen_string bgen_metafile_allele_id(struct bgen_metafile const* metafile,
+                                           uint32_t index, uint16_t allele)
+{
+    return variant_string(metafile, index, 3 + (uint32_t)allele);
+}
+
+int bgen_metafile_variant_stats(struct bgen_metafile const* metafile, uint32_t index,
+                                struct bgen_variant_stats* stats)
+{
+    if (metafile->block_sizes == NULL || index >= metafile->nvariants)
+        return 1;
+
+    stats->block_size = metafile->block_sizes[index];
+    stats->nbits = metafile->nbits[index];
+    stats->phased = metafile->phased[index] != 0;
+    stats->min_ploidy = metafile->min_ploidy[index];
+    stats->max_ploidy = metafile->max_ploidy[index];
+    stats->nmissing = metafile->nmissing[index];
+    stats->allele_frequency = metafile->allele_frequencies[index];
+    stats->info = metafile->info_scores[index];
+    return 0;
+}
+
+double const* bgen_metafile_allele_frequencies(struct bgen_metafile const* metafile)
+{
+    return metafile->allele_frequencies;
+}
+
+double const* bgen_metafile_info_scores(struct bgen_metafile const* metafile)
+{
+    return metafile->info_scores;
+}
+
+/* Entry of `chrom` in "CHRM", or `nchroms` if there is none. */
+static uint32_t find_chrom(struct bgen_metafile const* metafile, char const* chrom)
+{
+    size_t const length = strlen(chrom);
+
+    for (uint32_t i = 0; i < metafile->nchroms; ++i) {
+        uint64_t const offset = metafile->chroms[i].name;
+        uint16_t       name_length = 0;
+        if (offset > metafile->heap_size || metafile->heap_size - offset < sizeof(uint16_t))
+            continue;
+        memcpy(&name_length, metafile->heap + offset, sizeof(name_length));
+        if (name_length != length ||
+            metafile->heap_size - offset - sizeof(uint16_t) < name_length)
+            continue;
+        if (memcmp(metafile->heap + offset + sizeof(uint16_t), chrom, length) == 0)
+            return i;
+    }
+
+    return metafile->nchroms;
+}
+
+/* First of the `count` variants of `order` positioned after `position`, or at it if
+ * `inclusive`. */
+static int search_position(struct bgen_metafile const* metafile, uint32_t const* order,
+                           uint32_t count, uint32_t position, bool inclusive, uint32_t* found)
+{
+    uint32_t lo = 0;
+    uint32_t hi = count;
+
+    while (lo < hi) {
+        uint32_t const mid = lo + (hi - lo) / 2;
+        if (order[mid] >= metafile->nvariants) {
+            bgen_error("variant index out of range (corrupted metafile?)");
+            return 1;
+        }
+
+        uint32_t const p = metafile->positions[order[mid]];
+        if (p < position || (!inclusive && p == position))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *found = lo;
+    return 0;
+}
+
+int bgen_metafile_query_region(struct bgen_metafile const* metafile, char const* chrom,
+                               uint32_t start, uint32_t end, uint32_t const** indices,
+                               uint32_t* nvariants)
+{
+    *indices = NULL;
+    *nvariants = 0;
+
+    if (metafile->version < 5 || metafile->region_index == NULL) {
+        bgen_error("metafile %s has no region index", metafile->filepath);
+        return 1;
+    }
+
+    uint32_t const c = find_chrom(metafile, chrom);
+    if (c == metafile->nchroms || end < start)
+        return 0;
+
+    uint32_t const* order = metafile->region_index + metafile->chroms[c].first;
+    uint32_t const  count = metafile->chroms[c].count;
+    uint32_t        first = 0;
+    uint32_t        last = 0;
+    if (search_position(metafile, order, count, start, true, &first) ||
+        search_position(metafile, order, count, end, false, &last))
+        return 1;
+
+    *indices = order + first;
+    *nvariants = last - first;
+    return 0;
+}
+
+int bgen_metafile_partition_overlaps(struct bgen_metafile const* metafile, uint32_t partition,
+                                     char const* chrom, uint32_t start, uint32_t end)
+{
+    if (partition >= metafile->npartitions || end < start)
+        return 0;
+
+    if (metafile->version < 5 || metafile->region_index == NULL)
+        return 1;
+
+    uint32_t const c = find_chrom(metafile, chrom);
+    if (c == metafile->nchroms)
+        return 0;
+
+    /* Spans are ordered by partition. */
+    uint32_t lo = 0;
+    uint32_t hi = metafile->nspans;
+    while (lo < hi) {
+        uint32_t const mid = lo + (hi - lo) / 2;
+        if (metafile->spans[mid].partition < partition)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (uint32_t i = lo; i < metafile->nspans && metafile->spans[i].partition == partition;
+         ++i) {
+        struct bgen_metafile_span const* span = metafile->spans + i;
+        if (span->chrom == c && span->min_position <= end && span->max_position >= start)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Index of the first variant whose `field` (0 for the id, 1 for the rsid) is `name`, looked
+ * up in `bucket` of the name index. */
+static int find_name(struct bgen_metafile const* metafile, unsigned field, uint32_t bucket,
+                     char const* name, uint32_t* index)
+{
+    char const* data = metafile->name_indices[field];
+    uint32_t    nbuckets = 0;
+    uint32_t    range[2] = {0, 0};
+    memcpy(&nbuckets, data, sizeof(nbuckets));
+    memcpy(range, data + BGEN_METAFILE_NAME_HEADER_SIZE + bucket * sizeof(uint32_t),
+           sizeof(range));
+
+    if (range[0] > range[1] || range[1] > metafile->nvariants) {
+        bgen_error("invalid name index (corrupted metafile?)");
+        return 1;
+    }
+
+    size_t const   length = strlen(name);
+    uint32_t const hash = bgen_string_hash(name, length);
+    char const*    entries = data + bgen_metafile_name_entries_offset(nbuckets);
+
+    *index = BGEN_METAFILE_NOT_FOUND;
+    for (uint32_t i = range[0]; i < range[1]; ++i) {
+        struct bgen_metafile_name entry;
+        memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+        if (entry.hash != hash || entry.index >= metafile->nvariants)
+            continue;
+
+        struct bgen_string const str = variant_string(metafile, entry.index, field);
+        if (str.length == length && (length == 0 || memcmp(str.data, name, length) == 0)) {
+            *index = entry.index;
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+static int lookup_names(struct bgen_metafile const* metafile, unsigned field,
+                        char const* const* names, uint32_t nnames, uint32_t* indices)
+{
+    if (metafile->version < 5 || metafile->name_indices[field] == NULL) {
+        bgen_error("metafile %s has no name index", metafile->filepath);
+        return 1;
+    }
+
+    uint32_t nbuckets = 0;
+    memcpy(&nbuckets, metafile->name_indices[field], sizeof(nbuckets));
+
+    /* Names are looked up bucket after bucket, which goes through the index in order. */
+    uint64_t* keys = malloc(sizeof(uint64_t) * ((size_t)nnames + 1));
+    if (keys == NULL) {
+        bgen_error("could not malloc name lookup");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < nnames; ++i) {
+        uint32_t const hash = bgen_string_hash(names[i], strlen(names[i]));
+        keys[i] = (uint64_t)(hash & (nbuckets - 1)) << 32 | i;
+    }
+    qsort(keys, nnames, sizeof(uint64_t), compare_uint64);
+
+    for (uint32_t k = 0; k < nnames; ++k) {
+        uint32_t const i = (uint32_t)keys[k];
+        if (find_name(metafile, field, (uint32_t)(keys[k] >> 32), names[i], indices + i)) {
+            bgen_free(keys);
+            return 1;
+        }
+    }
+
+    bgen_free(keys);
+    return 0;
+}
+
+int bgen_metafile_lookup_ids(struct bgen_metafile const* metafile, char const* const* ids,
+                             uint32_t nids, uint32_t* indices)
+{
+    return lookup_names(metafile, 0, ids, nids, indices);
+}
+
+int bgen_metafile_lookup_rsids(struct bgen_metafile const* metafile, char const* const* rsids,
+                               uint32_t nrsids, uint32_t* indices)
+{
+    return lookup_names(metafile, 1, rsids, nrsids, indices);
+}
+
+/* Partition of the metafile being loaded into a variant table. */
+struct table_partition
+{
+    uint32_t            first; /* Index of its first variant. */
+    uint32_t            nvariants;
+    char const*         block; /* Its records (version 04 only). */
+    char const*         block_end;
+    struct bgen_string* chroms; /* Distinct chromosome names, in order of appearance. */
+    uint32_t*           codes;  /* Entry of `chrom_names` of each of `chroms`. */
+    uint32_t            nchroms;
+    uint32_t            capacity;
+    uint64_t            nstrings; /* Ids, rsids, and allele ids. */
+    uint64_t            length;   /* Of those strings, altogether. */
+    uint64_t            first_string;
+    uint64_t            heap_offset; /* Of its first string. */
+};
+
+struct table_loader
+{
+    struct bgen_metafile const*       metafile;
+    struct table_partition*           partitions;
+    struct bgen_variant_table_columns columns;
+};
+
+/* Variant being loaded, whose strings are views. Its allele ids lie from `ptr` to `end`. */
+struct table_record
+{
+    uint64_t           genotype_offset;
+    struct bgen_string strings[3]; /* id, rsid, and chrom */
+    uint32_t           position;
+    uint16_t           nalleles;
+    char const*        ptr;
+    char const*        end;
+};
+
+static bool same_string(struct bgen_string const* a, struct bgen_string const* b)
+{
+    return a->length == b->length &&
+           (a->length == 0 || memcmp(a->data, b->data, a->length) == 0);
+}
+
+/* Read variant `index`, which follows `*cursor` in the block of a version 04 partition. */
+static int read_table_record(struct bgen_metafile const*   metafile,
+                             struct table_partition const* part, char const** cursor,
+                             uint32_t index, struct table_record* record)
+{
+    if (metafile->version == 4) {
+        record->ptr = *cursor;
+        record->end = part->block_end;
+        return read_record_04(&record->ptr, record->end, &record->genotype_offset,
+                              record->strings, &record->position, &record->nalleles);
+    }
+
+    if (variant_strings(metafile, index, &record->ptr, &record->end) ||
+        string_view(&record->ptr, record->end, 2, record->strings) ||
+        string_view(&record->ptr, record->end, 2, record->strings + 1) ||
+        string_view(&record->ptr, record->end, 2, record->strings + 2))
+        return 1;
+
+    record->genotype_offset = metafile->genotype_offsets[index];
+    record->position = metafile->positions[index];
+    record->nalleles = metafile->nalleles[index];
+    return 0;
+}
+
+/* Entry of `part->chroms` named `name`, added if it is new. Variants of a chromosome are
+ * usually stored together, hence the guess. */
+static int table_chrom(struct table_partition* part, struct bgen_string const* name,
+                       uint32_t guess, uint32_t* chrom)
+{
+    if (guess < part->nchroms && same_string(part->chroms + guess, name)) {
+        *chrom = guess;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < part->nchroms; ++i) {
+        if (same_string(part->chroms + i, name)) {
+            *chrom = i;
+            return 0;
+        }
+    }
+
+    if (part->nchroms == part->capacity) {
+        uint32_t const      capacity = part->capacity == 0 ? 8 : part->capacity * 2;
+        struct bgen_string* chroms = realloc(part->chroms, sizeof(*chroms) * capacity);
+        if (chroms == NULL) {
+            bgen_error("could not malloc variant table");
+            return 1;
+        }
+        part->chroms = chroms;
+        part->capacity = capacity;
+    }
+
+    part->chroms[part->nchroms] = *name;
+    *chrom = part->nchroms++;
+    return 0;
+}
+
+/* Count the strings and the chromosomes of a partition. */
+static int count_partition(void* arg, unsigned worker, uint32_t index)
+{
+    struct table_loader const* loader = arg;
+    struct table_partition*    part = loader->partitions + index;
+    char const*                cursor = part->block;
+    uint32_t                   chrom = 0;
+
+    for (uint32_t i = 0; i < part->nvariants; ++i) {
+        struct table_record record;
+        if (read_table_record(loader->metafile, part, &cursor, part->first + i, &record) ||
+            table_chrom(part, record.strings + 2, chrom, &chrom))
+            return 1;
+
+        part->nstrings += 2 + (uint64_t)record.nalleles;
+        part->length += record.strings[0].length + record.strings[1].length;
+        for (uint16_t j = 0; j < record.nalleles; ++j) {
+            struct bgen_string allele;
+            if (string_view(&record.ptr, record.end, 4, &allele))
+                return 1;
+            part->length += allele.length;
+        }
+        cursor = record.ptr;
+    }
+
+    return 0;
+}
+
+/* Copy `str` to the heap at `*offset`, as string `*k`. Only the end of each string is
+ * written, so that partitions never write the same offset. */
+static void table_string(struct bgen_variant_table_columns const* columns, uint64_t* k,
+                         uint64_t* offset, struct bgen_string const* str)
+{
+    if (str->length > 0)
+        memcpy(columns->heap + *offset, str->data, str->length);
+    *offset += str->length;
+    columns->string_offsets[++*k] = *offset;
+}
+
+/* Fill in the columns of the variants of a partition. */
+static int fill_partition(void* arg, unsigned worker, uint32_t index)
+{
+    struct table_loader const*               loader = arg;
+    struct bgen_variant_table_columns const* columns = &loader->columns;
+    struct table_partition*                  part = loader->partitions + index;
+    char const*                              cursor = part->block;
+    uint32_t                                 chrom = 0;
+    uint64_t                                 k = part->first_string;
+    uint64_t                                 offset = part->heap_offset;
+
+    for (uint32_t i = 0; i < part->nvariants; ++i) {
+        uint32_t const      v = part->first + i;
+        struct table_record record;
+        if (read_table_record(loader->metafile, part, &cursor, v, &record) ||
+            table_chrom(part, record.strings + 2, chrom, &chrom))
+            return 1;
+
+        columns->genotype_offsets[v] = record.genotype_offset;
+        columns->positions[v] = record.position;
+        columns->nalleles[v] = record.nalleles;
+        columns->chroms[v] = part->codes[chrom];
+        columns->first_string[v] = k;
+        table_string(columns, &k, &offset, record.strings);
+        table_string(columns, &k, &offset, record.strings + 1);
+        for (uint16_t j = 0; j < record.nalleles; ++j) {
+            struct bgen_string allele;
+            if (string_view(&record.ptr, record.end, 4, &allele))
+                return 1;
+            table_string(columns, &k, &offset, &allele);
+        }
+        cursor = record.ptr;
+    }
+
+    return 0;
+}
+
+/* Read the metadata block of a version 04 metafile, and split it by partition. */
+static char* read_metadata_block_04(struct bgen_metafile const* metafile,
+                                    struct table_partition*     partitions)
+{
+    uint64_t const  size = metafile->metadata_block_size;
+    uint64_t const* poffset = metafile->partition_offset;
+    char*           block = NULL;
+
+    if (poffset[0] > INT64_MAX ||
+        bgen_fseek(metafile->stream, (int64_t)poffset[0], SEEK_SET)) {
+        bgen_perror("could not fseek metadata block");
+        return NULL;
+    }
+
+    if (size > SIZE_MAX || (block = malloc(size > 0 ? (size_t)size : 1)) == NULL) {
+        bgen_error("could not malloc metadata block");
+        return NULL;
+    }
+
+    if (size > 0 && fread(block, (size_t)size, 1, metafile->stream) < 1) {
+        bgen_perror_eof(metafile->stream, "could not read metadata block");
+        bgen_free(block);
+        return NULL;
+    }
+
+    for (uint32_t p = 0; p < metafile->npartitions; ++p) {
+        uint64_t const start = poffset[p] - poffset[0];
+        uint64_t const stop =
+            p + 1 < metafile->npartitions ? poffset[p + 1] - poffset[0] : size;
+        if (poffset[p] < poffset[0] || start > stop || stop > size) {
+            bgen_error("partition out of bounds (corrupted metafile?)");
+            bgen_free(block);
+            return NULL;
+        }
+        partitions[p].block = block + start;
+        partitions[p].block_end = block + stop;
+    }
+
+    return block;
+}
+
+/* Assign table-wide chromosome codes and string indices, then allocate the table. */
+static struct bgen_variant_table* merge_partitions(struct table_loader* loader)
+{
+    struct bgen_metafile const* metafile = loader->metafile;
+    struct table_partition*     partitions = loader->partitions;
+    uint64_t                    nstrings = 0;
+    uint64_t                    length = 0;
+    uint64_t                    nlocal = 0;
+
+    for (uint32_t p = 0; p < metafile->npartitions; ++p) {
+        partitions[p].first_string = nstrings;
+        partitions[p].heap_offset = length;
+        nstrings += partitions[p].nstrings;
+        length += partitions[p].length;
+        nlocal += partitions[p].nchroms;
+    }
+
+    struct bgen_string* names = malloc(sizeof(struct bgen_string) * ((size_t)nlocal + 1));
+    if (names == NULL) {
+        bgen_error("could not malloc variant table");
+        return NULL;
+    }
+
+    uint32_t nchroms = 0;
+    uint64_t chrom_length = 0;
+    for (uint32_t p = 0; p < metafile->npartitions; ++p) {
+        struct table_partition* part = partitions + p;
+        if ((part->codes = malloc(sizeof(uint32_t) * ((size_t)part->nchroms + 1))) == NULL) {
+            bgen_error("could not malloc variant table");
+            bgen_free(names);
+            return NULL;
+        }
+
+        for (uint32_t c = 0; c < part->nchroms; ++c) {
+            uint32_t code = nchroms > 0 && same_string(names + nchroms - 1, part->chroms + c)
+                                ? nchroms - 1
+                                : 0;
+            while (code < nchroms && !same_string(names + code, part->chroms + c))
+                ++code;
+            if (code == nchroms) {
+                names[nchroms++] = part->chroms[c];
+                chrom_length += part->chroms[c].length;
+            }
+            part->codes[c] = code;
+        }
+    }
+
+    struct bgen_variant_table* table = bgen_variant_table_alloc(
+        metafile->nvariants, nstrings, length, nchroms, chrom_length, &loader->columns);
+    if (table != NULL) {
+        char* chars = loader->columns.chrom_chars;
+        for (uint32_t c = 0; c < nchroms; ++c) {
+            if (names[c].length > 0)
+                memcpy(chars, names[c].data, names[c].length);
+            loader->columns.chrom_names[c] = (struct bgen_string){names[c].length, chars};
+            chars += names[c].length;
+        }
+        loader->columns.first_string[metafile->nvariants] = nstrings;
+        loader->columns.string_offsets[0] = 0;
+    }
+
+    bgen_free(names);
+    return table;
+}
+
+struct bgen_variant_table* bgen_metafile_load_table(struct bgen_metafile const* metafile,
+                                                    unsigned                    nthreads)
+{
+    uint32_t const             npartitions = metafile->npartitions;
+    struct bgen_variant_table* table = NULL;
+    char*                      block = NULL;
+    struct table_loader        loader = {metafile, NULL, {0}};
+
+    loader.partitions = calloc((size_t)npartitions + 1, sizeof(struct table_partition));
+    if (loader.partitions == NULL) {
+        bgen_error("could not malloc variant table");
+        return NULL;
+    }
+
+    for (uint32_t p = 0; p < npartitions; ++p) {
+        uint32_t const size = bgen_metafile_partition_size(metafile->nvariants, npartitions);
+        loader.partitions[p].first = size * p;
+        loader.partitions[p].nvariants =
+            compute_nvariants(metafile->nvariants, npartitions, p);
+    }
+
+    /* Partitions are first walked through to size the table, and then to fill it in. */
+    if ((metafile->version == 4 && npartitions > 0 &&
+         (block = read_metadata_block_04(metafile, loader.partitions)) == NULL) ||
+        bgen_pool_run(nthreads, npartitions, count_partition, &loader) ||
+        (table = merge_partitions(&loader)) == NULL ||
+        bgen_pool_run(nthreads, npartitions, fill_partition, &loader)) {
+        bgen_variant_table_destroy(table);
+        table = NULL;
+    }
+
+    for (uint32_t p = 0; p < npartitions; ++p) {
+        bgen_free(loader.partitions[p].chroms);
+        bgen_free(loader.partitions[p].codes);
+    }
+    bgen_free(loader.partitions);
+    bgen_free(block);
+    return table;
+}
+
 int bgen_metafile_close(struct bgen_metafile const* metafile)
 {
+    if (metafile->mapped && bgen_munmap(metafile->map, metafile->map_size))
+        bgen_perror("could not unmap %s", metafile->filepath);
+    if (!metafile->mapped)
+        bgen_free(metafile->map);
+
     bgen_free(metafile->filepath);
     bgen_free(metafile->partition_offset);
 
@@ -224,12 +991,287 @@ static struct bgen_metafile* metafile_alloc(char const* filepath)
     struct bgen_metafile* metafile = malloc(sizeof(struct bgen_metafile));
     metafile->filepath = strdup(filepath);
     metafile->stream = NULL;
+    metafile->version = 5;
+    metafile->nvariants = 0;
+    metafile->npartitions = 0;
+    metafile->metadata_block_size = 0;
     metafile->partition_offset = NULL;
+    metafile->map = NULL;
+    metafile->map_size = 0;
+    metafile->mapped = false;
+    metafile->genotype_offsets = NULL;
+    metafile->string_offsets = NULL;
+    metafile->positions = NULL;
+    metafile->nalleles = NULL;
+    metafile->heap = NULL;
+    metafile->heap_size = 0;
+    metafile->region_index = NULL;
+    metafile->chroms = NULL;
+    metafile->nchroms = 0;
+    metafile->spans = NULL;
+    metafile->nspans = 0;
+    metafile->name_indices[0] = NULL;
+    metafile->name_indices[1] = NULL;
+    metafile->block_sizes = NULL;
+    metafile->nbits = NULL;
+    metafile->phased = NULL;
+    metafile->min_ploidy = NULL;
+    metafile->max_ploidy = NULL;
+    metafile->nmissing = NULL;
+    metafile->allele_frequencies = NULL;
+    metafile->info_scores = NULL;
     return metafile;
 }
 
 static uint32_t compute_nvariants(uint32_t nvariants, uint32_t npartitions, uint32_t partition)
 {
     uint32_t size = bgen_metafile_partition_size(nvariants, npartitions);
+    if ((uint64_t)size * partition >= nvariants)
+        return 0;
     return min_uint32(size, nvariants - size * partition);
 }
+
+/* Read the whole file into memory, for where it cannot be mapped. */
+static char* read_whole(FILE* stream, uint64_t* size)
+{
+    if (bgen_fseek(stream, 0, SEEK_END))
+        return NULL;
+
+    int64_t end = bgen_ftell(stream);
+    if (end < 0 || bgen_fseek(stream, 0, SEEK_SET))
+        return NULL;
+
+    char* data = malloc(end > 0 ? (size_t)end : 1);
+    if (data == NULL)
+        return NULL;
+
+    if (end > 0 && fread(data, (size_t)end, 1, stream) != 1) {
+        bgen_free(data);
+        return NULL;
+    }
+
+    *size = (uint64_t)end;
+    return data;
+}
+
+/* Look a section up. `*data` is set to `NULL` if there is no such section. */
+static int lookup_section(struct bgen_metafile const* metafile, uint32_t nsections,
+                          uint32_t tag, char const** data, uint64_t* size)
+{
+    char const* directory = metafile->map + BGEN_METAFILE_HEADER_SIZE;
+
+    *data = NULL;
+    for (uint32_t i = 0; i < nsections; ++i) {
+        struct bgen_metafile_section section;
+        memcpy(&section, directory + i * sizeof(section), sizeof(section));
+        if (section.tag != tag)
+            continue;
+
+        if (section.offset > metafile->map_size ||
+            section.size > metafile->map_size - section.offset || section.offset % 8 != 0) {
+            bgen_error("metafile section out of bounds (corrupted metafile?)");
+            return 1;
+        }
+        *data = metafile->map + section.offset;
+        *size = section.size;
+        return 0;
+    }
+
+    return 0;
+}
+
+/* Find a section and check that it lies within the file. */
+static char const* find_section(struct bgen_metafile const* metafile, uint32_t nsections,
+                                uint32_t tag, uint64_t size, uint64_t* actual_size)
+{
+    char const* data = NULL;
+    uint64_t    found_size = 0;
+
+    if (lookup_section(metafile, nsections, tag, &data, &found_size))
+        return NULL;
+
+    if (data == NULL) {
+        bgen_error("missing metafile section (corrupted metafile?)");
+        return NULL;
+    }
+
+    if (actual_size != NULL) {
+        *actual_size = found_size;
+    } else if (found_size != size) {
+        bgen_error("unexpected metafile section size (corrupted metafile?)");
+        return NULL;
+    }
+    return data;
+}
+
+/* The region sections are either all there, or all missing. */
+static int load_region_sections(struct bgen_metafile* metafile, uint32_t nsections)
+{
+    char const* chroms = NULL;
+    char const* spans = NULL;
+    uint64_t    chroms_size = 0;
+    uint64_t    spans_size = 0;
+
+    if (lookup_section(metafile, nsections, BGEN_SECTION_CHROMOSOMES, &chroms, &chroms_size) ||
+        lookup_section(metafile, nsections, BGEN_SECTION_PARTITION_SPANS, &spans,
+                       &spans_size))
+        return 1;
+
+    if (chroms == NULL && spans == NULL)
+        return 0;
+
+    char const* index = find_section(metafile, nsections, BGEN_SECTION_REGION_INDEX,
+                                     metafile->nvariants * sizeof(uint32_t), NULL);
+    if (index == NULL || chroms == NULL || spans == NULL ||
+        chroms_size % sizeof(struct bgen_metafile_chrom) != 0 ||
+        spans_size % sizeof(struct bgen_metafile_span) != 0) {
+        bgen_error("invalid region sections (corrupted metafile?)");
+        return 1;
+    }
+
+    metafile->region_index = (uint32_t const*)index;
+    metafile->chroms = (struct bgen_metafile_chrom const*)chroms;
+    metafile->nchroms = (uint32_t)(chroms_size / sizeof(struct bgen_metafile_chrom));
+    metafile->spans = (struct bgen_metafile_span const*)spans;
+    metafile->nspans = (uint32_t)(spans_size / sizeof(struct bgen_metafile_span));
+
+    for (uint32_t i = 0; i < metafile->nchroms; ++i) {
+        struct bgen_metafile_chrom const* chrom = metafile->chroms + i;
+        if (chrom->first > metafile->nvariants ||
+            chrom->count > metafile->nvariants - chrom->first) {
+            bgen_error("invalid region sections (corrupted metafile?)");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int load_name_sections(struct bgen_metafile* metafile, uint32_t nsections)
+{
+    uint32_t const tags[2] = {BGEN_SECTION_ID_INDEX, BGEN_SECTION_RSID_INDEX};
+
+    for (unsigned i = 0; i < 2; ++i) {
+        char const* data = NULL;
+        uint64_t    size = 0;
+        if (lookup_section(metafile, nsections, tags[i], &data, &size))
+            return 1;
+        if (data == NULL)
+            continue;
+
+        uint32_t nbuckets = 0;
+        if (size >= sizeof(nbuckets))
+            memcpy(&nbuckets, data, sizeof(nbuckets));
+        if (size != bgen_metafile_name_index_size(metafile->nvariants) ||
+            nbuckets != bgen_metafile_name_buckets(metafile->nvariants)) {
+            bgen_error("invalid name index (corrupted metafile?)");
+            return 1;
+        }
+        metafile->name_indices[i] = data;
+    }
+
+    return 0;
+}
+
+/* The statistics sections are either all there, or all missing. */
+static int load_stats_sections(struct bgen_metafile* metafile, uint32_t nsections)
+{
+    char const* data = NULL;
+    uint64_t    size = 0;
+
+    if (lookup_section(metafile, nsections, BGEN_SECTION_BLOCK_SIZES, &data, &size))
+        return 1;
+    if (data == NULL)
+        return 0;
+
+    uint64_t const n = metafile->nvariants;
+    char const*    columns[8] = {
+        find_section(metafile, nsections, BGEN_SECTION_BLOCK_SIZES, n * sizeof(uint32_t),
+                     NULL),
+        find_section(metafile, nsections, BGEN_SECTION_NBITS, n * sizeof(uint8_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_PHASED, n * sizeof(uint8_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_MIN_PLOIDY, n * sizeof(uint8_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_MAX_PLOIDY, n * sizeof(uint8_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_NMISSING, n * sizeof(uint32_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_ALLELE_FREQUENCIES, n * sizeof(double),
+                     NULL),
+        find_section(metafile, nsections, BGEN_SECTION_INFO_SCORES, n * sizeof(double), NULL)};
+
+    for (unsigned i = 0; i < 8; ++i) {
+        if (columns[i] == NULL) {
+            bgen_error("invalid statistics sections (corrupted metafile?)");
+            return 1;
+        }
+    }
+
+    metafile->block_sizes = (uint32_t const*)columns[0];
+    metafile->nbits = (uint8_t const*)columns[1];
+    metafile->phased = (uint8_t const*)columns[2];
+    metafile->min_ploidy = (uint8_t const*)columns[3];
+    metafile->max_ploidy = (uint8_t const*)columns[4];
+    metafile->nmissing = (uint32_t const*)columns[5];
+    metafile->allele_frequencies = (double const*)columns[6];
+    metafile->info_scores = (double const*)columns[7];
+    return 0;
+}
+
+/* Map a version 05 metafile and point the columns into it. Nothing is parsed, so this takes
+ * the same time whatever the number of variants. */
+static int load_columns(struct bgen_metafile* metafile)
+{
+    metafile->version = 5;
+    metafile->map = bgen_mmap(metafile->stream, &metafile->map_size);
+    metafile->mapped = metafile->map != NULL;
+    if (!metafile->mapped) {
+        if ((metafile->map = read_whole(metafile->stream, &metafile->map_size)) == NULL) {
+            bgen_perror("could not read %s", metafile->filepath);
+            return 1;
+        }
+    }
+
+    if (metafile->map_size < BGEN_METAFILE_HEADER_SIZE) {
+        bgen_error("could not fetch the metafile header");
+        return 1;
+    }
+
+    uint32_t nsections = 0;
+    memcpy(&metafile->nvariants, metafile->map + 16, sizeof(uint32_t));
+    memcpy(&metafile->npartitions, metafile->map + 20, sizeof(uint32_t));
+    memcpy(&nsections, metafile->map + 24, sizeof(uint32_t));
+
+    uint64_t const directory_size = sizeof(struct bgen_metafile_section) * (uint64_t)nsections;
+    if (directory_size > metafile->map_size - BGEN_METAFILE_HEADER_SIZE) {
+        bgen_error("could not read the section directory");
+        return 1;
+    }
+
+    if (metafile->npartitions == 0) {
+        bgen_error("the number of partitions cannot be zero");
+        return 1;
+    }
+
+    uint64_t const n = metafile->nvariants;
+    char const*    columns[4] = {
+        find_section(metafile, nsections, BGEN_SECTION_GENOTYPE_OFFSETS, n * sizeof(uint64_t),
+                     NULL),
+        find_section(metafile, nsections, BGEN_SECTION_STRING_OFFSETS,
+                     (n + 1) * sizeof(uint64_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_POSITIONS, n * sizeof(uint32_t), NULL),
+        find_section(metafile, nsections, BGEN_SECTION_NALLELES, n * sizeof(uint16_t), NULL)};
+    metafile->heap =
+        find_section(metafile, nsections, BGEN_SECTION_HEAP, 0, &metafile->heap_size);
+
+    if (columns[0] == NULL || columns[1] == NULL || columns[2] == NULL || columns[3] == NULL ||
+        metafile->heap == NULL)
+        return 1;
+
+    metafile->genotype_offsets = (uint64_t const*)columns[0];
+    metafile->string_offsets = (uint64_t const*)columns[1];
+    metafile->positions = (uint32_t const*)columns[2];
+    metafile->nalleles = (uint16_t const*)columns[3];
+    if (load_region_sections(metafile, nsections))
+        return 1;
+    if (load_name_sections(metafile, nsections))
+        return 1;
+    return load_stats_sections(metafile, nsections);
+}
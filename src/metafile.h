@@ -1,9 +1,64 @@
 /** Create and query a metafile.
  * @file bgen/metafile.h
  *
- * A bgen metafile is defined as follows:
+ * A bgen metafile of version 05 stores variant metadata as columns, each in its own
+ * section, so that it can be memory-mapped and queried per variant:
  *
- * [ char[13] : signature (e.g. "bgen index 04") ], \
+ * [ char[13] : signature ("bgen index 05") ],     \
+ * [ char[3]  : zero padding ],                     |
+ * [ uint32_t : number of variants ],               | Header block
+ * [ uint32_t : number of partitions ],             |
+ * [ uint32_t : number of sections ],               |
+ * [ uint32_t : zero ],                             /
+ * [                                                \
+ *   uint32_t : section tag                         |
+ *   uint32_t : zero                                | Section directory
+ *   uint64_t : section offset (this file)          |
+ *   uint64_t : section size                        |
+ * ], ...                                           /
+ * [ section ], ...                                 - Sections, 8-byte aligned
+ *
+ * The sections are:
+ *
+ * - "GOFF", uint64_t[nvariants]     : genotype offset (bgen file)
+ * - "SOFF", uint64_t[nvariants + 1] : offset of the variant strings in "HEAP"
+ * - "POSN", uint32_t[nvariants]     : genetic position
+ * - "NALL", uint16_t[nvariants]     : number of alleles
+ * - "RIDX", uint32_t[nvariants]     : variant indices ordered by chromosome (as in
+ *                                     "CHRM"), then by position, then by index
+ * - "IDHX", name index              : hash index of the variant ids
+ * - "RSHX", name index              : hash index of the variant rsids
+ * - "HEAP", for each variant        : id, rsid, and chrom (uint16_t, str), followed by
+ *                                     allele ids (uint32_t, str)
+ * - "CHRM", bgen_metafile_chrom[]   : chromosomes, in order of first appearance
+ * - "PSUM", bgen_metafile_span[]    : range of positions of each chromosome found in each
+ *                                     partition, ordered by partition
+ * - "BSIZ", uint32_t[nvariants]     : genotype block size (bytes after its length field)
+ * - "NBIT", uint8_t[nvariants]      : bits per probability
+ * - "PHAS", uint8_t[nvariants]      : phased flag
+ * - "MINP", uint8_t[nvariants]      : minimum ploidy
+ * - "MAXP", uint8_t[nvariants]      : maximum ploidy
+ * - "NMIS", uint32_t[nvariants]     : number of samples with a missing genotype
+ * - "AFRQ", double[nvariants]       : frequency of the second allele (NaN if not biallelic)
+ * - "INFO", double[nvariants]       : info score (NaN if not biallelic)
+ *
+ * A name index is made of:
+ *
+ * [ uint32_t : number of buckets (a power of two) ],
+ * [ uint32_t : zero ],
+ * [ uint32_t[nbuckets + 1] : first entry of each bucket ],
+ * [ bgen_metafile_name[nvariants] : entries, ordered by bucket and then by variant index ]
+ *
+ * A name falls in bucket `bgen_string_hash(name) & (nbuckets - 1)`.
+ *
+ * Sections of unknown tags are skipped. Partitions are consecutive runs of variants of
+ * equal size (see `bgen_metafile_partition_size`), the last one possibly shorter. The
+ * region sections ("RIDX", "CHRM", and "PSUM") and the name indices are optional when
+ * reading. The statistics sections, from "BSIZ" to "INFO", are only written on request.
+ *
+ * Version 04, which can still be read, stores variable-length records instead:
+ *
+ * [ char[13] : signature ("bgen index 04") ],      \
  * [ uint32_t : number of variants ],               | Header block
  * [ uint32_t : number of partitions ],             |
  * [ uint64_t : metadata block size ],              /
@@ -23,26 +78,133 @@
  *     uint32_t, str : allele id                    |
  *   ], ...                                         |
  * ], ...                                           /
- *
- * Version 04.
  */
 #ifndef BGEN_METAFILE_H_PRIVATE
 #define BGEN_METAFILE_H_PRIVATE
 
+#include "bstring.h"
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
-#define BGEN_METAFILE_SIGNATURE "bgen index 04"
-#define BGEN_METAFILE_HEADER_SIZE (13 + 4 + 4 + 8)
+#define BGEN_METAFILE_SIGNATURE "bgen index 05"
+#define BGEN_METAFILE_SIGNATURE_04 "bgen index 04"
+#define BGEN_METAFILE_HEADER_SIZE 32
+#define BGEN_METAFILE_HEADER_SIZE_04 (13 + 4 + 4 + 8)
+
+#define BGEN_METAFILE_TAG(a, b, c, d)                                                         \
+    ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+#define BGEN_SECTION_GENOTYPE_OFFSETS BGEN_METAFILE_TAG('G', 'O', 'F', 'F')
+#define BGEN_SECTION_STRING_OFFSETS BGEN_METAFILE_TAG('S', 'O', 'F', 'F')
+#define BGEN_SECTION_POSITIONS BGEN_METAFILE_TAG('P', 'O', 'S', 'N')
+#define BGEN_SECTION_NALLELES BGEN_METAFILE_TAG('N', 'A', 'L', 'L')
+#define BGEN_SECTION_HEAP BGEN_METAFILE_TAG('H', 'E', 'A', 'P')
+#define BGEN_SECTION_REGION_INDEX BGEN_METAFILE_TAG('R', 'I', 'D', 'X')
+#define BGEN_SECTION_CHROMOSOMES BGEN_METAFILE_TAG('C', 'H', 'R', 'M')
+#define BGEN_SECTION_PARTITION_SPANS BGEN_METAFILE_TAG('P', 'S', 'U', 'M')
+#define BGEN_SECTION_ID_INDEX BGEN_METAFILE_TAG('I', 'D', 'H', 'X')
+#define BGEN_SECTION_RSID_INDEX BGEN_METAFILE_TAG('R', 'S', 'H', 'X')
+#define BGEN_SECTION_BLOCK_SIZES BGEN_METAFILE_TAG('B', 'S', 'I', 'Z')
+#define BGEN_SECTION_NBITS BGEN_METAFILE_TAG('N', 'B', 'I', 'T')
+#define BGEN_SECTION_PHASED BGEN_METAFILE_TAG('P', 'H', 'A', 'S')
+#define BGEN_SECTION_MIN_PLOIDY BGEN_METAFILE_TAG('M', 'I', 'N', 'P')
+#define BGEN_SECTION_MAX_PLOIDY BGEN_METAFILE_TAG('M', 'A', 'X', 'P')
+#define BGEN_SECTION_NMISSING BGEN_METAFILE_TAG('N', 'M', 'I', 'S')
+#define BGEN_SECTION_ALLELE_FREQUENCIES BGEN_METAFILE_TAG('A', 'F', 'R', 'Q')
+#define BGEN_SECTION_INFO_SCORES BGEN_METAFILE_TAG('I', 'N', 'F', 'O')
+#define BGEN_METAFILE_NAME_HEADER_SIZE 8
+
+/* Entry of the section directory, as stored in the file. */
+struct bgen_metafile_section
+{
+    uint32_t tag;
+    uint32_t zero;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* Entry of the "CHRM" section. */
+struct bgen_metafile_chrom
+{
+    uint64_t name;  /* Offset of the chromosome string (uint16_t, str) in "HEAP". */
+    uint32_t first; /* First of its variants in "RIDX". */
+    uint32_t count;
+};
+
+/* Entry of the "PSUM" section: positions of the variants of a partition lying on a
+ * chromosome. */
+struct bgen_metafile_span
+{
+    uint32_t partition;
+    uint32_t chrom; /* Entry of "CHRM". */
+    uint32_t min_position;
+    uint32_t max_position;
+};
+
+/* Entry of a name index. */
+struct bgen_metafile_name
+{
+    uint32_t hash;
+    uint32_t index;
+};
+
+/* Buckets of a name index: as many as variants, rounded up to a power of two. */
+static inline uint32_t bgen_metafile_name_buckets(uint32_t nvariants)
+{
+    uint32_t nbuckets = 1;
+    while (nbuckets < nvariants && nbuckets < (UINT32_C(1) << 31))
+        nbuckets *= 2;
+    return nbuckets;
+}
+
+static inline uint64_t bgen_metafile_name_entries_offset(uint32_t nbuckets)
+{
+    return BGEN_METAFILE_NAME_HEADER_SIZE + sizeof(uint32_t) * ((uint64_t)nbuckets + 1);
+}
+
+static inline uint64_t bgen_metafile_name_index_size(uint32_t nvariants)
+{
+    return bgen_metafile_name_entries_offset(bgen_metafile_name_buckets(nvariants)) +
+           sizeof(struct bgen_metafile_name) * (uint64_t)nvariants;
+}
 
 struct bgen_metafile
 {
     char*     filepath;
     FILE*     stream;
+    unsigned  version;
     uint32_t  nvariants;
     uint32_t  npartitions;
-    uint64_t  metadata_block_size;
-    uint64_t* partition_offset; /**< Array of partition offsets */
+    uint64_t  metadata_block_size; /**< Version 04 only. */
+    uint64_t* partition_offset;    /**< Array of partition offsets (version 04 only). */
+    /* Version 05: the whole file, mapped (or read if it cannot be mapped). */
+    char const*     map;
+    uint64_t        map_size;
+    bool            mapped;
+    uint64_t const* genotype_offsets;
+    uint64_t const* string_offsets;
+    uint32_t const* positions;
+    uint16_t const* nalleles;
+    char const*     heap;
+    uint64_t        heap_size;
+    /* Region sections, `NULL` if missing. */
+    uint32_t const*                   region_index;
+    struct bgen_metafile_chrom const* chroms;
+    uint32_t                          nchroms;
+    struct bgen_metafile_span const*  spans;
+    uint32_t                          nspans;
+    /* Name indices of the ids and of the rsids, `NULL` if missing. */
+    char const* name_indices[2];
+    /* Statistics sections, `NULL` if missing. */
+    uint32_t const* block_sizes;
+    uint8_t const*  nbits;
+    uint8_t const*  phased;
+    uint8_t const*  min_ploidy;
+    uint8_t const*  max_ploidy;
+    uint32_t const* nmissing;
+    double const*   allele_frequencies;
+    double const*   info_scores;
 };
 
 uint32_t bgen_metafile_partition_size(uint32_t nvariants, uint32_t npartitions);
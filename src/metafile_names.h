@@ -0,0 +1,99 @@
+#ifndef BGEN_METAFILE_NAMES_H
+#define BGEN_METAFILE_NAMES_H
+
+#include "free.h"
+#include "metafile.h"
+#include "report.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Hashes of the ids and rsids of every variant, gathered while the metafile is written, from
+ * which the hash index sections are built at the end. */
+struct name_builder
+{
+    uint32_t  nvariants;
+    uint32_t* hashes[2]; /* Of the ids, and of the rsids. */
+};
+
+static void name_builder_destroy(struct name_builder* builder)
+{
+    if (builder == NULL)
+        return;
+    bgen_free(builder->hashes[0]);
+    bgen_free(builder->hashes[1]);
+    bgen_free(builder);
+}
+
+static struct name_builder* name_builder_create(uint32_t nvariants)
+{
+    struct name_builder* builder = calloc(1, sizeof(struct name_builder));
+    if (builder == NULL)
+        goto err;
+
+    builder->nvariants = nvariants;
+    builder->hashes[0] = malloc(sizeof(uint32_t) * ((size_t)nvariants + 1));
+    builder->hashes[1] = malloc(sizeof(uint32_t) * ((size_t)nvariants + 1));
+    if (builder->hashes[0] == NULL || builder->hashes[1] == NULL)
+        goto err;
+
+    return builder;
+
+err:
+    bgen_error("could not malloc name index");
+    name_builder_destroy(builder);
+    return NULL;
+}
+
+/* Record variant `index`, whose strings (id, rsid, and chrom) start at `strings`. */
+static void name_builder_add(struct name_builder* builder, uint32_t index, char const* strings)
+{
+    for (unsigned i = 0; i < 2; ++i) {
+        uint16_t length = 0;
+        memcpy(&length, strings, sizeof(length));
+        builder->hashes[i][index] = bgen_string_hash(strings + sizeof(length), length);
+        strings += sizeof(length) + length;
+    }
+}
+
+/* Lay out the hash index of the ids (`field` 0) or of the rsids (`field` 1), as stored in
+ * its section of `bgen_metafile_name_index_size(nvariants)` bytes. */
+static char* build_name_index(struct name_builder const* builder, unsigned field)
+{
+    uint32_t const  n = builder->nvariants;
+    uint32_t const  nbuckets = bgen_metafile_name_buckets(n);
+    uint32_t const* hashes = builder->hashes[field];
+    char*           section = calloc(1, (size_t)bgen_metafile_name_index_size(n));
+    uint32_t*       first = malloc(sizeof(uint32_t) * ((size_t)nbuckets + 1));
+
+    if (section == NULL || first == NULL) {
+        bgen_error("could not malloc name index");
+        bgen_free(section);
+        bgen_free(first);
+        return NULL;
+    }
+
+    /* Counting sort of the variants by bucket, which keeps them by index within a bucket. */
+    for (uint32_t b = 0; b <= nbuckets; ++b)
+        first[b] = 0;
+    for (uint32_t i = 0; i < n; ++i)
+        first[(hashes[i] & (nbuckets - 1)) + 1]++;
+    for (uint32_t b = 0; b < nbuckets; ++b)
+        first[b + 1] += first[b];
+
+    memcpy(section, &nbuckets, sizeof(nbuckets));
+    memcpy(section + BGEN_METAFILE_NAME_HEADER_SIZE, first,
+           sizeof(uint32_t) * ((size_t)nbuckets + 1));
+
+    struct bgen_metafile_name* entries =
+        (struct bgen_metafile_name*)(section + bgen_metafile_name_entries_offset(nbuckets));
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t const b = hashes[i] & (nbuckets - 1);
+        entries[first[b]++] = (struct bgen_metafile_name){hashes[i], i};
+    }
+
+    bgen_free(first);
+    return section;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef BGEN_METAFILE_REGION_H
+#define BGEN_METAFILE_REGION_H
+
+#include "free.h"
+#include "metafile.h"
+#include "report.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Name of a chromosome seen so far. */
+struct region_name
+{
+    char*    data;
+    uint16_t length;
+};
+
+/* Chromosome and position of every variant, gathered while the metafile is written, from
+ * which the region sections are built at the end. */
+struct region_builder
+{
+    uint32_t                    nvariants;
+    uint32_t*                   chroms; /* Entry of `table` of each variant. */
+    uint32_t*                   positions;
+    struct region_name*         names;
+    struct bgen_metafile_chrom* table;
+    uint32_t                    nchroms;
+    uint32_t                    capacity;
+    uint32_t*                   order; /* The "RIDX" section, once built. */
+    struct bgen_metafile_span*  spans;
+    uint32_t                    nspans;
+};
+
+static void region_builder_destroy(struct region_builder* builder)
+{
+    if (builder == NULL)
+        return;
+    if (builder->names) {
+        for (uint32_t i = 0; i < builder->nchroms; ++i)
+            bgen_free(builder->names[i].data);
+    }
+    bgen_free(builder->chroms);
+    bgen_free(builder->positions);
+    bgen_free(builder->names);
+    bgen_free(builder->table);
+    bgen_free(builder->order);
+    bgen_free(builder->spans);
+    bgen_free(builder);
+}
+
+static struct region_builder* region_builder_create(uint32_t nvariants)
+{
+    struct region_builder* builder = calloc(1, sizeof(struct region_builder));
+    if (builder == NULL)
+        goto err;
+
+    builder->nvariants = nvariants;
+    builder->chroms = malloc(sizeof(uint32_t) * ((size_t)nvariants + 1));
+    builder->positions = malloc(sizeof(uint32_t) * ((size_t)nvariants + 1));
+    if (builder->chroms == NULL || builder->positions == NULL)
+        goto err;
+
+    return builder;
+
+err:
+    bgen_error("could not malloc region index");
+    region_builder_destroy(builder);
+    return NULL;
+}
+
+static bool same_name(struct region_name const* a, char const* name, uint16_t length)
+{
+    return a->length == length && (length == 0 || memcmp(a->data, name, length) == 0);
+}
+
+/* Entry of the chromosome named `name`, added if it is new. `offset` locates its string in
+ * the heap. Variants of a chromosome are usually stored together, hence the guess. */
+static int region_builder_chrom(struct region_builder* builder, char const* name,
+                                uint16_t length, uint64_t offset, uint32_t guess,
+                                uint32_t* chrom)
+{
+    if (guess < builder->nchroms && same_name(builder->names + guess, name, length)) {
+        *chrom = guess;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < builder->nchroms; ++i) {
+        if (same_name(builder->names + i, name, length)) {
+            *chrom = i;
+            return 0;
+        }
+    }
+
+    if (builder->nchroms == builder->capacity) {
+        uint32_t const capacity = builder->capacity == 0 ? 32 : builder->capacity * 2;
+        struct region_name* names = realloc(builder->names, sizeof(*names) * capacity);
+        if (names != NULL)
+            builder->names = names;
+        struct bgen_metafile_chrom* table = realloc(builder->table, sizeof(*table) * capacity);
+        if (table != NULL)
+            builder->table = table;
+        if (names == NULL || table == NULL)
+            goto err;
+        builder->capacity = capacity;
+    }
+
+    struct region_name* n = builder->names + builder->nchroms;
+    if ((n->data = malloc(length > 0 ? length : 1)) == NULL)
+        goto err;
+    if (length > 0)
+        memcpy(n->data, name, length);
+    n->length = length;
+
+    struct bgen_metafile_chrom* entry = builder->table + builder->nchroms;
+    entry->name = offset;
+    entry->first = 0;
+    entry->count = 0;
+
+    *chrom = builder->nchroms++;
+    return 0;
+
+err:
+    bgen_error("could not malloc region index");
+    return 1;
+}
+
+/* Record variant `index`, whose strings (id, rsid, and chrom) start at `strings` and at
+ * offset `offset` of the heap. */
+static int region_builder_add(struct region_builder* builder, uint32_t index,
+                              char const* strings, uint64_t offset, uint32_t position)
+{
+    uint16_t length = 0;
+    for (unsigned i = 0; i < 2; ++i) { /* id and rsid */
+        memcpy(&length, strings, sizeof(length));
+        strings += sizeof(length) + length;
+        offset += sizeof(length) + length;
+    }
+    memcpy(&length, strings, sizeof(length));
+
+    uint32_t const guess = index > 0 ? builder->chroms[index - 1] : 0;
+    if (region_builder_chrom(builder, strings + sizeof(length), length, offset, guess,
+                             builder->chroms + index))
+        return 1;
+
+    builder->table[builder->chroms[index]].count++;
+    builder->positions[index] = position;
+    return 0;
+}
+
+static int compare_uint64(void const* a, void const* b)
+{
+    uint64_t const x = *(uint64_t const*)a;
+    uint64_t const y = *(uint64_t const*)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort the variants of each chromosome by position, and then by index. */
+static int build_region_order(struct region_builder* builder)
+{
+    uint32_t const n = builder->nvariants;
+    uint64_t*      keys = malloc(sizeof(uint64_t) * ((size_t)n + 1));
+    builder->order = malloc(sizeof(uint32_t) * ((size_t)n + 1));
+    if (keys == NULL || builder->order == NULL) {
+        bgen_error("could not malloc region index");
+        bgen_free(keys);
+        return 1;
+    }
+
+    uint32_t first = 0;
+    for (uint32_t c = 0; c < builder->nchroms; ++c) {
+        builder->table[c].first = first;
+        first += builder->table[c].count;
+    }
+
+    /* Bucket the variants by chromosome, as (position, index) keys. */
+    uint32_t* next = builder->order;
+    for (uint32_t c = 0; c < builder->nchroms; ++c)
+        next[c] = builder->table[c].first;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t const c = builder->chroms[i];
+        keys[next[c]++] = (uint64_t)builder->positions[i] << 32 | i;
+    }
+
+    for (uint32_t c = 0; c < builder->nchroms; ++c) {
+        uint64_t* bucket = keys + builder->table[c].first;
+        uint32_t  count = builder->table[c].count;
+        uint32_t  i = 1;
+        while (i < count && bucket[i - 1] < bucket[i])
+            ++i;
+        if (i < count)
+            qsort(bucket, count, sizeof(uint64_t), compare_uint64);
+    }
+
+    for (uint32_t i = 0; i < n; ++i)
+        builder->order[i] = (uint32_t)keys[i];
+
+    bgen_free(keys);
+    return 0;
+}
+
+/* Summarise each partition by the range of positions of each chromosome it holds. */
+static int build_partition_spans(struct region_builder* builder, uint32_t npartitions)
+{
+    if (npartitions == 0) {
+        bgen_error("the number of partitions cannot be zero");
+        return 1;
+    }
+
+    uint32_t const n = builder->nvariants;
+    uint32_t const size = bgen_metafile_partition_size(n, npartitions);
+    uint32_t*      slots = malloc(sizeof(uint32_t) * ((size_t)builder->nchroms + 1));
+    uint32_t       capacity = builder->nchroms + npartitions;
+
+    builder->spans = malloc(sizeof(struct bgen_metafile_span) * ((size_t)capacity + 1));
+    if (slots == NULL || builder->spans == NULL)
+        goto err;
+
+    for (uint32_t c = 0; c < builder->nchroms; ++c)
+        slots[c] = UINT32_MAX;
+
+    uint32_t first_span = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t const partition = i / size;
+        if (i % size == 0)
+            first_span = builder->nspans;
+
+        uint32_t const c = builder->chroms[i];
+        uint32_t const position = builder->positions[i];
+        uint32_t const slot = slots[c];
+        if (slot != UINT32_MAX && slot >= first_span) {
+            struct bgen_metafile_span* span = builder->spans + slot;
+            span->min_position = position < span->min_position ? position : span->min_position;
+            span->max_position = position > span->max_position ? position : span->max_position;
+            continue;
+        }
+
+        if (builder->nspans == capacity) {
+            capacity *= 2;
+            struct bgen_metafile_span* spans =
+                realloc(builder->spans, sizeof(struct bgen_metafile_span) * capacity);
+            if (spans == NULL)
+                goto err;
+            builder->spans = spans;
+        }
+
+        slots[c] = builder->nspans;
+        builder->spans[builder->nspans++] =
+            (struct bgen_metafile_span){partition, c, position, position};
+    }
+
+    bgen_free(slots);
+    return 0;
+
+err:
+    bgen_error("could not malloc partition summary");
+    bgen_free(slots);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef BGEN_METAFILE_STATS_H
+#define BGEN_METAFILE_STATS_H
+
+#include "bgen/file.h"
+#include "bgen/genotype.h"
+#include "bgen/reader.h"
+#include "buffer.h"
+#include "file.h"
+#include "free.h"
+#include "genotype.h"
+#include "reader.h"
+#include "report.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* Variants whose statistics are computed at once, before being written out. */
+#define METAFILE_STATS_ROUND_SIZE 16384
+
+/* Statistics of consecutive variants. */
+struct stats_columns
+{
+    uint64_t* genotype_offsets;
+    uint32_t* block_sizes;
+    uint8_t*  nbits;
+    uint8_t*  phased;
+    uint8_t*  min_ploidy;
+    uint8_t*  max_ploidy;
+    uint32_t* nmissing;
+    double*   allele_frequencies;
+    double*   info_scores;
+};
+
+/* Decoding state owned by a single worker thread. */
+struct stats_worker
+{
+    struct bgen_reader*   reader;
+    struct bgen_genotype* genotype;
+    struct bgen_buffer    probabilities;
+};
+
+struct stats_round
+{
+    struct bgen_file*    bgen;
+    struct stats_columns columns;
+    struct stats_worker* workers;
+};
+
+static void stats_columns_destroy(struct stats_columns* columns)
+{
+    bgen_free(columns->genotype_offsets);
+    bgen_free(columns->block_sizes);
+    bgen_free(columns->nbits);
+    bgen_free(columns->phased);
+    bgen_free(columns->min_ploidy);
+    bgen_free(columns->max_ploidy);
+    bgen_free(columns->nmissing);
+    bgen_free(columns->allele_frequencies);
+    bgen_free(columns->info_scores);
+}
+
+static int stats_columns_init(struct stats_columns* columns, uint32_t capacity)
+{
+    columns->genotype_offsets = malloc(sizeof(uint64_t) * capacity);
+    columns->block_sizes = malloc(sizeof(uint32_t) * capacity);
+    columns->nbits = malloc(sizeof(uint8_t) * capacity);
+    columns->phased = malloc(sizeof(uint8_t) * capacity);
+    columns->min_ploidy = malloc(sizeof(uint8_t) * capacity);
+    columns->max_ploidy = malloc(sizeof(uint8_t) * capacity);
+    columns->nmissing = malloc(sizeof(uint32_t) * capacity);
+    columns->allele_frequencies = malloc(sizeof(double) * capacity);
+    columns->info_scores = malloc(sizeof(double) * capacity);
+
+    if (columns->genotype_offsets == NULL || columns->block_sizes == NULL ||
+        columns->nbits == NULL || columns->phased == NULL || columns->min_ploidy == NULL ||
+        columns->max_ploidy == NULL || columns->nmissing == NULL ||
+        columns->allele_frequencies == NULL || columns->info_scores == NULL) {
+        bgen_error("could not malloc variant statistics");
+        stats_columns_destroy(columns);
+        return 1;
+    }
+    return 0;
+}
+
+static void stats_workers_destroy(struct stats_worker* workers, unsigned nworkers)
+{
+    if (workers == NULL)
+        return;
+    for (unsigned w = 0; w < nworkers; ++w) {
+        bgen_buffer_release(&workers[w].probabilities);
+        if (workers[w].genotype != NULL)
+            bgen_genotype_close(workers[w].genotype);
+        if (workers[w].reader != NULL)
+            bgen_reader_destroy(workers[w].reader);
+    }
+    bgen_free(workers);
+}
+
+/* Allele frequency and info score of a biallelic variant, whose probabilities have been
+ * decoded into `probs`. The number of copies of the second allele of a sample of ploidy `z`
+ * has mean `e` and variance `v`; with `theta` the mean of `e / z` over every non-missing
+ * sample, weighted by `z`, the info score is `1 - sum(v) / (sum(z) * theta * (1 - theta))`,
+ * as IMPUTE defines it for diploid samples. Phased haplotypes are taken as independent. */
+static void biallelic_stats(struct bgen_genotype const* genotype, double const* probs,
+                            double* frequency, double* info)
+{
+    unsigned const ncombs = genotype->ncombs;
+    double         mean = 0.0;
+    double         variance = 0.0;
+    uint64_t       nalleles = 0;
+
+    for (uint32_t s = 0; s < genotype->nsamples; ++s) {
+        double const* p = probs + (size_t)s * ncombs;
+        unsigned      ploidy = bgen_genotype_ploidy(genotype, s);
+        if (bgen_genotype_missing(genotype, s))
+            continue;
+
+        double e = 0.0;
+        double v = 0.0;
+        if (genotype->phased) {
+            for (unsigned h = 0; h < ploidy; ++h) {
+                e += p[2 * h + 1];
+                v += p[2 * h + 1] * p[2 * h];
+            }
+        } else {
+            double f = 0.0;
+            for (unsigned j = 1; j <= ploidy; ++j) {
+                e += j * p[j];
+                f += (double)(j * j) * p[j];
+            }
+            v = f - e * e;
+        }
+
+        mean += e;
+        variance += v;
+        nalleles += ploidy;
+    }
+
+    if (nalleles == 0) {
+        *frequency = NAN;
+        *info = NAN;
+        return;
+    }
+
+    double const theta = mean / (double)nalleles;
+    *frequency = theta;
+    if (theta <= 0.0 || theta >= 1.0)
+        *info = 1.0;
+    else
+        *info = 1.0 - variance / ((double)nalleles * theta * (1.0 - theta));
+}
+
+static int compute_variant_stats(void* arg, unsigned worker, uint32_t index)
+{
+    struct stats_round*         round = arg;
+    struct stats_columns const* c = &round->columns;
+    struct stats_worker*        w = round->workers + worker;
+    struct bgen_genotype*       genotype = w->genotype;
+    uint64_t const              offset = c->genotype_offsets[index];
+
+    if (bgen_reader_load_genotype(w->reader, genotype, offset))
+        return 1;
+
+    /* Statistics leave out the length field of the block, if any. */
+    size_t block_size = genotype->block_size;
+    if (!(bgen_file_layout(round->bgen) == 1 && bgen_file_compression(round->bgen) == 0))
+        block_size -= sizeof(uint32_t);
+    c->block_sizes[index] = (uint32_t)block_size;
+
+    c->nbits[index] = genotype->nbits;
+    c->phased[index] = genotype->phased;
+    c->min_ploidy[index] = genotype->min_ploidy;
+    c->max_ploidy[index] = genotype->max_ploidy;
+
+    uint32_t nmissing = 0;
+    for (uint32_t s = 0; s < genotype->nsamples; ++s)
+        nmissing += bgen_genotype_missing(genotype, s);
+    c->nmissing[index] = nmissing;
+
+    c->allele_frequencies[index] = NAN;
+    c->info_scores[index] = NAN;
+    if (genotype->nalleles != 2)
+        return 0;
+
+    size_t const size = sizeof(double) * genotype->nsamples * genotype->ncombs;
+    double*      probs = (double*)bgen_buffer_reserve(&w->probabilities, size);
+    if (probs == NULL) {
+        bgen_error("could not malloc probabilities");
+        return 1;
+    }
+
+    if (bgen_genotype_read64(genotype, probs))
+        return 1;
+
+    biallelic_stats(genotype, probs, c->allele_frequencies + index, c->info_scores + index);
+    return 0;
+}
+
+#endif
@@ -3,98 +3,481 @@
 
 #include "athr/athr.h"
 #include "bgen/bstring.h"
+#include "bgen/metafile.h"
 #include "bgen/variant.h"
 #include "bmath.h"
-#include "bstring.h"
+#include "buffer.h"
+#include "file.h"
 #include "io.h"
 #include "metafile.h"
+#include "metafile_names.h"
+#include "metafile_region.h"
+#include "metafile_stats.h"
+#include "pool.h"
 #include "report.h"
 #include "variant.h"
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 
-/* Write variant genotype to file and return the block size. */
-static uint64_t write_variant(FILE* stream, const struct bgen_variant* variant)
+/* Variants are gathered into batches of this size before being written out. */
+#define METAFILE_BATCH_SIZE 16384
+
+/* Order of the sections in the file. */
+enum
+{
+    SECTION_GENOTYPE_OFFSETS,
+    SECTION_STRING_OFFSETS,
+    SECTION_POSITIONS,
+    SECTION_NALLELES,
+    SECTION_REGION_INDEX,
+    SECTION_ID_INDEX,
+    SECTION_RSID_INDEX,
+    SECTION_HEAP,
+    SECTION_CHROMOSOMES,
+    SECTION_PARTITION_SPANS,
+    /* Statistics, only written if asked for. */
+    SECTION_BLOCK_SIZES,
+    SECTION_NBITS,
+    SECTION_PHASED,
+    SECTION_MIN_PLOIDY,
+    SECTION_MAX_PLOIDY,
+    SECTION_NMISSING,
+    SECTION_ALLELE_FREQUENCIES,
+    SECTION_INFO_SCORES,
+    NSECTIONS
+};
+
+static unsigned metafile_nsections(struct bgen_metafile_options const* options)
+{
+    return options->stats ? NSECTIONS : SECTION_BLOCK_SIZES;
+}
+
+/* Columns of consecutive variants, ready to be written at their place in the sections. */
+struct column_batch
+{
+    uint32_t           first; /* Index of the first variant. */
+    uint32_t           size;
+    uint64_t*          genotype_offsets;
+    uint64_t*          string_offsets; /* Relative to the start of the batch heap. */
+    uint32_t*          positions;
+    uint16_t*          nalleles;
+    struct bgen_buffer heap;
+    size_t             heap_size;
+};
+
+/* Indices built from every variant written, alongside the columns. */
+struct index_builder
+{
+    struct region_builder* regions;
+    struct name_builder*   names;
+};
+
+static void index_builder_destroy(struct index_builder* builder)
+{
+    region_builder_destroy(builder->regions);
+    name_builder_destroy(builder->names);
+    builder->regions = NULL;
+    builder->names = NULL;
+}
+
+static int index_builder_init(struct index_builder* builder, uint32_t nvariants)
 {
-    int64_t start = bgen_ftell(stream);
+    builder->regions = region_builder_create(nvariants);
+    builder->names = name_builder_create(nvariants);
+    if (builder->regions == NULL || builder->names == NULL) {
+        index_builder_destroy(builder);
+        return 1;
+    }
+    return 0;
+}
+
+static uint64_t align8(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
 
-    if (fwrite(&variant->genotype_offset, sizeof(variant->genotype_offset), 1, stream) != 1) {
-        bgen_perror("could not write genotype offset");
-        return 0;
+/* Lay the `nsections` sections out one after the other. The size of the heap is only known
+ * once every variant has been written, which is why it comes after the fixed-size sections.
+ * Those following the heap are placed by `write_metafile_header`. */
+static void plan_sections(struct bgen_metafile_section* sections, uint32_t nvariants,
+                          unsigned nsections)
+{
+    uint32_t const tags[NSECTIONS] = {
+        BGEN_SECTION_GENOTYPE_OFFSETS, BGEN_SECTION_STRING_OFFSETS, BGEN_SECTION_POSITIONS,
+        BGEN_SECTION_NALLELES, BGEN_SECTION_REGION_INDEX, BGEN_SECTION_ID_INDEX,
+        BGEN_SECTION_RSID_INDEX, BGEN_SECTION_HEAP, BGEN_SECTION_CHROMOSOMES,
+        BGEN_SECTION_PARTITION_SPANS, BGEN_SECTION_BLOCK_SIZES, BGEN_SECTION_NBITS,
+        BGEN_SECTION_PHASED, BGEN_SECTION_MIN_PLOIDY, BGEN_SECTION_MAX_PLOIDY,
+        BGEN_SECTION_NMISSING, BGEN_SECTION_ALLELE_FREQUENCIES, BGEN_SECTION_INFO_SCORES};
+    uint64_t const sizes[NSECTIONS] = {sizeof(uint64_t) * (uint64_t)nvariants,
+                                       sizeof(uint64_t) * ((uint64_t)nvariants + 1),
+                                       sizeof(uint32_t) * (uint64_t)nvariants,
+                                       sizeof(uint16_t) * (uint64_t)nvariants,
+                                       sizeof(uint32_t) * (uint64_t)nvariants,
+                                       bgen_metafile_name_index_size(nvariants),
+                                       bgen_metafile_name_index_size(nvariants), 0, 0, 0,
+                                       0, 0, 0, 0, 0, 0, 0, 0};
+
+    uint64_t offset = BGEN_METAFILE_HEADER_SIZE;
+    offset += sizeof(struct bgen_metafile_section) * nsections;
+    for (unsigned i = 0; i < nsections; ++i) {
+        offset = align8(offset);
+        sections[i].tag = tags[i];
+        sections[i].zero = 0;
+        sections[i].offset = offset;
+        sections[i].size = sizes[i];
+        offset += sizes[i];
     }
+}
 
-    if (bgen_string_fwrite(variant->id, stream, 2)) {
-        bgen_perror("could not write variant id");
-        return 0;
+static struct column_batch* column_batch_create(uint32_t capacity)
+{
+    struct column_batch* batch = malloc(sizeof(struct column_batch));
+    if (batch == NULL)
+        return NULL;
+
+    batch->first = 0;
+    batch->size = 0;
+    batch->genotype_offsets = malloc(sizeof(uint64_t) * capacity);
+    batch->string_offsets = malloc(sizeof(uint64_t) * capacity);
+    batch->positions = malloc(sizeof(uint32_t) * capacity);
+    batch->nalleles = malloc(sizeof(uint16_t) * capacity);
+    bgen_buffer_init(&batch->heap);
+    batch->heap_size = 0;
+
+    if (batch->genotype_offsets == NULL || batch->string_offsets == NULL ||
+        batch->positions == NULL || batch->nalleles == NULL) {
+        bgen_free(batch->genotype_offsets);
+        bgen_free(batch->string_offsets);
+        bgen_free(batch->positions);
+        bgen_free(batch->nalleles);
+        bgen_free(batch);
+        return NULL;
     }
 
-    if (bgen_string_fwrite(variant->rsid, stream, 2)) {
-        bgen_perror("could not write variant rsid");
-        return 0;
+    return batch;
+}
+
+static void column_batch_destroy(struct column_batch* batch)
+{
+    if (batch == NULL)
+        return;
+    bgen_free(batch->genotype_offsets);
+    bgen_free(batch->string_offsets);
+    bgen_free(batch->positions);
+    bgen_free(batch->nalleles);
+    bgen_buffer_release(&batch->heap);
+    bgen_free(batch);
+}
+
+/* Make room for `size` more bytes at the end of the heap. */
+static char* heap_extend(struct column_batch* batch, size_t size)
+{
+    if (bgen_buffer_reserve(&batch->heap, batch->heap_size + size) == NULL) {
+        bgen_error("could not malloc string heap");
+        return NULL;
     }
 
-    if (bgen_string_fwrite(variant->chrom, stream, 2)) {
-        bgen_perror("could not write chromosome");
-        return 0;
+    char* dst = batch->heap.data + batch->heap_size;
+    batch->heap_size += size;
+    return dst;
+}
+
+/* Append a string, preceded by its length stored in `length_size` bytes. */
+static int heap_append(struct column_batch* batch, struct bgen_string const* str,
+                       size_t length_size)
+{
+    uint64_t const length = str->length;
+    char*          dst = heap_extend(batch, length_size + str->length);
+    if (dst == NULL)
+        return 1;
+
+    memcpy(dst, &length, length_size);
+    if (str->length > 0)
+        memcpy(dst + length_size, str->data, str->length);
+    return 0;
+}
+
+static int column_batch_add(struct column_batch* batch, struct bgen_variant const* variant)
+{
+    uint32_t const i = batch->size;
+
+    batch->genotype_offsets[i] = variant->genotype_offset;
+    batch->string_offsets[i] = batch->heap_size;
+    batch->positions[i] = variant->position;
+    batch->nalleles[i] = variant->nalleles;
+
+    if (heap_append(batch, variant->id, 2) || heap_append(batch, variant->rsid, 2) ||
+        heap_append(batch, variant->chrom, 2))
+        return 1;
+
+    for (uint16_t j = 0; j < variant->nalleles; ++j) {
+        if (heap_append(batch, variant->allele_ids[j], 4))
+            return 1;
     }
 
-    if (fwrite(&variant->position, sizeof(variant->position), 1, stream) != 1) {
-        bgen_perror("could not write variant position");
-        return 0;
+    batch->size++;
+    return 0;
+}
+
+static int write_at(FILE* stream, uint64_t offset, void const* data, size_t size)
+{
+    if (offset > INT64_MAX || bgen_fseek(stream, (int64_t)offset, SEEK_SET)) {
+        bgen_perror("could not fseek metafile");
+        return 1;
     }
 
-    if (fwrite(&variant->nalleles, sizeof(variant->nalleles), 1, stream) != 1) {
-        bgen_perror("could not write number of alleles");
-        return 0;
+    if (size > 0 && fwrite(data, size, 1, stream) != 1) {
+        bgen_perror("could not write metafile");
+        return 1;
     }
 
-    for (uint16_t j = 0; j < variant->nalleles; ++j) {
-        if (bgen_string_fwrite(variant->allele_ids[j], stream, 4)) {
-            return 0;
-        }
+    return 0;
+}
+
+static int read_at(FILE* stream, uint64_t offset, void* data, size_t size)
+{
+    if (offset > INT64_MAX || bgen_fseek(stream, (int64_t)offset, SEEK_SET)) {
+        bgen_perror("could not fseek metafile");
+        return 1;
     }
 
-    int64_t stop = bgen_ftell(stream);
-    if (start > stop)
-        bgen_die("start cannot be greater than stop");
+    if (size > 0 && fread(data, size, 1, stream) != 1) {
+        bgen_perror_eof(stream, "could not read metafile");
+        return 1;
+    }
 
-    return (uint64_t)(stop - start);
+    return 0;
 }
 
-static int write_metafile_header(FILE* stream, uint32_t nvariants, uint32_t npartitions,
-                                 uint64_t metadata_block_size)
+/* Write the columns of the batch at their place in each section, its strings going right
+ * after the `*heap_size` bytes already written to the heap. */
+static int write_column_batch(FILE* stream, struct bgen_metafile_section const* sections,
+                              struct column_batch* batch, uint64_t* heap_size,
+                              struct index_builder* indices)
 {
-    char const name[] = BGEN_METAFILE_SIGNATURE;
+    uint64_t const first = batch->first;
+    uint32_t const n = batch->size;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        char const* strings = batch->heap.data + batch->string_offsets[i];
+        batch->string_offsets[i] += *heap_size;
+        name_builder_add(indices->names, batch->first + i, strings);
+        if (region_builder_add(indices->regions, batch->first + i, strings,
+                               batch->string_offsets[i], batch->positions[i]))
+            return 1;
+    }
 
-    if (fwrite(name, strlen(name), 1, stream) != 1) {
-        bgen_perror("could not write signature");
+    struct bgen_metafile_section const* s = sections;
+    if (write_at(stream, s[SECTION_GENOTYPE_OFFSETS].offset + first * sizeof(uint64_t),
+                 batch->genotype_offsets, n * sizeof(uint64_t)) ||
+        write_at(stream, s[SECTION_STRING_OFFSETS].offset + first * sizeof(uint64_t),
+                 batch->string_offsets, n * sizeof(uint64_t)) ||
+        write_at(stream, s[SECTION_POSITIONS].offset + first * sizeof(uint32_t),
+                 batch->positions, n * sizeof(uint32_t)) ||
+        write_at(stream, s[SECTION_NALLELES].offset + first * sizeof(uint16_t),
+                 batch->nalleles, n * sizeof(uint16_t)) ||
+        write_at(stream, s[SECTION_HEAP].offset + *heap_size, batch->heap.data,
+                 batch->heap_size))
         return 1;
+
+    *heap_size += batch->heap_size;
+    batch->first += n;
+    batch->size = 0;
+    batch->heap_size = 0;
+    return 0;
+}
+
+/* Write the name indices once every variant has been seen. */
+static int write_name_sections(FILE* stream, struct bgen_metafile_section const* sections,
+                               struct name_builder const* names)
+{
+    unsigned const fields[2] = {SECTION_ID_INDEX, SECTION_RSID_INDEX};
+
+    for (unsigned i = 0; i < 2; ++i) {
+        struct bgen_metafile_section const* section = sections + fields[i];
+        char*                               data = build_name_index(names, i);
+        if (data == NULL)
+            return 1;
+
+        int const error = write_at(stream, section->offset, data, (size_t)section->size);
+        bgen_free(data);
+        if (error)
+            return 1;
     }
 
-    if (fwrite(&nvariants, sizeof(nvariants), 1, stream) != 1) {
-        bgen_perror("could not write the number of variants");
+    return 0;
+}
+
+/* Write the region sections once every variant has been seen. */
+static int write_region_sections(FILE* stream, uint32_t npartitions,
+                                 struct bgen_metafile_section* sections,
+                                 struct region_builder* regions)
+{
+    if (build_region_order(regions) || build_partition_spans(regions, npartitions))
         return 1;
+
+    struct bgen_metafile_section* heap = sections + SECTION_HEAP;
+    struct bgen_metafile_section* chroms = sections + SECTION_CHROMOSOMES;
+    struct bgen_metafile_section* spans = sections + SECTION_PARTITION_SPANS;
+
+    chroms->offset = align8(heap->offset + heap->size);
+    chroms->size = sizeof(struct bgen_metafile_chrom) * (uint64_t)regions->nchroms;
+    spans->offset = align8(chroms->offset + chroms->size);
+    spans->size = sizeof(struct bgen_metafile_span) * (uint64_t)regions->nspans;
+
+    /* Padding is written as well, as the file would otherwise end before a last empty
+     * section. */
+    char const zeros[8] = {0};
+    return write_at(stream, sections[SECTION_REGION_INDEX].offset, regions->order,
+                    sizeof(uint32_t) * (size_t)regions->nvariants) ||
+           write_at(stream, heap->offset + heap->size, zeros,
+                    (size_t)(chroms->offset - heap->offset - heap->size)) ||
+           write_at(stream, chroms->offset, regions->table, (size_t)chroms->size) ||
+           write_at(stream, chroms->offset + chroms->size, zeros,
+                    (size_t)(spans->offset - chroms->offset - chroms->size)) ||
+           write_at(stream, spans->offset, regions->spans, (size_t)spans->size);
+}
+
+/* Place the statistics sections after the region ones, and fill them in by decoding the
+ * variants, whose genotype offsets are read back from the metafile, round by round. */
+static int write_stats_sections(FILE* stream, uint32_t nvariants,
+                                struct bgen_metafile_section* sections, struct bgen_file* bgen,
+                                struct bgen_metafile_options const* options)
+{
+    unsigned const sizes[NSECTIONS - SECTION_BLOCK_SIZES] = {
+        sizeof(uint32_t), sizeof(uint8_t), sizeof(uint8_t),  sizeof(uint8_t),
+        sizeof(uint8_t),  sizeof(uint32_t), sizeof(double), sizeof(double)};
+    struct bgen_metafile_section const* spans = sections + SECTION_PARTITION_SPANS;
+    char const                          zeros[8] = {0};
+
+    uint64_t end = spans->offset + spans->size;
+    for (unsigned i = SECTION_BLOCK_SIZES; i < NSECTIONS; ++i) {
+        uint64_t const offset = align8(end);
+        if (write_at(stream, end, zeros, (size_t)(offset - end)))
+            return 1;
+        sections[i].offset = offset;
+        sections[i].size = sizes[i - SECTION_BLOCK_SIZES] * (uint64_t)nvariants;
+        end = offset + sections[i].size;
     }
 
-    if (fwrite(&npartitions, sizeof(npartitions), 1, stream) != 1) {
-        bgen_perror("could not write the number of partitions");
+    struct athr*                at = NULL;
+    unsigned const              nthreads = options->nthreads == 0 ? 1 : options->nthreads;
+    struct stats_round          round = {bgen, {NULL}, NULL};
+    struct stats_columns const* c = &round.columns;
+
+    if (stats_columns_init(&round.columns, METAFILE_STATS_ROUND_SIZE))
         return 1;
+
+    if ((round.workers = calloc(nthreads, sizeof(struct stats_worker))) == NULL) {
+        bgen_error("could not allocate workers");
+        goto err;
+    }
+
+    for (unsigned w = 0; w < nthreads; ++w) {
+        /* One reader per worker: decompression contexts are not shared across threads. */
+        bgen_buffer_init(&round.workers[w].probabilities);
+        if ((round.workers[w].genotype = bgen_genotype_create()) == NULL) {
+            bgen_error("could not malloc genotype");
+            goto err;
+        }
+        if ((round.workers[w].reader = bgen_reader_create(bgen)) == NULL)
+            goto err;
+    }
+
+    if (options->verbose) {
+        at = athr_create((long)nvariants, "Computing statistics", ATHR_BAR | ATHR_ETA);
+        if (at == NULL) {
+            bgen_error("could not create a progress bar");
+            goto err;
+        }
     }
 
-    if (fwrite(&metadata_block_size, sizeof(metadata_block_size), 1, stream) != 1) {
-        bgen_perror("could not write metadata block size");
+    for (uint32_t first = 0; first < nvariants;) {
+        uint32_t const n = min_uint32(METAFILE_STATS_ROUND_SIZE, nvariants - first);
+        uint64_t const offsets = sections[SECTION_GENOTYPE_OFFSETS].offset;
+        void const*    columns[NSECTIONS - SECTION_BLOCK_SIZES] = {
+            c->block_sizes, c->nbits,    c->phased,             c->min_ploidy,
+            c->max_ploidy,  c->nmissing, c->allele_frequencies, c->info_scores};
+
+        if (read_at(stream, offsets + first * sizeof(uint64_t), c->genotype_offsets,
+                    n * sizeof(uint64_t)) ||
+            bgen_pool_run(nthreads, n, compute_variant_stats, &round))
+            goto err;
+
+        for (unsigned i = SECTION_BLOCK_SIZES; i < NSECTIONS; ++i) {
+            size_t const size = sizes[i - SECTION_BLOCK_SIZES];
+            if (write_at(stream, sections[i].offset + first * size,
+                         columns[i - SECTION_BLOCK_SIZES], n * size))
+                goto err;
+        }
+
+        first += n;
+        if (at)
+            athr_consume(at, n);
+    }
+
+    if (at)
+        athr_finish(at);
+    stats_workers_destroy(round.workers, nthreads);
+    stats_columns_destroy(&round.columns);
+    return 0;
+
+err:
+    if (at)
+        athr_finish(at);
+    stats_workers_destroy(round.workers, nthreads);
+    stats_columns_destroy(&round.columns);
+    return 1;
+}
+
+/* Write the header block, the section directory, the final string offset, and the index
+ * and statistics sections. */
+static int write_metafile_header(FILE* stream, uint32_t nvariants, uint32_t npartitions,
+                                 struct bgen_metafile_section* sections, uint64_t heap_size,
+                                 struct index_builder* indices, struct bgen_file* bgen,
+                                 struct bgen_metafile_options const* options)
+{
+    sections[SECTION_HEAP].size = heap_size;
+
+    uint64_t const offset = sections[SECTION_STRING_OFFSETS].offset;
+    if (write_at(stream, offset + nvariants * sizeof(uint64_t), &heap_size, sizeof(heap_size)))
+        return 1;
+
+    if (write_name_sections(stream, sections, indices->names) ||
+        write_region_sections(stream, npartitions, sections, indices->regions))
+        return 1;
+
+    if (options->stats && write_stats_sections(stream, nvariants, sections, bgen, options))
+        return 1;
+
+    char           header[BGEN_METAFILE_HEADER_SIZE] = {0};
+    uint32_t const nsections = metafile_nsections(options);
+    memcpy(header, BGEN_METAFILE_SIGNATURE, strlen(BGEN_METAFILE_SIGNATURE));
+    memcpy(header + 16, &nvariants, sizeof(nvariants));
+    memcpy(header + 20, &npartitions, sizeof(npartitions));
+    memcpy(header + 24, &nsections, sizeof(nsections));
+
+    if (write_at(stream, 0, header, sizeof(header)))
+        return 1;
+
+    if (fwrite(sections, sizeof(struct bgen_metafile_section), nsections, stream) !=
+        nsections) {
+        bgen_perror("could not write section directory");
         return 1;
     }
 
     return 0;
 }
 
-static uint64_t write_metafile_metadata_block(FILE* stream, uint64_t* poffset,
-                                              uint32_t npartitions, uint32_t nvariants,
-                                              struct bgen_file* bgen, int verbose)
+static int write_metafile(FILE* stream, uint32_t nvariants, uint32_t npartitions,
+                          struct bgen_file* bgen, struct bgen_metafile_options const* options)
 {
-    struct athr* at = NULL;
-    if (verbose) {
+    struct athr*                 at = NULL;
+    struct column_batch*         batch = NULL;
+    struct index_builder         indices = {NULL, NULL};
+    struct bgen_metafile_section sections[NSECTIONS];
+    uint64_t                     heap_size = 0;
+
+    if (options->verbose) {
         at = athr_create((long)nvariants, "Writing variants", ATHR_BAR | ATHR_ETA);
         if (at == NULL) {
             bgen_error("could not create a progress bar");
@@ -102,60 +485,386 @@ static uint64_t write_metafile_metadata_block(FILE* stream, uint64_t* poffset,
         }
     }
 
-    uint64_t i = 0, j = 0;
-    int      error = 0;
-
-    int64_t ftold = bgen_ftell(stream);
-    if (ftold < 0) {
-        bgen_perror("could not ftell");
+    if ((batch = column_batch_create(METAFILE_BATCH_SIZE)) == NULL) {
+        bgen_error("could not malloc metafile columns");
         goto err;
     }
-    uint64_t curr_offset = (uint64_t)ftold;
 
-    uint32_t part_size = bgen_metafile_partition_size(nvariants, npartitions);
+    if (index_builder_init(&indices, nvariants))
+        goto err;
+
+    plan_sections(sections, nvariants, metafile_nsections(options));
+
+    uint32_t i = 0;
+    int      error = 0;
     for (struct bgen_variant* variant = bgen_variant_begin(bgen, &error);
          variant != bgen_variant_end(bgen); variant = bgen_variant_next(bgen, &error)) {
 
-        if (error) {
+        if (error || i == nvariants) {
             bgen_error("could not write every variant");
+            bgen_variant_destroy(variant);
             goto err;
         }
 
-        uint64_t size = write_variant(stream, variant);
+        error = column_batch_add(batch, variant);
+        bgen_variant_destroy(variant);
+        if (error)
+            goto err;
 
-        if (size == 0)
+        if (batch->size == METAFILE_BATCH_SIZE &&
+            write_column_batch(stream, sections, batch, &heap_size, &indices))
             goto err;
 
         if (at)
             athr_consume(at, 1);
-
-        /* true for the first variant of every partition */
-        if (i % part_size == 0) {
-            poffset[j] = curr_offset;
-            ++j;
-        }
-
-        curr_offset += size;
         ++i;
-        bgen_variant_destroy(variant);
     }
 
-    if (verbose)
+    if (error || i != nvariants) {
+        bgen_error("could not write every variant");
+        goto err;
+    }
+
+    if (write_column_batch(stream, sections, batch, &heap_size, &indices))
+        goto err;
+
+    if (at) {
         athr_finish(at);
+        at = NULL;
+    }
+
+    if (write_metafile_header(stream, nvariants, npartitions, sections, heap_size, &indices,
+                              bgen, options))
+        goto err;
+
+    index_builder_destroy(&indices);
+    column_batch_destroy(batch);
+    return 0;
 
-    return (curr_offset - (uint64_t)ftold);
 err:
+    if (at)
+        athr_finish(at);
+    index_builder_destroy(&indices);
+    column_batch_destroy(batch);
+    return 1;
+}
+
+/* Variants parsed at once by `write_metafile_parallel`, per thread. */
+#define METAFILE_ROUND_BATCHES 2
+/* Bytes read at a time while looking for variant boundaries. */
+#define SCAN_WINDOW_SIZE 65536
+
+/* Metadata of a variant lies in `[start, genotype_offset)` of the bgen file. */
+struct variant_span
+{
+    uint64_t start;
+    uint64_t genotype_offset;
+};
+
+/* Walk from variant to variant by following their length fields only. */
+struct variant_scanner
+{
+    struct bgen_file*  bgen;
+    uint64_t           file_size;
+    uint64_t           next; /* Start of the next variant. */
+    struct bgen_buffer window;
+    uint64_t           window_start;
+    size_t             window_size;
+};
+
+/* Bytes `[offset, offset + size)` of the file, read through the window. */
+static char const* scanner_view(struct variant_scanner* scanner, uint64_t offset, size_t size)
+{
+    if (offset >= scanner->window_start &&
+        offset - scanner->window_start <= scanner->window_size &&
+        size <= scanner->window_size - (offset - scanner->window_start))
+        return scanner->window.data + (offset - scanner->window_start);
+
+    if (offset > scanner->file_size || size > scanner->file_size - offset) {
+        bgen_error("could not read variant (unexpected end of file)");
+        return NULL;
+    }
+
+    uint64_t const left = scanner->file_size - offset;
+    size_t         length = size > SCAN_WINDOW_SIZE ? size : SCAN_WINDOW_SIZE;
+    if (length > left)
+        length = (size_t)left;
+
+    if (bgen_buffer_reserve(&scanner->window, length) == NULL) {
+        bgen_error("could not malloc scan window");
+        return NULL;
+    }
+
+    scanner->window_start = offset;
+    scanner->window_size = 0;
+    if (bgen_file_read_at(scanner->bgen, offset, scanner->window.data, length))
+        return NULL;
+    scanner->window_size = length;
+
+    return scanner->window.data;
+}
+
+static int scanner_length(struct variant_scanner* scanner, uint64_t offset, size_t size,
+                          uint64_t* length)
+{
+    char const* src = scanner_view(scanner, offset, size);
+    if (src == NULL)
+        return 1;
+
+    *length = 0;
+    memcpy(length, src, size);
     return 0;
 }
 
-static int write_metafile_offsets_block(FILE* stream, uint32_t npartitions, uint64_t* poffset)
+/* Find the metadata of the next variant and skip its genotype block. */
+static int scan_variant(struct variant_scanner* scanner, struct variant_span* span)
 {
-    if (fwrite(poffset, sizeof(uint64_t) * npartitions, 1, stream) != 1) {
-        bgen_perror("could not write offsets block");
+    uint64_t offset = scanner->next;
+    uint64_t length = 0;
+
+    span->start = offset;
+    for (unsigned i = 0; i < 3; ++i) { /* id, rsid, and chrom */
+        if (scanner_length(scanner, offset, 2, &length))
+            return 1;
+        offset += 2 + length;
+    }
+
+    uint64_t nalleles = 0;
+    offset += sizeof(uint32_t); /* position */
+    if (scanner_length(scanner, offset, 2, &nalleles))
         return 1;
+    offset += 2;
+
+    for (uint64_t i = 0; i < nalleles; ++i) {
+        if (scanner_length(scanner, offset, 4, &length))
+            return 1;
+        offset += 4 + length;
+    }
+
+    span->genotype_offset = offset;
+    if (scanner_length(scanner, offset, 4, &length))
+        return 1;
+    scanner->next = offset + 4 + length;
+
+    return 0;
+}
+
+/* Add a variant from its raw metadata: the strings are copied to the heap as they are
+ * stored in the bgen file, which is the way `column_batch_add` lays them out. */
+static int column_batch_add_raw(struct column_batch* batch, uint64_t genotype_offset,
+                                char const* data, size_t size)
+{
+    uint32_t const i = batch->size;
+    size_t         offset = 0;
+
+    for (unsigned j = 0; j < 3; ++j) { /* id, rsid, and chrom */
+        uint16_t length = 0;
+        if (size - offset < sizeof(length))
+            goto corrupted;
+        memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        if (size - offset < length)
+            goto corrupted;
+        offset += length;
     }
 
+    size_t const strings_size = offset;
+    uint32_t     position = 0;
+    uint16_t     nalleles = 0;
+    if (size - offset < sizeof(position) + sizeof(nalleles))
+        goto corrupted;
+    memcpy(&position, data + offset, sizeof(position));
+    memcpy(&nalleles, data + offset + sizeof(position), sizeof(nalleles));
+    offset += sizeof(position) + sizeof(nalleles);
+
+    batch->genotype_offsets[i] = genotype_offset;
+    batch->string_offsets[i] = batch->heap_size;
+    batch->positions[i] = position;
+    batch->nalleles[i] = nalleles;
+
+    char* dst = heap_extend(batch, strings_size + (size - offset));
+    if (dst == NULL)
+        return 1;
+    memcpy(dst, data, strings_size);
+    memcpy(dst + strings_size, data + offset, size - offset);
+
+    batch->size++;
     return 0;
+
+corrupted:
+    bgen_error("could not parse variant at offset %" PRIu64, genotype_offset);
+    return 1;
+}
+
+/* Batches of a round, parsed concurrently. */
+struct parse_round
+{
+    struct bgen_file*          bgen;
+    struct variant_span const* spans;
+    uint32_t                   nspans;
+    struct column_batch**      batches;
+    struct bgen_buffer*        buffers; /* One per worker. */
+};
+
+static int parse_batch(void* arg, unsigned worker, uint32_t index)
+{
+    struct parse_round*  round = arg;
+    struct column_batch* batch = round->batches[index];
+    struct bgen_buffer*  buffer = round->buffers + worker;
+    uint32_t const       first = index * METAFILE_BATCH_SIZE;
+    uint32_t const       last = min_uint32(first + METAFILE_BATCH_SIZE, round->nspans);
+
+    batch->size = 0;
+    batch->heap_size = 0;
+    for (uint32_t i = first; i < last; ++i) {
+        struct variant_span const* span = round->spans + i;
+        uint64_t const             size = span->genotype_offset - span->start;
+
+        if (size > SIZE_MAX || bgen_buffer_reserve(buffer, (size_t)size) == NULL) {
+            bgen_error("could not malloc variant metadata");
+            return 1;
+        }
+
+        if (bgen_file_read_at(round->bgen, span->start, buffer->data, (size_t)size) ||
+            column_batch_add_raw(batch, span->genotype_offset, buffer->data, (size_t)size))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Same output as `write_metafile`. Variant boundaries are found by a quick pass over the
+ * length fields; the metadata is then parsed by `nthreads` threads into batches, which are
+ * written out in order. */
+static int write_metafile_parallel(FILE* stream, uint32_t nvariants, uint32_t npartitions,
+                                   struct bgen_file*                   bgen,
+                                   struct bgen_metafile_options const* options)
+{
+    struct athr*                 at = NULL;
+    struct variant_span*         spans = NULL;
+    struct column_batch**        batches = NULL;
+    struct bgen_buffer*          buffers = NULL;
+    struct index_builder         indices = {NULL, NULL};
+    struct bgen_metafile_section sections[NSECTIONS];
+    uint64_t                     heap_size = 0;
+    struct variant_scanner       scanner = {bgen, 0, 0, {NULL, 0}, 0, 0};
+
+    /* No more batches, nor threads, than there are variants to fill them. */
+    uint32_t nbatches = (uint32_t)(((uint64_t)nvariants + METAFILE_BATCH_SIZE - 1) /
+                                   METAFILE_BATCH_SIZE);
+    unsigned nthreads = options->nthreads == 0 ? 1 : options->nthreads;
+    if ((uint64_t)nthreads * METAFILE_ROUND_BATCHES < nbatches)
+        nbatches = nthreads * METAFILE_ROUND_BATCHES;
+    if (nbatches == 0)
+        nbatches = 1;
+    if (nthreads > nbatches)
+        nthreads = nbatches;
+    uint64_t const round_size = (uint64_t)nbatches * METAFILE_BATCH_SIZE;
+
+    if (bgen_file_layout(bgen) != 2) {
+        bgen_error("unknown layout %d", bgen_file_layout(bgen));
+        return 1;
+    }
+
+    if (options->verbose) {
+        at = athr_create((long)nvariants, "Writing variants", ATHR_BAR | ATHR_ETA);
+        if (at == NULL) {
+            bgen_error("could not create a progress bar");
+            goto err;
+        }
+    }
+
+    spans = malloc(sizeof(struct variant_span) * round_size);
+    batches = calloc(nbatches, sizeof(struct column_batch*));
+    buffers = malloc(sizeof(struct bgen_buffer) * nthreads);
+    if (spans == NULL || batches == NULL || buffers == NULL) {
+        bgen_error("could not malloc metafile columns");
+        goto err;
+    }
+
+    for (unsigned i = 0; i < nthreads; ++i)
+        bgen_buffer_init(buffers + i);
+
+    for (uint32_t i = 0; i < nbatches; ++i) {
+        if ((batches[i] = column_batch_create(METAFILE_BATCH_SIZE)) == NULL) {
+            bgen_error("could not malloc metafile columns");
+            goto err;
+        }
+    }
+
+    if (index_builder_init(&indices, nvariants))
+        goto err;
+
+    if (bgen_file_size(bgen, &scanner.file_size))
+        goto err;
+    scanner.next = bgen_file_variants_start(bgen);
+
+    plan_sections(sections, nvariants, metafile_nsections(options));
+
+    for (uint32_t done = 0; done < nvariants;) {
+        uint32_t const n = (uint32_t)(round_size < nvariants - done ? round_size
+                                                                    : nvariants - done);
+
+        for (uint32_t i = 0; i < n; ++i) {
+            if (scan_variant(&scanner, spans + i)) {
+                bgen_error("could not write every variant");
+                goto err;
+            }
+        }
+
+        uint32_t const     nused = (n + METAFILE_BATCH_SIZE - 1) / METAFILE_BATCH_SIZE;
+        struct parse_round round = {bgen, spans, n, batches, buffers};
+        if (bgen_pool_run(nthreads, nused, parse_batch, &round))
+            goto err;
+
+        for (uint32_t i = 0; i < nused; ++i) {
+            batches[i]->first = done + i * METAFILE_BATCH_SIZE;
+            if (write_column_batch(stream, sections, batches[i], &heap_size, &indices))
+                goto err;
+        }
+
+        done += n;
+        if (at)
+            athr_consume(at, n);
+    }
+
+    if (at) {
+        athr_finish(at);
+        at = NULL;
+    }
+
+    if (write_metafile_header(stream, nvariants, npartitions, sections, heap_size, &indices,
+                              bgen, options))
+        goto err;
+
+    index_builder_destroy(&indices);
+    bgen_buffer_release(&scanner.window);
+    for (unsigned i = 0; i < nthreads; ++i)
+        bgen_buffer_release(buffers + i);
+    for (uint32_t i = 0; i < nbatches; ++i)
+        column_batch_destroy(batches[i]);
+    bgen_free(buffers);
+    bgen_free(batches);
+    bgen_free(spans);
+    return 0;
+
+err:
+    if (at)
+        athr_finish(at);
+    index_builder_destroy(&indices);
+    bgen_buffer_release(&scanner.window);
+    if (buffers) {
+        for (unsigned i = 0; i < nthreads; ++i)
+            bgen_buffer_release(buffers + i);
+    }
+    if (batches) {
+        for (uint32_t i = 0; i < nbatches; ++i)
+            column_batch_destroy(batches[i]);
+    }
+    bgen_free(buffers);
+    bgen_free(batches);
+    bgen_free(spans);
+    return 1;
 }
 
 #endif
@@ -1,31 +1,65 @@
 #include "partition.h"
+#include "bgen/bstring.h"
+#include "bgen/variant.h"
 #include "bstring.h"
 #include "free.h"
-#include "variant.h"
+#include "report.h"
+#include <stdlib.h>
+#include <string.h>
 
+/* A partition and everything it points to lie in a single allocation:
+ *
+ * [ struct bgen_partition ][ variants ][ strings ][ allele pointers ][ characters ]
+ *
+ * Ids and rsids have a string each. Chromosome names and allele ids are interned: equal ones
+ * share the same string. */
 struct bgen_partition
 {
-    struct bgen_variant const** variants_metadata;
-    uint32_t                    nvariants;
+    uint32_t             nvariants;
+    struct bgen_variant* variants;
 };
 
-void bgen_partition_destroy(struct bgen_partition const* partition)
+/* Variant being read, whose strings are still views into where it is read from. */
+struct pending_variant
 {
-    if (partition->variants_metadata) {
-        for (uint32_t i = 0; i < partition->nvariants; ++i) {
-            if (partition->variants_metadata[i])
-                bgen_variant_destroy(partition->variants_metadata[i]);
-        }
-        bgen_free(partition->variants_metadata);
-    }
+    uint64_t           genotype_offset;
+    struct bgen_string id;
+    struct bgen_string rsid;
+    uint32_t           chrom; /* Interned string. */
+    uint32_t           position;
+    uint16_t           nalleles;
+};
 
-    bgen_free(partition);
-}
+/* Set of distinct strings, with an open-addressing table of their indices. */
+struct intern_table
+{
+    struct bgen_string* strings;
+    uint32_t            size;
+    uint32_t            capacity;
+    uint32_t*           slots; /* `UINT32_MAX` if empty. */
+    uint32_t            nslots;
+    size_t              length; /* Of the strings, altogether. */
+};
+
+struct bgen_partition_builder
+{
+    uint32_t                nvariants;
+    uint32_t                size;
+    struct pending_variant* variants;
+    uint32_t*               alleles; /* Interned strings. */
+    uint64_t                nalleles;
+    uint64_t                alleles_capacity;
+    uint16_t                missing; /* Alleles of the last variant yet to be added. */
+    size_t                  length;  /* Of the ids and rsids, altogether. */
+    struct intern_table     table;
+};
+
+void bgen_partition_destroy(struct bgen_partition const* partition) { bgen_free(partition); }
 
 struct bgen_variant const* bgen_partition_get_variant(struct bgen_partition const* partition,
                                                       uint32_t                     index)
 {
-    return partition->variants_metadata[index];
+    return partition->variants + index;
 }
 
 uint32_t bgen_partition_nvariants(struct bgen_partition const* partition)
@@ -33,18 +67,214 @@ uint32_t bgen_partition_nvariants(struct bgen_partition const* partition)
     return partition->nvariants;
 }
 
-struct bgen_partition* bgen_partition_create(uint32_t nvariants)
+static int intern_table_grow(struct intern_table* table)
 {
-    struct bgen_partition* partition = malloc(sizeof(struct bgen_partition));
-    partition->variants_metadata = malloc(sizeof(struct bgen_variant*) * nvariants);
-    partition->nvariants = nvariants;
-    for (uint32_t i = 0; i < nvariants; ++i)
-        partition->variants_metadata[i] = NULL;
-    return partition;
+    uint32_t const nslots = table->nslots == 0 ? 64 : table->nslots * 2;
+    uint32_t*      slots = malloc(sizeof(uint32_t) * nslots);
+    if (slots == NULL)
+        return 1;
+
+    for (uint32_t i = 0; i < nslots; ++i)
+        slots[i] = UINT32_MAX;
+
+    for (uint32_t k = 0; k < table->size; ++k) {
+        struct bgen_string const* str = table->strings + k;
+        uint32_t                  i = bgen_string_hash(str->data, str->length) & (nslots - 1);
+        while (slots[i] != UINT32_MAX)
+            i = (i + 1) & (nslots - 1);
+        slots[i] = k;
+    }
+
+    bgen_free(table->slots);
+    table->slots = slots;
+    table->nslots = nslots;
+    return 0;
+}
+
+/* Index of the string equal to `str`, added if there is none. */
+static int intern(struct intern_table* table, struct bgen_string str, uint32_t* index)
+{
+    if (table->size >= table->nslots / 2 && intern_table_grow(table))
+        return 1;
+
+    uint32_t const mask = table->nslots - 1;
+    uint32_t       i = bgen_string_hash(str.data, str.length) & mask;
+    for (; table->slots[i] != UINT32_MAX; i = (i + 1) & mask) {
+        struct bgen_string const* s = table->strings + table->slots[i];
+        if (s->length == str.length &&
+            (str.length == 0 || memcmp(s->data, str.data, str.length) == 0)) {
+            *index = table->slots[i];
+            return 0;
+        }
+    }
+
+    if (table->size == table->capacity) {
+        uint32_t const      capacity = table->capacity == 0 ? 32 : table->capacity * 2;
+        struct bgen_string* strings = realloc(table->strings, sizeof(*strings) * capacity);
+        if (strings == NULL)
+            return 1;
+        table->strings = strings;
+        table->capacity = capacity;
+    }
+
+    table->strings[table->size] = str;
+    table->slots[i] = table->size;
+    table->length += str.length;
+    *index = table->size++;
+    return 0;
+}
+
+struct bgen_partition_builder* bgen_partition_builder_create(uint32_t nvariants)
+{
+    struct bgen_partition_builder* builder = calloc(1, sizeof(struct bgen_partition_builder));
+    if (builder == NULL)
+        goto err;
+
+    builder->nvariants = nvariants;
+    builder->variants = malloc(sizeof(struct pending_variant) * ((size_t)nvariants + 1));
+    if (builder->variants == NULL)
+        goto err;
+
+    return builder;
+
+err:
+    bgen_error("could not malloc partition");
+    bgen_partition_builder_destroy(builder);
+    return NULL;
+}
+
+void bgen_partition_builder_destroy(struct bgen_partition_builder* builder)
+{
+    if (builder == NULL)
+        return;
+    bgen_free(builder->variants);
+    bgen_free(builder->alleles);
+    bgen_free(builder->table.strings);
+    bgen_free(builder->table.slots);
+    bgen_free(builder);
 }
 
-void bgen_partition_set(struct bgen_partition* partition, uint32_t index,
-                        struct bgen_variant const* variant_metadata)
+int bgen_partition_builder_add(struct bgen_partition_builder* builder,
+                               uint64_t genotype_offset, struct bgen_string const* strings,
+                               uint32_t position, uint16_t nalleles)
 {
-    partition->variants_metadata[index] = variant_metadata;
+    if (builder->size == builder->nvariants || builder->missing > 0) {
+        bgen_error("unexpected variant for the partition");
+        return 1;
+    }
+
+    if (builder->nalleles + nalleles > builder->alleles_capacity) {
+        uint64_t capacity = builder->alleles_capacity * 2;
+        if (capacity < builder->nalleles + nalleles)
+            capacity = builder->nalleles + nalleles + 64;
+        uint32_t* alleles = capacity <= SIZE_MAX / sizeof(uint32_t)
+                                ? realloc(builder->alleles, sizeof(uint32_t) * capacity)
+                                : NULL;
+        if (alleles == NULL)
+            goto err;
+        builder->alleles = alleles;
+        builder->alleles_capacity = capacity;
+    }
+
+    struct pending_variant* v = builder->variants + builder->size;
+    v->genotype_offset = genotype_offset;
+    v->id = strings[0];
+    v->rsid = strings[1];
+    v->position = position;
+    v->nalleles = nalleles;
+    if (intern(&builder->table, strings[2], &v->chrom))
+        goto err;
+
+    builder->length += v->id.length + v->rsid.length;
+    builder->missing = nalleles;
+    builder->size++;
+    return 0;
+
+err:
+    bgen_error("could not malloc partition");
+    return 1;
+}
+
+int bgen_partition_builder_add_allele(struct bgen_partition_builder* builder,
+                                      struct bgen_string const*      allele)
+{
+    if (builder->missing == 0) {
+        bgen_error("unexpected allele for the partition");
+        return 1;
+    }
+
+    if (intern(&builder->table, *allele, builder->alleles + builder->nalleles)) {
+        bgen_error("could not malloc partition");
+        return 1;
+    }
+
+    builder->nalleles++;
+    builder->missing--;
+    return 0;
+}
+
+/* Copy `str` to `*chars`, and make `dst` point to the copy. */
+static void place_string(struct bgen_string* dst, struct bgen_string str, char** chars)
+{
+    if (str.length > 0)
+        memcpy(*chars, str.data, str.length);
+    dst->data = *chars;
+    dst->length = str.length;
+    *chars += str.length;
+}
+
+struct bgen_partition* bgen_partition_builder_finish(struct bgen_partition_builder* builder)
+{
+    uint32_t const n = builder->size;
+    uint32_t const m = builder->table.size;
+
+    if (builder->missing > 0) {
+        bgen_error("missing alleles for the partition");
+        return NULL;
+    }
+
+    uint64_t const size = sizeof(struct bgen_partition) +
+                          sizeof(struct bgen_variant) * (uint64_t)n +
+                          sizeof(struct bgen_string) * (2 * (uint64_t)n + m) +
+                          sizeof(struct bgen_string*) * builder->nalleles +
+                          (uint64_t)builder->length + (uint64_t)builder->table.length;
+
+    char* arena = size <= SIZE_MAX ? malloc((size_t)size) : NULL;
+    if (arena == NULL) {
+        bgen_error("could not malloc partition");
+        return NULL;
+    }
+
+    struct bgen_partition*     partition = (struct bgen_partition*)arena;
+    struct bgen_variant*       variants = (struct bgen_variant*)(partition + 1);
+    struct bgen_string*        names = (struct bgen_string*)(variants + n);
+    struct bgen_string*        interned = names + 2 * (uint64_t)n;
+    struct bgen_string const** alleles = (struct bgen_string const**)(interned + m);
+    char*                      chars = (char*)(alleles + builder->nalleles);
+
+    partition->nvariants = n;
+    partition->variants = variants;
+
+    for (uint32_t k = 0; k < m; ++k)
+        place_string(interned + k, builder->table.strings[k], &chars);
+
+    uint32_t const* allele = builder->alleles;
+    for (uint32_t i = 0; i < n; ++i) {
+        struct pending_variant const* p = builder->variants + i;
+        struct bgen_variant*          v = variants + i;
+
+        place_string(names + 2 * i, p->id, &chars);
+        place_string(names + 2 * i + 1, p->rsid, &chars);
+        v->genotype_offset = p->genotype_offset;
+        v->id = names + 2 * i;
+        v->rsid = names + 2 * i + 1;
+        v->chrom = interned + p->chrom;
+        v->position = p->position;
+        v->nalleles = p->nalleles;
+        v->allele_ids = alleles;
+        for (uint16_t j = 0; j < p->nalleles; ++j)
+            *alleles++ = interned + *allele++;
+    }
+
+    return partition;
 }
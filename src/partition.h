@@ -2,9 +2,23 @@
 #define BGEN_PARTITION_H_PRIVATE
 
 #include "bgen/partition.h"
+#include <stdint.h>
 
-struct bgen_partition* bgen_partition_create(uint32_t nvariants);
-void                   bgen_partition_set(struct bgen_partition* partition, uint32_t index,
-                                          struct bgen_variant const* variant_metadata);
+struct bgen_string;
+/* Gathers the variants of a partition, then lays them out in a single allocation. */
+struct bgen_partition_builder;
+
+struct bgen_partition_builder* bgen_partition_builder_create(uint32_t nvariants);
+void bgen_partition_builder_destroy(struct bgen_partition_builder* builder);
+/* Add a variant, whose `strings` are its id, rsid, and chrom. Its `nalleles` allele ids are
+ * to be added next. Strings are only copied by `bgen_partition_builder_finish`, and must
+ * remain valid until then. */
+int bgen_partition_builder_add(struct bgen_partition_builder* builder,
+                               uint64_t genotype_offset, struct bgen_string const* strings,
+                               uint32_t position, uint16_t nalleles);
+int bgen_partition_builder_add_allele(struct bgen_partition_builder* builder,
+                                      struct bgen_string const*      allele);
+/* Partition of the variants added so far. The builder still has to be destroyed. */
+struct bgen_partition* bgen_partition_builder_finish(struct bgen_partition_builder* builder);
 
 #endif
@@ -0,0 +1,176 @@
+#include "pool.h"
+#include "free.h"
+#include "report.h"
+#include "thread.h"
+#include <stdlib.h>
+
+/* Range of tasks `[begin, end)` owned by a worker. The owner pops from the front while
+ * thieves take from the back. */
+struct deque
+{
+    struct bgen_mutex mutex;
+    uint32_t          begin;
+    uint32_t          end;
+};
+
+struct pool;
+
+struct worker
+{
+    struct pool*       pool;
+    unsigned           index;
+    struct bgen_thread thread;
+    int                error;
+};
+
+struct pool
+{
+    unsigned          nworkers;
+    struct deque*     deques;
+    struct worker*    workers;
+    struct bgen_mutex mutex;
+    int               canceled;
+    int (*task)(void* arg, unsigned worker, uint32_t index);
+    void* arg;
+};
+
+static int  pop(struct deque* deque, uint32_t* index);
+static int  steal(struct pool* pool, unsigned thief);
+static void cancel(struct pool* pool);
+static void work(void* worker);
+
+int bgen_pool_run(unsigned nthreads, uint32_t ntasks,
+                  int (*task)(void* arg, unsigned worker, uint32_t index), void* arg)
+{
+    if (nthreads > ntasks)
+        nthreads = ntasks;
+
+    if (nthreads <= 1) {
+        for (uint32_t i = 0; i < ntasks; ++i) {
+            if (task(arg, 0, i))
+                return 1;
+        }
+        return 0;
+    }
+
+    struct pool pool;
+    pool.nworkers = nthreads;
+    pool.canceled = 0;
+    pool.task = task;
+    pool.arg = arg;
+    pool.deques = malloc(sizeof(struct deque) * nthreads);
+    pool.workers = malloc(sizeof(struct worker) * nthreads);
+    if (pool.deques == NULL || pool.workers == NULL) {
+        bgen_error("could not allocate thread pool");
+        bgen_free(pool.deques);
+        bgen_free(pool.workers);
+        return 1;
+    }
+
+    bgen_mutex_init(&pool.mutex);
+    for (unsigned w = 0; w < nthreads; ++w) {
+        bgen_mutex_init(&pool.deques[w].mutex);
+        pool.deques[w].begin = (uint32_t)((uint64_t)ntasks * w / nthreads);
+        pool.deques[w].end = (uint32_t)((uint64_t)ntasks * (w + 1) / nthreads);
+        pool.workers[w].pool = &pool;
+        pool.workers[w].index = w;
+        pool.workers[w].error = 0;
+    }
+
+    /* A worker that fails to start has its share stolen by the others. */
+    unsigned nstarted = 1;
+    for (; nstarted < nthreads; ++nstarted) {
+        struct worker* worker = pool.workers + nstarted;
+        if (bgen_thread_create(&worker->thread, work, worker))
+            break;
+    }
+
+    work(pool.workers);
+
+    int error = pool.workers[0].error;
+    for (unsigned w = 1; w < nstarted; ++w) {
+        bgen_thread_join(&pool.workers[w].thread);
+        error |= pool.workers[w].error;
+    }
+
+    for (unsigned w = 0; w < nthreads; ++w)
+        bgen_mutex_destroy(&pool.deques[w].mutex);
+    bgen_mutex_destroy(&pool.mutex);
+    free(pool.deques);
+    free(pool.workers);
+
+    return error;
+}
+
+static int pop(struct deque* deque, uint32_t* index)
+{
+    int found = 0;
+    bgen_mutex_lock(&deque->mutex);
+    if (deque->begin < deque->end) {
+        *index = deque->begin++;
+        found = 1;
+    }
+    bgen_mutex_unlock(&deque->mutex);
+    return found;
+}
+
+/* Move half of the tasks left in the first non-empty deque into the thief's one. */
+static int steal(struct pool* pool, unsigned thief)
+{
+    for (unsigned i = 1; i < pool->nworkers; ++i) {
+        struct deque* victim = pool->deques + (thief + i) % pool->nworkers;
+
+        bgen_mutex_lock(&victim->mutex);
+        uint32_t n = (victim->end - victim->begin + 1) / 2;
+        uint32_t end = victim->end;
+        victim->end -= n;
+        bgen_mutex_unlock(&victim->mutex);
+
+        if (n > 0) {
+            /* The pool lock keeps a concurrent cancel from missing the stolen tasks. */
+            struct deque* deque = pool->deques + thief;
+            bgen_mutex_lock(&pool->mutex);
+            int const canceled = pool->canceled;
+            if (!canceled) {
+                bgen_mutex_lock(&deque->mutex);
+                deque->begin = end - n;
+                deque->end = end;
+                bgen_mutex_unlock(&deque->mutex);
+            }
+            bgen_mutex_unlock(&pool->mutex);
+            return !canceled;
+        }
+    }
+    return 0;
+}
+
+static void cancel(struct pool* pool)
+{
+    bgen_mutex_lock(&pool->mutex);
+    pool->canceled = 1;
+    for (unsigned w = 0; w < pool->nworkers; ++w) {
+        struct deque* deque = pool->deques + w;
+        bgen_mutex_lock(&deque->mutex);
+        deque->end = deque->begin;
+        bgen_mutex_unlock(&deque->mutex);
+    }
+    bgen_mutex_unlock(&pool->mutex);
+}
+
+static void work(void* worker)
+{
+    struct worker* self = worker;
+    struct pool*   pool = self->pool;
+    struct deque*  deque = pool->deques + self->index;
+    uint32_t       index = 0;
+
+    do {
+        while (pop(deque, &index)) {
+            if (pool->task(pool->arg, self->index, index)) {
+                self->error = 1;
+                cancel(pool);
+                return;
+            }
+        }
+    } while (steal(pool, self->index));
+}
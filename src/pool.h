@@ -0,0 +1,16 @@
+#ifndef BGEN_POOL_H
+#define BGEN_POOL_H
+
+#include <stdint.h>
+
+/* Call `task(arg, worker, index)` for every `index` in `[0, ntasks)` using up to `nthreads`
+ * workers, the calling thread being worker `0`. Each worker starts with a contiguous share
+ * of the tasks and, once it runs out of them, steals half of another worker's remaining
+ * share. Tasks of the same worker never run concurrently, so per-worker state can be
+ * indexed by `worker`. A failing task (non-zero return) cancels the tasks not yet started.
+ *
+ * Return `0` if every task succeeds; `1` otherwise. */
+int bgen_pool_run(unsigned nthreads, uint32_t ntasks,
+                  int (*task)(void* arg, unsigned worker, uint32_t index), void* arg);
+
+#endif
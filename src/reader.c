@@ -0,0 +1,132 @@
+#include "reader.h"
+#include "bgen/file.h"
+#include "bgen/genotype.h"
+#include "bgen/reader.h"
+#include "file.h"
+#include "free.h"
+#include "genotype.h"
+#include "report.h"
+#include "zip/zlib.h"
+#include "zip/zstd.h"
+
+struct bgen_reader
+{
+    struct bgen_file*     bgen_file;
+    struct bgen_zlib*     zlib;
+    struct bgen_zstd*     zstd;
+    struct bgen_genotype* spare; /* Last closed genotype, ready to be reused. */
+    /* Streaming mode: variants expected to be opened in the order of `stream`. */
+    uint64_t const*       stream;
+    uint32_t              stream_size;
+    uint32_t              stream_next;   /* Index of the next variant expected. */
+    uint32_t              stream_hinted; /* Variants before it have been prefetched. */
+    uint32_t              window;
+};
+
+struct bgen_reader* bgen_reader_create(struct bgen_file* bgen_file)
+{
+    struct bgen_reader* reader = malloc(sizeof(struct bgen_reader));
+    if (reader == NULL) {
+        bgen_error("could not malloc reader");
+        return NULL;
+    }
+
+    reader->bgen_file = bgen_file;
+    reader->zlib = bgen_zlib_create();
+    reader->zstd = bgen_zstd_create();
+    reader->spare = NULL;
+    reader->stream = NULL;
+    reader->stream_size = 0;
+    reader->stream_next = 0;
+    reader->stream_hinted = 0;
+    reader->window = 0;
+
+    if (reader->zlib == NULL || reader->zstd == NULL) {
+        bgen_error("could not malloc decompression contexts");
+        bgen_reader_destroy(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void bgen_reader_destroy(struct bgen_reader const* reader)
+{
+    bgen_zlib_destroy(reader->zlib);
+    bgen_zstd_destroy(reader->zstd);
+    if (reader->spare != NULL)
+        bgen_genotype_destroy(reader->spare);
+    bgen_free(reader);
+}
+
+/* Keep up to `window` variants past the next one prefetched. Hints are issued half a window
+ * at a time, which keeps the number of system calls low. */
+static void read_ahead(struct bgen_reader* reader)
+{
+    uint32_t const next = reader->stream_next;
+    uint32_t const left = reader->stream_size - next;
+    uint32_t const end = left > reader->window ? next + reader->window : reader->stream_size;
+
+    if (reader->stream_hinted < next)
+        reader->stream_hinted = next;
+    if (reader->stream_hinted == reader->stream_size ||
+        reader->stream_hinted - next > reader->window / 2)
+        return;
+
+    /* The variant past the window bounds the last block hinted. */
+    uint64_t const next_offset = end < reader->stream_size ? reader->stream[end] : 0;
+    bgen_file_prefetch_until(reader->bgen_file, reader->stream + reader->stream_hinted,
+                             end - reader->stream_hinted, next_offset);
+    reader->stream_hinted = end;
+}
+
+void bgen_reader_stream(struct bgen_reader* reader, uint64_t const* genotype_offsets,
+                        uint32_t nvariants, uint32_t window)
+{
+    reader->stream = genotype_offsets;
+    reader->stream_size = window == 0 ? 0 : nvariants;
+    reader->stream_next = 0;
+    reader->stream_hinted = 0;
+    reader->window = window;
+    if (reader->stream_size > 0)
+        read_ahead(reader);
+}
+
+struct bgen_genotype* bgen_reader_open_genotype(struct bgen_reader* reader,
+                                                uint64_t            genotype_offset)
+{
+    if (reader->stream_next < reader->stream_size &&
+        reader->stream[reader->stream_next] == genotype_offset) {
+        ++reader->stream_next;
+        read_ahead(reader);
+    }
+
+    struct bgen_genotype* genotype = reader->spare;
+    if (genotype == NULL)
+        genotype = bgen_genotype_create();
+    reader->spare = NULL;
+    genotype->reader = reader;
+
+    if (bgen_reader_load_genotype(reader, genotype, genotype_offset)) {
+        bgen_genotype_close(genotype);
+        return NULL;
+    }
+
+    return genotype;
+}
+
+int bgen_reader_load_genotype(struct bgen_reader* reader, struct bgen_genotype* genotype,
+                              uint64_t offset)
+{
+    genotype->zlib = reader->zlib;
+    genotype->zstd = reader->zstd;
+    return bgen_file_load_genotype(reader->bgen_file, genotype, offset);
+}
+
+bool bgen_reader_recycle(struct bgen_reader* reader, struct bgen_genotype const* genotype)
+{
+    if (reader->spare != NULL)
+        return false;
+    reader->spare = (struct bgen_genotype*)genotype;
+    return true;
+}
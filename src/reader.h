@@ -0,0 +1,18 @@
+#ifndef BGEN_READER_H_PRIVATE
+#define BGEN_READER_H_PRIVATE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct bgen_genotype;
+struct bgen_reader;
+
+/* Read the variant genotype at `offset` into an existing handler, which will then use the
+ * decompression contexts of `reader`. */
+int bgen_reader_load_genotype(struct bgen_reader* reader, struct bgen_genotype* genotype,
+                              uint64_t offset);
+/* Keep a closed handler for the next `bgen_reader_open_genotype` call, so that it and its
+ * buffers are reused. Return `false` if the handler has to be destroyed instead. */
+bool bgen_reader_recycle(struct bgen_reader* reader, struct bgen_genotype const* genotype);
+
+#endif
@@ -0,0 +1,393 @@
+#include "bgen/scan.h"
+#include "bgen/file.h"
+#include "bgen/genotype.h"
+#include "buffer.h"
+#include "file.h"
+#include "free.h"
+#include "genotype.h"
+#include "report.h"
+#include "thread.h"
+#include "zip/zlib.h"
+#include "zip/zstd.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+static struct bgen_scan_options const default_options = {2, 2, 16};
+
+/* Variant `v` always goes into slot `v % nslots`: the caller hands slots back in order, so
+ * the reader only has to wait for the slot of the variant it is about to fetch. */
+struct slot
+{
+    struct bgen_genotype* genotype;
+    uint32_t              variant;
+    char const*           block; /* Genotype block as fetched by the reader. */
+    size_t                block_size;
+    struct bgen_buffer    probabilities;
+    bool                  ready; /* Decoded and waiting for the caller. */
+};
+
+/* First-in, first-out queue of slot indices. It can hold every slot, so pushing never
+ * blocks: the number of slots is what bounds the work in flight. */
+struct queue
+{
+    struct bgen_mutex mutex;
+    struct bgen_cond  nonempty;
+    uint32_t*         items;
+    uint32_t          capacity;
+    uint32_t          head;
+    uint32_t          size;
+    bool              closed;
+};
+
+struct stage
+{
+    struct bgen_scan*  scan;
+    struct bgen_thread thread;
+};
+
+struct bgen_scan
+{
+    struct bgen_file* bgen_file;
+    uint64_t const*   genotype_offsets;
+    uint32_t          nvariants;
+    struct slot*      slots;
+    uint32_t          nslots;
+    struct queue      decompress;
+    struct queue      decode;
+    /* The mutex guards the fields below and the `ready` flag of the slots. */
+    struct bgen_mutex mutex;
+    struct bgen_cond  slot_ready;
+    struct bgen_cond  slot_free;
+    uint32_t          next;     /* Next variant to be delivered. */
+    uint32_t          released; /* Variants the caller is done with. */
+    uint32_t          end;      /* Variants to be delivered, fewer after a failure. */
+    unsigned          ndecompressing;
+    bool              failed;
+    bool              stopped;
+    struct stage*     stages;
+    unsigned          nstages;
+};
+
+static int  queue_init(struct queue* queue, uint32_t capacity);
+static void queue_push(struct queue* queue, uint32_t item);
+static bool queue_pop(struct queue* queue, uint32_t* item);
+static void queue_close(struct queue* queue);
+static void queue_release(struct queue* queue);
+static void fail(struct bgen_scan* scan, uint32_t variant);
+static void halt(struct bgen_scan* scan);
+static void read_blocks(void* arg);
+static void decompress_blocks(void* arg);
+static void decode_blocks(void* arg);
+
+struct bgen_scan* bgen_scan_create(struct bgen_file*               bgen_file,
+                                   uint64_t const*                 genotype_offsets,
+                                   uint32_t                        nvariants,
+                                   struct bgen_scan_options const* options)
+{
+    if (options == NULL)
+        options = &default_options;
+
+    struct bgen_scan* scan = malloc(sizeof(struct bgen_scan));
+    if (scan == NULL) {
+        bgen_error("could not malloc scan");
+        return NULL;
+    }
+
+    scan->bgen_file = bgen_file;
+    scan->genotype_offsets = genotype_offsets;
+    scan->nvariants = nvariants;
+    scan->nslots = options->nbuffers == 0 ? 1 : options->nbuffers;
+    scan->next = 0;
+    scan->released = 0;
+    scan->end = nvariants;
+    scan->ndecompressing = options->ndecompress == 0 ? 1 : options->ndecompress;
+    scan->failed = false;
+    scan->stopped = false;
+    scan->nstages = 0;
+    unsigned const ndecode = options->ndecode == 0 ? 1 : options->ndecode;
+
+    scan->slots = malloc(sizeof(struct slot) * scan->nslots);
+    scan->stages = malloc(sizeof(struct stage) * (1 + scan->ndecompressing + ndecode));
+    bool error = scan->slots == NULL || scan->stages == NULL;
+    if (error) {
+        bgen_error("could not malloc scan");
+        bgen_free(scan->slots);
+        bgen_free(scan->stages);
+        bgen_free(scan);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < scan->nslots; ++i) {
+        scan->slots[i].genotype = bgen_genotype_create();
+        scan->slots[i].variant = 0;
+        scan->slots[i].block = NULL;
+        scan->slots[i].block_size = 0;
+        bgen_buffer_init(&scan->slots[i].probabilities);
+        scan->slots[i].ready = false;
+    }
+    error = queue_init(&scan->decompress, scan->nslots);
+    error = queue_init(&scan->decode, scan->nslots) || error;
+    bgen_mutex_init(&scan->mutex);
+    bgen_cond_init(&scan->slot_ready);
+    bgen_cond_init(&scan->slot_free);
+    if (error) {
+        bgen_error("could not malloc scan queues");
+        bgen_scan_close(scan);
+        return NULL;
+    }
+
+    void (*const stages[])(void*) = {read_blocks, decompress_blocks, decode_blocks};
+    unsigned const nthreads[] = {1, scan->ndecompressing, ndecode};
+    for (unsigned k = 0; k < 3 && !error; ++k) {
+        for (unsigned i = 0; i < nthreads[k] && !error; ++i) {
+            struct stage* stage = scan->stages + scan->nstages;
+            stage->scan = scan;
+            if (bgen_thread_create(&stage->thread, stages[k], stage)) {
+                bgen_error("could not create scan thread");
+                error = true;
+            } else {
+                ++scan->nstages;
+            }
+        }
+    }
+
+    if (error) {
+        bgen_scan_close(scan);
+        return NULL;
+    }
+    return scan;
+}
+
+struct bgen_genotype* bgen_scan_next(struct bgen_scan* scan, double const** probabilities)
+{
+    bgen_mutex_lock(&scan->mutex);
+
+    /* The variant delivered last time is not needed anymore. */
+    if (scan->released < scan->next) {
+        scan->released = scan->next;
+        bgen_cond_signal(&scan->slot_free);
+    }
+
+    struct slot* slot = scan->slots + scan->next % scan->nslots;
+    while (scan->next < scan->end && !slot->ready)
+        bgen_cond_wait(&scan->slot_ready, &scan->mutex);
+
+    if (scan->next >= scan->end) {
+        bgen_mutex_unlock(&scan->mutex);
+        return NULL;
+    }
+
+    slot->ready = false;
+    ++scan->next;
+    bgen_mutex_unlock(&scan->mutex);
+
+    *probabilities = (double const*)slot->probabilities.data;
+    return slot->genotype;
+}
+
+int bgen_scan_close(struct bgen_scan* scan)
+{
+    halt(scan);
+    for (unsigned i = 0; i < scan->nstages; ++i)
+        bgen_thread_join(&scan->stages[i].thread);
+
+    int error = scan->failed;
+    for (uint32_t i = 0; i < scan->nslots; ++i) {
+        bgen_genotype_destroy(scan->slots[i].genotype);
+        bgen_buffer_release(&scan->slots[i].probabilities);
+    }
+    queue_release(&scan->decompress);
+    queue_release(&scan->decode);
+    bgen_cond_destroy(&scan->slot_free);
+    bgen_cond_destroy(&scan->slot_ready);
+    bgen_mutex_destroy(&scan->mutex);
+    bgen_free(scan->stages);
+    bgen_free(scan->slots);
+    bgen_free(scan);
+    return error;
+}
+
+/* Variants from `variant` onwards will not be delivered. Those before it still are. */
+static void fail(struct bgen_scan* scan, uint32_t variant)
+{
+    bgen_mutex_lock(&scan->mutex);
+    scan->failed = true;
+    if (variant < scan->end)
+        scan->end = variant;
+    bgen_cond_broadcast(&scan->slot_ready);
+    bgen_mutex_unlock(&scan->mutex);
+}
+
+/* Stop every stage, dropping the variants in flight. */
+static void halt(struct bgen_scan* scan)
+{
+    bgen_mutex_lock(&scan->mutex);
+    scan->stopped = true;
+    bgen_cond_broadcast(&scan->slot_free);
+    bgen_cond_broadcast(&scan->slot_ready);
+    bgen_mutex_unlock(&scan->mutex);
+    queue_close(&scan->decompress);
+    queue_close(&scan->decode);
+}
+
+static bool stopped(struct bgen_scan* scan)
+{
+    bgen_mutex_lock(&scan->mutex);
+    bool stop = scan->stopped;
+    bgen_mutex_unlock(&scan->mutex);
+    return stop;
+}
+
+/* First stage: fetch genotype blocks one after the other, so that the file is read
+ * sequentially if the offsets are in increasing order. */
+static void read_blocks(void* arg)
+{
+    struct bgen_scan* scan = ((struct stage*)arg)->scan;
+
+    for (uint32_t v = 0; v < scan->nvariants; ++v) {
+        bgen_mutex_lock(&scan->mutex);
+        while (v - scan->released >= scan->nslots && !scan->stopped)
+            bgen_cond_wait(&scan->slot_free, &scan->mutex);
+        bool stop = scan->stopped || v >= scan->end;
+        bgen_mutex_unlock(&scan->mutex);
+        if (stop)
+            break;
+
+        struct slot* slot = scan->slots + v % scan->nslots;
+        slot->variant = v;
+        if (bgen_file_fetch_block(scan->bgen_file, slot->genotype, scan->genotype_offsets[v],
+                                  &slot->block, &slot->block_size)) {
+            fail(scan, v);
+            break;
+        }
+        queue_push(&scan->decompress, v % scan->nslots);
+    }
+    queue_close(&scan->decompress);
+}
+
+/* Second stage: parse and decompress blocks, each thread with its own contexts. */
+static void decompress_blocks(void* arg)
+{
+    struct bgen_scan* scan = ((struct stage*)arg)->scan;
+    struct bgen_zlib* zlib = bgen_zlib_create();
+    struct bgen_zstd* zstd = bgen_zstd_create();
+    uint32_t          s = 0;
+
+    bool const ready = zlib != NULL && zstd != NULL;
+    if (!ready) {
+        bgen_error("could not malloc decompression contexts");
+        fail(scan, 0);
+    }
+
+    while (ready && !stopped(scan) && queue_pop(&scan->decompress, &s)) {
+        struct slot*          slot = scan->slots + s;
+        struct bgen_genotype* genotype = slot->genotype;
+        uint64_t const        offset = scan->genotype_offsets[slot->variant];
+
+        genotype->zlib = zlib;
+        genotype->zstd = zstd;
+        int error = slot->block == NULL
+                        ? bgen_file_load_genotype(scan->bgen_file, genotype, offset)
+                        : bgen_file_load_genotype_block(scan->bgen_file, genotype, offset,
+                                                        slot->block, slot->block_size);
+        genotype->zlib = NULL;
+        genotype->zstd = NULL;
+        if (error)
+            fail(scan, slot->variant);
+        else
+            queue_push(&scan->decode, s);
+    }
+
+    if (zlib != NULL)
+        bgen_zlib_destroy(zlib);
+    if (zstd != NULL)
+        bgen_zstd_destroy(zstd);
+
+    bgen_mutex_lock(&scan->mutex);
+    bool last = --scan->ndecompressing == 0;
+    bgen_mutex_unlock(&scan->mutex);
+    if (last)
+        queue_close(&scan->decode);
+}
+
+/* Third stage: decode probabilities and hand the slot to the caller. */
+static void decode_blocks(void* arg)
+{
+    struct bgen_scan* scan = ((struct stage*)arg)->scan;
+    uint32_t          s = 0;
+
+    while (!stopped(scan) && queue_pop(&scan->decode, &s)) {
+        struct slot*          slot = scan->slots + s;
+        struct bgen_genotype* genotype = slot->genotype;
+
+        size_t const size = (size_t)genotype->nsamples * genotype->ncombs * sizeof(double);
+        double*      probs = (double*)bgen_buffer_reserve(&slot->probabilities, size);
+        if (probs == NULL) {
+            bgen_error("could not malloc probabilities");
+            fail(scan, slot->variant);
+            continue;
+        }
+        if (bgen_genotype_read(genotype, probs)) {
+            fail(scan, slot->variant);
+            continue;
+        }
+
+        bgen_mutex_lock(&scan->mutex);
+        slot->ready = true;
+        bgen_cond_broadcast(&scan->slot_ready);
+        bgen_mutex_unlock(&scan->mutex);
+    }
+}
+
+static int queue_init(struct queue* queue, uint32_t capacity)
+{
+    bgen_mutex_init(&queue->mutex);
+    bgen_cond_init(&queue->nonempty);
+    queue->items = malloc(sizeof(uint32_t) * capacity);
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->size = 0;
+    queue->closed = false;
+    return queue->items == NULL;
+}
+
+static void queue_push(struct queue* queue, uint32_t item)
+{
+    bgen_mutex_lock(&queue->mutex);
+    queue->items[(queue->head + queue->size) % queue->capacity] = item;
+    ++queue->size;
+    bgen_cond_signal(&queue->nonempty);
+    bgen_mutex_unlock(&queue->mutex);
+}
+
+/* Wait for an item. Return `false` once the queue is closed and empty. */
+static bool queue_pop(struct queue* queue, uint32_t* item)
+{
+    bgen_mutex_lock(&queue->mutex);
+    while (queue->size == 0 && !queue->closed)
+        bgen_cond_wait(&queue->nonempty, &queue->mutex);
+
+    bool const found = queue->size > 0;
+    if (found) {
+        *item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->size;
+    }
+    bgen_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+static void queue_close(struct queue* queue)
+{
+    bgen_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    bgen_cond_broadcast(&queue->nonempty);
+    bgen_mutex_unlock(&queue->mutex);
+}
+
+static void queue_release(struct queue* queue)
+{
+    bgen_free(queue->items);
+    bgen_cond_destroy(&queue->nonempty);
+    bgen_mutex_destroy(&queue->mutex);
+}
@@ -0,0 +1,155 @@
+#ifndef BGEN_THREAD_H
+#define BGEN_THREAD_H
+
+#if defined(_WIN32)
+#include <process.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+struct bgen_thread
+{
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    void (*func)(void*);
+    void* arg;
+};
+
+struct bgen_mutex
+{
+#if defined(_WIN32)
+    SRWLOCK handle;
+#else
+    pthread_mutex_t handle;
+#endif
+};
+
+struct bgen_cond
+{
+#if defined(_WIN32)
+    CONDITION_VARIABLE handle;
+#else
+    pthread_cond_t handle;
+#endif
+};
+
+#if defined(_WIN32)
+static unsigned __stdcall bgen_thread_main(void* thread)
+{
+    ((struct bgen_thread*)thread)->func(((struct bgen_thread*)thread)->arg);
+    return 0;
+}
+#else
+static void* bgen_thread_main(void* thread)
+{
+    ((struct bgen_thread*)thread)->func(((struct bgen_thread*)thread)->arg);
+    return NULL;
+}
+#endif
+
+/* The `thread` struct must outlive the thread itself. */
+static inline int bgen_thread_create(struct bgen_thread* thread, void (*func)(void*),
+                                     void* arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+#if defined(_WIN32)
+    thread->handle = (HANDLE)_beginthreadex(NULL, 0, bgen_thread_main, thread, 0, NULL);
+    return thread->handle == 0;
+#else
+    return pthread_create(&thread->handle, NULL, bgen_thread_main, thread) != 0;
+#endif
+}
+
+static inline void bgen_thread_join(struct bgen_thread* thread)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+}
+
+static inline void bgen_mutex_init(struct bgen_mutex* mutex)
+{
+#if defined(_WIN32)
+    InitializeSRWLock(&mutex->handle);
+#else
+    pthread_mutex_init(&mutex->handle, NULL);
+#endif
+}
+
+static inline void bgen_mutex_destroy(struct bgen_mutex* mutex)
+{
+#if !defined(_WIN32)
+    pthread_mutex_destroy(&mutex->handle);
+#endif
+}
+
+static inline void bgen_mutex_lock(struct bgen_mutex* mutex)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&mutex->handle);
+#else
+    pthread_mutex_lock(&mutex->handle);
+#endif
+}
+
+static inline void bgen_mutex_unlock(struct bgen_mutex* mutex)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&mutex->handle);
+#else
+    pthread_mutex_unlock(&mutex->handle);
+#endif
+}
+
+static inline void bgen_cond_init(struct bgen_cond* cond)
+{
+#if defined(_WIN32)
+    InitializeConditionVariable(&cond->handle);
+#else
+    pthread_cond_init(&cond->handle, NULL);
+#endif
+}
+
+static inline void bgen_cond_destroy(struct bgen_cond* cond)
+{
+#if !defined(_WIN32)
+    pthread_cond_destroy(&cond->handle);
+#endif
+}
+
+static inline void bgen_cond_wait(struct bgen_cond* cond, struct bgen_mutex* mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&cond->handle, &mutex->handle, INFINITE, 0);
+#else
+    pthread_cond_wait(&cond->handle, &mutex->handle);
+#endif
+}
+
+static inline void bgen_cond_signal(struct bgen_cond* cond)
+{
+#if defined(_WIN32)
+    WakeConditionVariable(&cond->handle);
+#else
+    pthread_cond_signal(&cond->handle);
+#endif
+}
+
+static inline void bgen_cond_broadcast(struct bgen_cond* cond)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&cond->handle);
+#else
+    pthread_cond_broadcast(&cond->handle);
+#endif
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "unpack.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BGEN_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
+static void unpack_scalar(uint32_t* dst, unsigned char const* mem, unsigned char const* end,
+                          uint64_t offset, size_t n, unsigned nbits)
+{
+    uint64_t const mask = ((uint64_t)1 << nbits) - 1;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t word = bgen_load64(mem + offset / 8, end);
+        dst[i] = (uint32_t)((word >> (offset % 8)) & mask);
+        offset += nbits;
+    }
+}
+
+#if defined(BGEN_AVX2_DISPATCH)
+
+/* Eight integers take exactly `nbits` bytes, so every group of eight starts at the same bit
+ * within its first byte, and the per-lane byte offsets and shifts are loop invariant. */
+__attribute__((target("avx2"))) static size_t
+unpack_avx2(uint32_t* dst, unsigned char const* mem, unsigned char const* end, uint64_t offset,
+            size_t n, unsigned nbits)
+{
+    unsigned char const* p = mem + offset / 8;
+    unsigned const       first = (unsigned)(offset % 8);
+
+    int idx[8];
+    int shift[8];
+    for (unsigned i = 0; i < 8; ++i) {
+        idx[i] = (int)((first + i * nbits) / 8);
+        shift[i] = (int)((first + i * nbits) % 8);
+    }
+
+    size_t ngroups = n / 8;
+    size_t i = 0;
+
+    if (nbits <= 25) {
+        /* A 32-bit load covers any integer of up to 25 bits plus 7 bits of shift. */
+        __m256i const   vidx = _mm256_loadu_si256((__m256i const*)idx);
+        __m256i const   vshift = _mm256_loadu_si256((__m256i const*)shift);
+        __m256i const   vmask = _mm256_set1_epi32((int)((1u << nbits) - 1));
+        ptrdiff_t const reach = idx[7] + 4;
+
+        for (; i < ngroups && end - p >= reach; ++i) {
+            __m256i v = _mm256_i32gather_epi32((int const*)p, vidx, 1);
+            v = _mm256_and_si256(_mm256_srlv_epi32(v, vshift), vmask);
+            _mm256_storeu_si256((__m256i*)(dst + 8 * i), v);
+            p += nbits;
+        }
+    } else {
+        __m128i const   lidx = _mm_loadu_si128((__m128i const*)idx);
+        __m128i const   hidx = _mm_loadu_si128((__m128i const*)(idx + 4));
+        __m256i const   lshift = _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i const*)shift));
+        __m256i const   hshift =
+            _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i const*)(shift + 4)));
+        __m256i const   vmask = _mm256_set1_epi64x((long long)(((uint64_t)1 << nbits) - 1));
+        __m256i const   pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        ptrdiff_t const reach = idx[7] + 8;
+
+        for (; i < ngroups && end - p >= reach; ++i) {
+            __m256i lo = _mm256_i32gather_epi64((long long const*)p, lidx, 1);
+            __m256i hi = _mm256_i32gather_epi64((long long const*)p, hidx, 1);
+            lo = _mm256_and_si256(_mm256_srlv_epi64(lo, lshift), vmask);
+            hi = _mm256_and_si256(_mm256_srlv_epi64(hi, hshift), vmask);
+            lo = _mm256_permutevar8x32_epi32(lo, pack);
+            hi = _mm256_permutevar8x32_epi32(hi, pack);
+            __m256i v = _mm256_permute2x128_si256(lo, hi, 0x20);
+            _mm256_storeu_si256((__m256i*)(dst + 8 * i), v);
+            p += nbits;
+        }
+    }
+
+    return 8 * i;
+}
+
+#endif
+
+void bgen_unpack_bits(uint32_t* dst, char const* mem, char const* end, uint64_t offset,
+                      size_t n, unsigned nbits)
+{
+    unsigned char const* umem = (unsigned char const*)mem;
+    unsigned char const* uend = (unsigned char const*)end;
+    size_t               done = 0;
+
+#if defined(BGEN_AVX2_DISPATCH)
+    if (n >= 8 && __builtin_cpu_supports("avx2"))
+        done = unpack_avx2(dst, umem, uend, offset, n, nbits);
+#endif
+
+    unpack_scalar(dst + done, umem, uend, offset + done * nbits, n - done, nbits);
+}
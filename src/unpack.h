@@ -0,0 +1,35 @@
+#ifndef BGEN_UNPACK_H
+#define BGEN_UNPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Load 8 little-endian bytes from `p`, as zeros past `end`. */
+static inline uint64_t bgen_load64(unsigned char const* p, unsigned char const* end)
+{
+    uint64_t word = 0;
+    if (end - p >= 8) {
+        memcpy(&word, p, sizeof(word));
+        return word;
+    }
+    for (unsigned i = 0; p + i < end; ++i)
+        word |= (uint64_t)p[i] << (8 * i);
+    return word;
+}
+
+/* Read an integer of `nbits` bits (at most 32) starting at bit `offset` of `mem`. */
+static inline uint32_t bgen_read_bits(char const* mem, char const* end, uint64_t offset,
+                                      unsigned nbits)
+{
+    unsigned char const* p = (unsigned char const*)mem + offset / 8;
+    uint64_t             word = bgen_load64(p, (unsigned char const*)end);
+    return (uint32_t)((word >> (offset % 8)) & (((uint64_t)1 << nbits) - 1));
+}
+
+/* Unpack `n` consecutive integers of `nbits` bits (at most 32) starting at bit `offset` of
+ * `mem`. Bytes past `end` are never touched. It uses AVX2 if the CPU supports it. */
+void bgen_unpack_bits(uint32_t* dst, char const* mem, char const* end, uint64_t offset,
+                      size_t n, unsigned nbits);
+
+#endif
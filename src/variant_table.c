@@ -0,0 +1,91 @@
+#include "variant_table.h"
+#include "bgen/bstring.h"
+#include "free.h"
+#include "report.h"
+#include <stdlib.h>
+
+/* A table and its arrays lie in a single allocation, ordered by alignment:
+ *
+ * [ struct bgen_variant_table ][ genotype offsets ][ first strings ][ string offsets ]
+ * [ chromosome names ][ positions ][ chromosomes ][ numbers of alleles ][ characters ] */
+struct bgen_variant_table* bgen_variant_table_alloc(
+    uint32_t nvariants, uint64_t nstrings, uint64_t length, uint32_t nchroms,
+    uint64_t chrom_length, struct bgen_variant_table_columns* columns)
+{
+    uint64_t const n = nvariants;
+    uint64_t const size = sizeof(struct bgen_variant_table) + sizeof(uint64_t) * n +
+                          sizeof(uint64_t) * (n + 1) + sizeof(uint64_t) * (nstrings + 1) +
+                          sizeof(struct bgen_string) * (uint64_t)nchroms +
+                          sizeof(uint32_t) * 2 * n + sizeof(uint16_t) * n + length +
+                          chrom_length;
+
+    char* arena = nstrings < UINT64_MAX / 16 && size <= SIZE_MAX ? malloc((size_t)size) : NULL;
+    if (arena == NULL) {
+        bgen_error("could not malloc variant table");
+        return NULL;
+    }
+
+    struct bgen_variant_table* table = (struct bgen_variant_table*)arena;
+    columns->genotype_offsets = (uint64_t*)(table + 1);
+    columns->first_string = columns->genotype_offsets + n;
+    columns->string_offsets = columns->first_string + n + 1;
+    columns->chrom_names = (struct bgen_string*)(columns->string_offsets + nstrings + 1);
+    columns->positions = (uint32_t*)(columns->chrom_names + nchroms);
+    columns->chroms = columns->positions + n;
+    columns->nalleles = (uint16_t*)(columns->chroms + n);
+    columns->heap = (char*)(columns->nalleles + n);
+    columns->chrom_chars = columns->heap + length;
+
+    table->nvariants = nvariants;
+    table->genotype_offsets = columns->genotype_offsets;
+    table->positions = columns->positions;
+    table->nalleles = columns->nalleles;
+    table->chroms = columns->chroms;
+    table->nchroms = nchroms;
+    table->chrom_names = columns->chrom_names;
+    table->first_string = columns->first_string;
+    table->string_offsets = columns->string_offsets;
+    table->heap = columns->heap;
+    return table;
+}
+
+void bgen_variant_table_destroy(struct bgen_variant_table const* table) { bgen_free(table); }
+
+static struct bgen_string table_string(struct bgen_variant_table const* table, uint64_t k)
+{
+    return (struct bgen_string){
+        (size_t)(table->string_offsets[k + 1] - table->string_offsets[k]),
+        table->heap + table->string_offsets[k]};
+}
+
+struct bgen_string bgen_variant_table_id(struct bgen_variant_table const* table,
+                                         uint32_t                         index)
+{
+    if (index >= table->nvariants)
+        return (struct bgen_string){0, NULL};
+    return table_string(table, table->first_string[index]);
+}
+
+struct bgen_string bgen_variant_table_rsid(struct bgen_variant_table const* table,
+                                           uint32_t                         index)
+{
+    if (index >= table->nvariants)
+        return (struct bgen_string){0, NULL};
+    return table_string(table, table->first_string[index] + 1);
+}
+
+struct bgen_string bgen_variant_table_chrom(struct bgen_variant_table const* table,
+                                            uint32_t                         index)
+{
+    if (index >= table->nvariants)
+        return (struct bgen_string){0, NULL};
+    return table->chrom_names[table->chroms[index]];
+}
+
+struct bgen_string bgen_variant_table_allele_id(struct bgen_variant_table const* table,
+                                                uint32_t index, uint16_t allele)
+{
+    if (index >= table->nvariants || allele >= table->nalleles[index])
+        return (struct bgen_string){0, NULL};
+    return table_string(table, table->first_string[index] + 2 + allele);
+}
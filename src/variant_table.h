@@ -0,0 +1,28 @@
+#ifndef BGEN_VARIANT_TABLE_H_PRIVATE
+#define BGEN_VARIANT_TABLE_H_PRIVATE
+
+#include "bgen/variant_table.h"
+#include <stdint.h>
+
+/* Writable view of the arrays of a table being filled in. */
+struct bgen_variant_table_columns
+{
+    uint64_t*           genotype_offsets;
+    uint32_t*           positions;
+    uint16_t*           nalleles;
+    uint32_t*           chroms;
+    struct bgen_string* chrom_names;
+    uint64_t*           first_string;
+    uint64_t*           string_offsets;
+    char*               heap;
+    char*               chrom_chars; /* Characters of the chromosome names. */
+};
+
+/* Allocate a table of `nvariants` variants having `nstrings` strings of `length` characters
+ * altogether, and `nchroms` chromosomes whose names have `chrom_length` characters. Its
+ * arrays are left for the caller to fill in through `columns`. */
+struct bgen_variant_table* bgen_variant_table_alloc(
+    uint32_t nvariants, uint64_t nstrings, uint64_t length, uint32_t nchroms,
+    uint64_t chrom_length, struct bgen_variant_table_columns* columns);
+
+#endif
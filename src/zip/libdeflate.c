@@ -0,0 +1,119 @@
+#define ZLIB_CONST
+#include "zip/zlib.h"
+#include "report.h"
+#include <libdeflate.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+/* Drop-in replacement for the zlib backend. The whole compressed block and its inflated
+ * size are known up front, which lets libdeflate decode it in a single, faster call. */
+
+struct bgen_zlib
+{
+    struct libdeflate_decompressor* decompressor; /* Created on first use. */
+};
+
+struct bgen_zlib* bgen_zlib_create(void)
+{
+    struct bgen_zlib* zlib = malloc(sizeof(struct bgen_zlib));
+    if (zlib == NULL)
+        return NULL;
+    zlib->decompressor = NULL;
+    return zlib;
+}
+
+void bgen_zlib_destroy(struct bgen_zlib* zlib)
+{
+    if (zlib == NULL)
+        return;
+    if (zlib->decompressor != NULL)
+        libdeflate_free_decompressor(zlib->decompressor);
+    free(zlib);
+}
+
+static char const* result_string(enum libdeflate_result result)
+{
+    switch (result) {
+    case LIBDEFLATE_SUCCESS:
+        return "success";
+    case LIBDEFLATE_BAD_DATA:
+        return "bad data";
+    case LIBDEFLATE_SHORT_OUTPUT:
+        return "short output";
+    case LIBDEFLATE_INSUFFICIENT_SPACE:
+        return "insufficient space";
+    }
+    return "unknown error";
+}
+
+int bgen_unzlib(struct bgen_zlib* zlib, char const* src, size_t src_size, char** dst,
+                size_t* dst_size)
+{
+    struct libdeflate_decompressor* decompressor = NULL;
+
+    if (zlib == NULL || zlib->decompressor == NULL) {
+        if ((decompressor = libdeflate_alloc_decompressor()) == NULL) {
+            bgen_error("libdeflate failed to allocate a decompressor");
+            return 1;
+        }
+        if (zlib != NULL)
+            zlib->decompressor = decompressor;
+    } else {
+        decompressor = zlib->decompressor;
+    }
+
+    size_t                 actual = 0;
+    enum libdeflate_result result =
+        libdeflate_zlib_decompress(decompressor, src, src_size, *dst, *dst_size, &actual);
+
+    if (zlib == NULL)
+        libdeflate_free_decompressor(decompressor);
+
+    if (result != LIBDEFLATE_SUCCESS) {
+        bgen_error("libdeflate failed to inflate (%s)", result_string(result));
+        return 1;
+    }
+
+    *dst_size = actual;
+    return 0;
+}
+
+/* libdeflate has no way of stopping partway: zlib, which the library links against anyway,
+ * inflates the leading bytes instead. */
+int bgen_unzlib_head(struct bgen_zlib* zlib, char const* src, size_t src_size, char* dst,
+                     size_t* dst_size)
+{
+    (void)zlib;
+
+    if (src_size > UINT_MAX || *dst_size > UINT_MAX) {
+        bgen_error("zlib size overflow");
+        return 1;
+    }
+
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = (unsigned char const*)src;
+    strm.avail_in = (unsigned)src_size;
+
+    int e = inflateInit(&strm);
+    if (e != Z_OK) {
+        bgen_error("zlib failed to init (%s)", zError(e));
+        return 1;
+    }
+
+    strm.avail_out = (unsigned)*dst_size;
+    strm.next_out = (unsigned char*)dst;
+
+    e = inflate(&strm, Z_SYNC_FLUSH);
+    inflateEnd(&strm);
+    if (e != Z_OK && e != Z_STREAM_END) {
+        bgen_error("zlib failed to inflate (%s)", zError(e));
+        return 1;
+    }
+
+    *dst_size -= strm.avail_out;
+    return 0;
+}
@@ -2,122 +2,145 @@
 #include "zip/zlib.h"
 #include "report.h"
 #include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <zlib.h>
 
-int bgen_unzlib(char const* src, size_t src_size, char** dst, size_t* dst_size)
+struct bgen_zlib
 {
-    z_stream strm = {
-        .zalloc = Z_NULL,
-        .zfree = Z_NULL,
-        .opaque = Z_NULL,
-        .avail_in = 0,
-        .next_in = (unsigned char const*)src,
-    };
+    z_stream strm;
+    bool     ready; /* `inflateInit` has been called on `strm`. */
+};
 
-    int e = inflateInit(&strm);
+struct bgen_zlib* bgen_zlib_create(void)
+{
+    struct bgen_zlib* zlib = malloc(sizeof(struct bgen_zlib));
+    if (zlib == NULL)
+        return NULL;
+    zlib->strm.zalloc = Z_NULL;
+    zlib->strm.zfree = Z_NULL;
+    zlib->strm.opaque = Z_NULL;
+    zlib->strm.avail_in = 0;
+    zlib->strm.next_in = Z_NULL;
+    zlib->ready = false;
+    return zlib;
+}
+
+void bgen_zlib_destroy(struct bgen_zlib* zlib)
+{
+    if (zlib == NULL)
+        return;
+    if (zlib->ready)
+        inflateEnd(&zlib->strm);
+    free(zlib);
+}
+
+/* Get an inflate stream ready for a new input: the one owned by `zlib` is reset instead of
+ * being initialized again. `local` is used if `zlib` is `NULL`. */
+static z_stream* stream_begin(struct bgen_zlib* zlib, z_stream* local)
+{
+    z_stream* strm = zlib == NULL ? local : &zlib->strm;
+    int       e = Z_OK;
+
+    if (zlib != NULL && zlib->ready) {
+        e = inflateReset(strm);
+    } else {
+        strm->zalloc = Z_NULL;
+        strm->zfree = Z_NULL;
+        strm->opaque = Z_NULL;
+        strm->avail_in = 0;
+        strm->next_in = Z_NULL;
+        if ((e = inflateInit(strm)) == Z_OK && zlib != NULL)
+            zlib->ready = true;
+    }
 
     if (e != Z_OK) {
         bgen_error("zlib failed to init (%s)", zError(e));
-        goto err;
+        return NULL;
     }
+    return strm;
+}
+
+/* Release the stream unless it is owned by `zlib`. */
+static int stream_end(struct bgen_zlib* zlib, z_stream* strm)
+{
+    if (zlib != NULL)
+        return Z_OK;
+    return inflateEnd(strm);
+}
+
+int bgen_unzlib(struct bgen_zlib* zlib, char const* src, size_t src_size, char** dst,
+                size_t* dst_size)
+{
+    z_stream  local;
+    z_stream* strm = stream_begin(zlib, &local);
+    if (strm == NULL)
+        return 1;
+
+    strm->next_in = (unsigned char const*)src;
 
     if (src_size > UINT_MAX) {
         bgen_error("zlib src_size overflow");
         goto err;
     }
-    strm.avail_in = (unsigned)src_size;
+    strm->avail_in = (unsigned)src_size;
 
     if (*dst_size > UINT_MAX) {
         bgen_error("zlib *dst_size overflow");
         goto err;
     }
-    strm.avail_out = (unsigned)*dst_size;
-    strm.next_out = (unsigned char*)*dst;
+    strm->avail_out = (unsigned)*dst_size;
+    strm->next_out = (unsigned char*)*dst;
 
-    e = inflate(&strm, Z_FINISH);
+    int e = inflate(strm, Z_FINISH);
     if (e != Z_STREAM_END) {
         bgen_error("zlib failed to inflate (%s)", zError(e));
         goto err;
     }
+    *dst_size -= strm->avail_out;
 
-    if (inflateEnd(&strm) != Z_OK) {
+    if ((e = stream_end(zlib, strm)) != Z_OK) {
         bgen_error("zlib failed to inflateEnd (%s)", zError(e));
         return 1;
     }
     return 0;
 
 err:
-    inflateEnd(&strm);
+    stream_end(zlib, strm);
     return 1;
 }
 
-int bgen_unzlib_chunked(char const* src, size_t src_size, char** dst, size_t* dst_size)
+int bgen_unzlib_head(struct bgen_zlib* zlib, char const* src, size_t src_size, char* dst,
+                     size_t* dst_size)
 {
-    if (*dst_size > UINT_MAX) {
-        bgen_error("zlib *dst_size overflow");
+    if (src_size > UINT_MAX || *dst_size > UINT_MAX) {
+        bgen_error("zlib size overflow");
         return 1;
     }
 
-    unsigned       unused = (unsigned)*dst_size;
-    unsigned char* cdst = (unsigned char*)*dst;
-
-    z_stream strm = {
-        .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL, .avail_in = 0, .next_in = Z_NULL};
+    z_stream  local;
+    z_stream* strm = stream_begin(zlib, &local);
+    if (strm == NULL)
+        return 1;
 
-    int ret = inflateInit(&strm);
+    strm->next_in = (unsigned char const*)src;
+    strm->avail_in = (unsigned)src_size;
+    strm->avail_out = (unsigned)*dst_size;
+    strm->next_out = (unsigned char*)dst;
 
-    if (ret != Z_OK) {
-        bgen_error("zlib failed to uncompress (%s)", zError(ret));
-        goto err;
+    /* Inflation stops as soon as the output is full, leaving the rest of the input alone. */
+    int e = inflate(strm, Z_SYNC_FLUSH);
+    if (e != Z_OK && e != Z_STREAM_END) {
+        bgen_error("zlib failed to inflate (%s)", zError(e));
+        stream_end(zlib, strm);
+        return 1;
     }
+    *dst_size -= strm->avail_out;
 
-    strm.avail_in = (unsigned)src_size;
-    strm.next_in = (unsigned char const*)src;
-
-    while (1) {
-        strm.avail_out = unused;
-        strm.next_out = cdst;
-
-        ret = inflate(&strm, Z_NO_FLUSH);
-
-        if (ret == Z_NEED_DICT) {
-            ret = Z_DATA_ERROR;
-            goto err;
-        }
-
-        if (ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
-            goto err;
-
-        unsigned just_wrote = unused - strm.avail_out;
-
-        cdst += just_wrote;
-        unused -= just_wrote;
-
-        if (ret == Z_STREAM_END) {
-            *dst_size -= unused;
-            *dst = (char*)realloc(*dst, *dst_size);
-            break;
-        }
-
-        if (strm.avail_out == 0) {
-            if (unused > 0) {
-                bgen_error("zlib failed to uncompress (unknown error)");
-                goto err;
-            }
-
-            unused = (unsigned)*dst_size;
-            *dst_size += unused;
-            *dst = (char*)realloc(*dst, *dst_size);
-            cdst = (unsigned char*)*dst + unused;
-        }
+    if ((e = stream_end(zlib, strm)) != Z_OK) {
+        bgen_error("zlib failed to inflateEnd (%s)", zError(e));
+        return 1;
     }
-
-    inflateEnd(&strm);
     return 0;
-
-err:
-    inflateEnd(&strm);
-    return 1;
 }
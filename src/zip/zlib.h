@@ -3,7 +3,18 @@
 
 #include <stddef.h>
 
-int bgen_unzlib(char const* src, size_t src_size, char** dst, size_t* dst_size);
-int bgen_unzlib_chunked(char const* src, size_t src_size, char** dst, size_t* dst_size);
+/* Reusable zlib inflate stream. */
+struct bgen_zlib;
+
+struct bgen_zlib* bgen_zlib_create(void);
+void              bgen_zlib_destroy(struct bgen_zlib* zlib);
+/* Inflate `src` into the `*dst_size` bytes of `*dst` in a single pass, setting `*dst_size` to
+ * the number of bytes written. A temporary stream is used if `zlib` is `NULL`. */
+int bgen_unzlib(struct bgen_zlib* zlib, char const* src, size_t src_size, char** dst,
+                size_t* dst_size);
+/* Inflate no more than the first `*dst_size` bytes of `src` into `dst`, stopping there, and
+ * set `*dst_size` to the number of bytes written. */
+int bgen_unzlib_head(struct bgen_zlib* zlib, char const* src, size_t src_size, char* dst,
+                     size_t* dst_size);
 
 #endif
@@ -1,15 +1,94 @@
 #include "zip/zstd.h"
 #include "report.h"
+#include <stdlib.h>
 #include <zstd.h>
 
-int bgen_unzstd(char const* src, size_t src_size, void** dst, size_t* dst_size)
+struct bgen_zstd
 {
-    size_t dSize = ZSTD_decompress(*dst, *dst_size, src, src_size);
+    ZSTD_DCtx* dctx; /* Created on first use. */
+};
+
+struct bgen_zstd* bgen_zstd_create(void)
+{
+    struct bgen_zstd* zstd = malloc(sizeof(struct bgen_zstd));
+    if (zstd == NULL)
+        return NULL;
+    zstd->dctx = NULL;
+    return zstd;
+}
+
+void bgen_zstd_destroy(struct bgen_zstd* zstd)
+{
+    if (zstd == NULL)
+        return;
+    ZSTD_freeDCtx(zstd->dctx);
+    free(zstd);
+}
+
+int bgen_unzstd(struct bgen_zstd* zstd, char const* src, size_t src_size, void** dst,
+                size_t* dst_size)
+{
+    size_t dSize = 0;
+
+    if (zstd == NULL) {
+        dSize = ZSTD_decompress(*dst, *dst_size, src, src_size);
+    } else {
+        if (zstd->dctx == NULL && (zstd->dctx = ZSTD_createDCtx()) == NULL) {
+            bgen_error("could not create zstd context");
+            return 1;
+        }
+        /* A context is reset at the start of every frame, so it can be reused as is. */
+        dSize = ZSTD_decompressDCtx(zstd->dctx, *dst, *dst_size, src, src_size);
+    }
 
     if (ZSTD_isError(dSize)) {
         bgen_error("zstd decoding (%s)", ZSTD_getErrorName(dSize));
         return 1;
     }
 
+    *dst_size = dSize;
+    return 0;
+}
+
+int bgen_unzstd_head(struct bgen_zstd* zstd, char const* src, size_t src_size, char* dst,
+                     size_t* dst_size)
+{
+    ZSTD_DCtx* dctx = NULL;
+
+    if (zstd == NULL) {
+        dctx = ZSTD_createDCtx();
+    } else {
+        if (zstd->dctx == NULL)
+            zstd->dctx = ZSTD_createDCtx();
+        dctx = zstd->dctx;
+    }
+    if (dctx == NULL) {
+        bgen_error("could not create zstd context");
+        return 1;
+    }
+
+    /* Drop whatever is left of a frame decompressed partway. */
+    size_t         ret = ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+    ZSTD_inBuffer  in = {src, src_size, 0};
+    ZSTD_outBuffer out = {dst, *dst_size, 0};
+
+    /* Blocks are decoded one by one: those past the requested bytes are never touched. */
+    while (!ZSTD_isError(ret) && out.pos < out.size) {
+        size_t const consumed = in.pos;
+        size_t const produced = out.pos;
+        ret = ZSTD_decompressStream(dctx, &out, &in);
+        if (ret == 0 || (in.pos == consumed && out.pos == produced))
+            break;
+    }
+
+    if (zstd == NULL)
+        ZSTD_freeDCtx(dctx);
+
+    if (ZSTD_isError(ret)) {
+        bgen_error("zstd decoding (%s)", ZSTD_getErrorName(ret));
+        return 1;
+    }
+
+    *dst_size = out.pos;
     return 0;
 }
@@ -3,6 +3,18 @@
 
 #include <stddef.h>
 
-int bgen_unzstd(char const* src, size_t src_size, void** dst, size_t* dst_size);
+/* Reusable zstd decompression context. */
+struct bgen_zstd;
+
+struct bgen_zstd* bgen_zstd_create(void);
+void              bgen_zstd_destroy(struct bgen_zstd* zstd);
+/* Decompress `src` into `*dst`, of `*dst_size` bytes, and set `*dst_size` to the number of
+ * bytes written. A temporary context is used if `zstd` is `NULL`. */
+int bgen_unzstd(struct bgen_zstd* zstd, char const* src, size_t src_size, void** dst,
+                size_t* dst_size);
+/* Decompress no more than the first `*dst_size` bytes of `src` into `dst`, stopping there,
+ * and set `*dst_size` to the number of bytes written. */
+int bgen_unzstd_head(struct bgen_zstd* zstd, char const* src, size_t src_size, char* dst,
+                     size_t* dst_size);
 
 #endif
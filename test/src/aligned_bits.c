@@ -0,0 +1,123 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_aligned_bits(char const* filepath, char const* metafile_filepath, unsigned nbits);
+void test_short_block(int mmap);
+
+int main(void)
+{
+    test_aligned_bits(TEST_DATADIR "example.8bits.bgen",
+                      "aligned_bits.tmp/example.8bits.bgen.metafile", 8);
+    test_aligned_bits(TEST_DATADIR "example.16bits.bgen",
+                      "aligned_bits.tmp/example.16bits.bgen.metafile", 16);
+    test_short_block(0);
+    test_short_block(1);
+    return cass_status();
+}
+
+/* Both files hold the same variants as example.14bits.bgen, quantized to fewer bits. */
+void test_aligned_bits(char const* filepath, char const* metafile_filepath, unsigned nbits)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    struct bgen_file* ref = bgen_file_open(TEST_DATADIR "example.14bits.bgen");
+    cass_cond(bgen != NULL);
+    cass_cond(ref != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    struct bgen_metafile* rmf =
+        bgen_metafile_create(ref, "aligned_bits.tmp/example.14bits.bgen.metafile", 1, 0);
+    cass_cond(mf != NULL);
+    cass_cond(rmf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    struct bgen_partition const* rpartition = bgen_metafile_read_partition(rmf, 0);
+    cass_equal_int(bgen_partition_nvariants(partition), bgen_partition_nvariants(rpartition));
+
+    uint32_t nsamples = bgen_file_nsamples(bgen);
+    double   denom = (double)((1u << nbits) - 1);
+    double*  probs = malloc(nsamples * 3 * sizeof(double));
+    float*   probs32 = malloc(nsamples * 3 * sizeof(float));
+    double*  rprobs = malloc(nsamples * 3 * sizeof(double));
+
+    for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i) {
+        struct bgen_variant const* vm = bgen_partition_get_variant(partition, i);
+        struct bgen_variant const* rvm = bgen_partition_get_variant(rpartition, i);
+        struct bgen_genotype*      vg = bgen_file_open_genotype(bgen, vm->genotype_offset);
+        struct bgen_genotype*      rvg = bgen_file_open_genotype(ref, rvm->genotype_offset);
+        cass_cond(vg != NULL);
+        cass_cond(rvg != NULL);
+        cass_equal_int(bgen_genotype_ncombs(vg), 3);
+
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read32(vg, probs32), 0);
+        cass_equal_int(bgen_genotype_read(rvg, rprobs), 0);
+
+        for (uint32_t s = 0; s < nsamples; ++s) {
+            cass_equal_int(bgen_genotype_missing(vg, s), bgen_genotype_missing(rvg, s));
+            for (unsigned c = 0; c < 3; ++c) {
+                double p = probs[s * 3 + c];
+                if (bgen_genotype_missing(vg, s)) {
+                    cass_cond(isnan(p) && isnan(probs32[s * 3 + c]));
+                    continue;
+                }
+                cass_cond(fabs(p * denom - round(p * denom)) < 1e-6);
+                cass_cond(fabs(p - rprobs[s * 3 + c]) <= 1 / denom + 1e-9);
+                cass_cond(fabs(p - probs32[s * 3 + c]) < 1e-6);
+            }
+        }
+
+        bgen_genotype_close(vg);
+        bgen_genotype_close(rvg);
+    }
+
+    free(probs);
+    free(probs32);
+    free(rprobs);
+    bgen_partition_destroy(partition);
+    bgen_partition_destroy(rpartition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    cass_equal_int(bgen_metafile_close(rmf), 0);
+    bgen_file_close(ref);
+    bgen_file_close(bgen);
+}
+
+/* Uncompressed, layout 2: a single biallelic diploid variant of four samples, whose genotype
+ * block holds the 8-bit probabilities of the first sample only. */
+static unsigned char const short_block[] = {
+    20, 0, 0, 0,                                    /* offset */
+    20, 0, 0, 0, 1, 0, 0, 0, 4, 0, 0, 0,            /* header length, variants, samples */
+    'b', 'g', 'e', 'n', 8, 0, 0, 0,                 /* magic number, flags */
+    2, 0, 'v', '1', 2, 0, 'r', '1', 1, 0, '1',      /* id, rsid, chrom */
+    100, 0, 0, 0, 2, 0,                             /* position, alleles */
+    1, 0, 0, 0, 'A', 1, 0, 0, 0, 'G',               /* allele ids */
+    16, 0, 0, 0,                                    /* genotype block length */
+    4, 0, 0, 0, 2, 0, 2, 2, 2, 2, 2, 2, 0, 8, 255, 0 /* genotype block */
+};
+
+/* A block too short for its samples is never read past its end. */
+void test_short_block(int mmap)
+{
+    char const* filepath = "aligned_bits.tmp/short_block.bgen";
+    FILE*       stream = fopen(filepath, "wb");
+    cass_cond(stream != NULL);
+    cass_cond(fwrite(short_block, sizeof(short_block), 1, stream) == 1);
+    fclose(stream);
+
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    cass_equal_int(bgen_file_nsamples(bgen), 4);
+
+    struct bgen_genotype* vg = bgen_file_open_genotype(bgen, sizeof(short_block) - 20);
+    cass_cond(vg != NULL);
+    cass_equal_int(bgen_genotype_ncombs(vg), 3);
+
+    double probs[4 * 3];
+    cass_equal_int(bgen_genotype_read(vg, probs), 0);
+    cass_cond(probs[0] == 1.0 && probs[1] == 0.0 && probs[2] == 0.0);
+
+    bgen_genotype_close(vg);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,102 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <stdlib.h>
+
+/* Allocations are counted by interposing the glibc allocator, which sanitizers replace. */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define COUNT_ALLOCATIONS
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static unsigned long nallocations = 0;
+
+void* malloc(size_t size)
+{
+    ++nallocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    ++nallocations;
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    ++nallocations;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+void test_allocations(char const* filepath, char const* metafile_filepath, int mmap);
+
+int main(void)
+{
+#if defined(COUNT_ALLOCATIONS)
+    test_allocations(TEST_DATADIR "example.14bits.bgen",
+                     "allocations.tmp/example.14bits.bgen.metafile", 0);
+    test_allocations(TEST_DATADIR "example.14bits.zstd.bgen",
+                     "allocations.tmp/example.14bits.zstd.bgen.metafile", 1);
+    test_allocations(TEST_DATADIR "complex.23bits.bgen",
+                     "allocations.tmp/complex.23bits.bgen.metafile", 0);
+#endif
+    return cass_status();
+}
+
+#if defined(COUNT_ALLOCATIONS)
+
+#define NVARIANTS 10000
+
+static void scan(struct bgen_reader* reader, uint64_t const* offsets, uint32_t nvariants,
+                 double* probs, uint32_t const* samples, uint32_t nselected)
+{
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_reader_open_genotype(reader, offsets[v]);
+        cass_cond(vg != NULL);
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read_subset(vg, samples, nselected, probs), 0);
+        bgen_genotype_close(vg);
+    }
+}
+
+void test_allocations(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    unsigned ncombs = 0;
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        if (bgen_genotype_ncombs(vg) > ncombs)
+            ncombs = bgen_genotype_ncombs(vg);
+        bgen_genotype_close(vg);
+    }
+
+    double*  probs = malloc((size_t)nsamples * ncombs * sizeof(double));
+    uint32_t samples[] = {nsamples - 1, 0};
+
+    struct bgen_reader* reader = bgen_reader_create(bgen);
+    cass_cond(reader != NULL);
+
+    /* The first pass sizes the buffers; later ones must not allocate at all. */
+    scan(reader, offsets, nvariants, probs, samples, 2);
+    unsigned long before = nallocations;
+    for (uint32_t n = 0; n < NVARIANTS; n += nvariants)
+        scan(reader, offsets, nvariants, probs, samples, 2);
+    cass_equal_uint64(nallocations - before, 0);
+
+    bgen_reader_destroy(reader);
+    free(probs);
+    free(offsets);
+    bgen_file_close(bgen);
+}
+
+#endif
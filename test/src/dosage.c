@@ -0,0 +1,83 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_dosage(char const* filepath, char const* metafile_filepath);
+
+int main(void)
+{
+    test_dosage(TEST_DATADIR "example.14bits.bgen", "dosage.tmp/example.14bits.bgen.metafile");
+    test_dosage(TEST_DATADIR "example.8bits.bgen", "dosage.tmp/example.8bits.bgen.metafile");
+    test_dosage(TEST_DATADIR "complex.23bits.bgen", "dosage.tmp/complex.23bits.bgen.metafile");
+    test_dosage(TEST_DATADIR "haplotypes.bgen", "dosage.tmp/haplotypes.bgen.metafile");
+    return cass_status();
+}
+
+/* Dosage of the second allele computed from the genotype probabilities. */
+static double expected_dosage(struct bgen_genotype* vg, double const* probs, uint32_t sample)
+{
+    if (bgen_genotype_missing(vg, sample))
+        return NAN;
+
+    unsigned      ploidy = bgen_genotype_ploidy(vg, sample);
+    double const* p = probs + sample * bgen_genotype_ncombs(vg);
+    double        dosage = 0;
+    for (unsigned k = 0; k < (bgen_genotype_phased(vg) ? ploidy : ploidy + 1); ++k) {
+        if (bgen_genotype_phased(vg))
+            dosage += p[2 * k + 1];
+        else
+            dosage += k * p[k];
+    }
+    return dosage;
+}
+
+void test_dosage(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t                     nsamples = bgen_file_nsamples(bgen);
+    double*                      dosages = malloc(nsamples * sizeof(double));
+    float*                       dosages32 = malloc(nsamples * sizeof(float));
+
+    for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i) {
+        struct bgen_variant const* vm = bgen_partition_get_variant(partition, i);
+        struct bgen_genotype*      vg = bgen_file_open_genotype(bgen, vm->genotype_offset);
+        cass_cond(vg != NULL);
+
+        if (bgen_genotype_nalleles(vg) != 2) {
+            cass_equal_int(bgen_genotype_read_dosage(vg, dosages), 1);
+            bgen_genotype_close(vg);
+            continue;
+        }
+
+        double* probs = malloc(nsamples * bgen_genotype_ncombs(vg) * sizeof(double));
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read_dosage(vg, dosages), 0);
+        cass_equal_int(bgen_genotype_read_dosage32(vg, dosages32), 0);
+
+        for (uint32_t s = 0; s < nsamples; ++s) {
+            double dosage = expected_dosage(vg, probs, s);
+            if (isnan(dosage)) {
+                cass_cond(isnan(dosages[s]));
+                cass_cond(isnan(dosages32[s]));
+            } else {
+                cass_close(dosages[s], dosage);
+                cass_close2(dosages32[s], dosage, 1e-6, 1e-6);
+            }
+        }
+
+        free(probs);
+        bgen_genotype_close(vg);
+    }
+
+    free(dosages);
+    free(dosages32);
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,114 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_hardcalls(char const* filepath, char const* metafile_filepath);
+
+int main(void)
+{
+    test_hardcalls(TEST_DATADIR "example.14bits.bgen",
+                   "hardcalls.tmp/example.14bits.bgen.metafile");
+    test_hardcalls(TEST_DATADIR "example.8bits.bgen",
+                   "hardcalls.tmp/example.8bits.bgen.metafile");
+    test_hardcalls(TEST_DATADIR "complex.23bits.bgen",
+                   "hardcalls.tmp/complex.23bits.bgen.metafile");
+    test_hardcalls(TEST_DATADIR "haplotypes.bgen", "hardcalls.tmp/haplotypes.bgen.metafile");
+    return cass_status();
+}
+
+/* Probability of each number of copies of the second allele. */
+static unsigned allele_counts(struct bgen_genotype* vg, double const* probs, uint32_t sample,
+                              double* dist)
+{
+    unsigned      ploidy = bgen_genotype_ploidy(vg, sample);
+    double const* p = probs + sample * bgen_genotype_ncombs(vg);
+
+    if (!bgen_genotype_phased(vg)) {
+        for (unsigned k = 0; k <= ploidy; ++k)
+            dist[k] = p[k];
+        return ploidy;
+    }
+
+    dist[0] = 1;
+    for (unsigned h = 0; h < ploidy; ++h) {
+        double q = p[2 * h + 1];
+        dist[h + 1] = 0;
+        for (unsigned k = h + 1; k > 0; --k)
+            dist[k] = dist[k] * (1 - q) + dist[k - 1] * q;
+        dist[0] *= 1 - q;
+    }
+    return ploidy;
+}
+
+static void check_sample(struct bgen_genotype* vg, double const* probs, uint32_t sample,
+                         int8_t const* calls, double threshold, uint8_t dosage8)
+{
+    if (bgen_genotype_missing(vg, sample)) {
+        cass_equal_int(calls[sample], -1);
+        cass_equal_int(dosage8, 255);
+        return;
+    }
+
+    double   dist[128];
+    unsigned ploidy = allele_counts(vg, probs, sample, dist);
+    unsigned best = 0;
+    double   dosage = 0;
+    for (unsigned k = 0; k <= ploidy; ++k) {
+        if (dist[k] > dist[best])
+            best = k;
+        dosage += k * dist[k];
+    }
+
+    if (fabs(dist[best] - threshold) > 1e-6)
+        cass_equal_int(calls[sample], dist[best] >= threshold ? (int)best : -1);
+
+    double scaled = dosage / ploidy * 254;
+    cass_cond(fabs(dosage8 - scaled) <= 0.5 + 1e-6);
+}
+
+void test_hardcalls(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t                     nsamples = bgen_file_nsamples(bgen);
+    int8_t*                      calls = malloc(nsamples * sizeof(int8_t));
+    uint8_t*                     dosages = malloc(nsamples * sizeof(uint8_t));
+    double const                 thresholds[] = {0.0, 0.6, 0.9};
+
+    for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i) {
+        struct bgen_variant const* vm = bgen_partition_get_variant(partition, i);
+        struct bgen_genotype*      vg = bgen_file_open_genotype(bgen, vm->genotype_offset);
+        cass_cond(vg != NULL);
+
+        if (bgen_genotype_nalleles(vg) != 2) {
+            cass_equal_int(bgen_genotype_read_hardcalls(vg, calls, 0.9), 1);
+            cass_equal_int(bgen_genotype_read_dosage8(vg, dosages), 1);
+            bgen_genotype_close(vg);
+            continue;
+        }
+
+        double* probs = malloc(nsamples * bgen_genotype_ncombs(vg) * sizeof(double));
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read_dosage8(vg, dosages), 0);
+
+        for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); ++t) {
+            cass_equal_int(bgen_genotype_read_hardcalls(vg, calls, thresholds[t]), 0);
+            for (uint32_t s = 0; s < nsamples; ++s)
+                check_sample(vg, probs, s, calls, thresholds[t], dosages[s]);
+        }
+
+        free(probs);
+        bgen_genotype_close(vg);
+    }
+
+    free(calls);
+    free(dosages);
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
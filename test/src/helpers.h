@@ -0,0 +1,35 @@
+#ifndef HELPERS_H
+#define HELPERS_H
+
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* Probabilities are decoded alike when equal, or both missing. */
+inline static int same_probability(double a, double b)
+{
+    return a == b || (isnan(a) && isnan(b));
+}
+
+/* Genotype offsets of every variant, from a metafile of a single partition created for the
+ * occasion. The returned array is to be freed by the caller. */
+inline static uint64_t* read_offsets(struct bgen_file* bgen, char const* metafile_filepath,
+                                     uint32_t* nvariants)
+{
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    *nvariants = bgen_partition_nvariants(partition);
+
+    uint64_t* offsets = malloc(*nvariants * sizeof(uint64_t));
+    for (uint32_t i = 0; i < *nvariants; ++i)
+        offsets[i] = bgen_partition_get_variant(partition, i)->genotype_offset;
+
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    return offsets;
+}
+
+#endif
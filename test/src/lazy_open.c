@@ -0,0 +1,186 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_lazy_open(char const* filepath, char const* metafile_filepath, int mmap);
+void test_layout1(void);
+
+int main(void)
+{
+    test_lazy_open(TEST_DATADIR "example.14bits.bgen",
+                   "lazy_open.tmp/example.14bits.bgen.metafile", 0);
+    test_lazy_open(TEST_DATADIR "example.14bits.bgen",
+                   "lazy_open.tmp/example.14bits.bgen.metafile", 1);
+    test_lazy_open(TEST_DATADIR "example.14bits.zstd.bgen",
+                   "lazy_open.tmp/example.14bits.zstd.bgen.metafile", 0);
+    test_lazy_open(TEST_DATADIR "example.14bits.zstd.bgen",
+                   "lazy_open.tmp/example.14bits.zstd.bgen.metafile", 1);
+    test_lazy_open(TEST_DATADIR "complex.23bits.bgen",
+                   "lazy_open.tmp/complex.23bits.bgen.metafile", 0);
+    test_lazy_open(TEST_DATADIR "complex.23bits.zstd.bgen",
+                   "lazy_open.tmp/complex.23bits.zstd.bgen.metafile", 0);
+    test_lazy_open(TEST_DATADIR "complex.23bits.uncompressed.bgen",
+                   "lazy_open.tmp/complex.23bits.uncompressed.bgen.metafile", 0);
+    test_lazy_open(TEST_DATADIR "haplotypes.bgen", "lazy_open.tmp/haplotypes.bgen.metafile",
+                   0);
+    test_layout1();
+    return cass_status();
+}
+
+void test_lazy_open(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        struct bgen_genotype* lazy = bgen_file_open_genotype_lazy(bgen, offsets[i]);
+        struct bgen_genotype* expected = bgen_file_open_genotype(bgen, offsets[i]);
+        cass_cond(lazy != NULL);
+        cass_cond(expected != NULL);
+
+        /* Header fields are there before any probability is read. */
+        unsigned ncombs = bgen_genotype_ncombs(expected);
+        cass_equal_int(bgen_genotype_ncombs(lazy), ncombs);
+        cass_equal_int(bgen_genotype_nalleles(lazy), bgen_genotype_nalleles(expected));
+        cass_equal_int(bgen_genotype_min_ploidy(lazy), bgen_genotype_min_ploidy(expected));
+        cass_equal_int(bgen_genotype_max_ploidy(lazy), bgen_genotype_max_ploidy(expected));
+        cass_equal_int(bgen_genotype_phased(lazy), bgen_genotype_phased(expected));
+        for (uint32_t j = 0; j < nsamples; ++j) {
+            cass_equal_int(bgen_genotype_ploidy(lazy, j), bgen_genotype_ploidy(expected, j));
+            cass_equal_int(bgen_genotype_missing(lazy, j), bgen_genotype_missing(expected, j));
+        }
+
+        size_t  n = (size_t)nsamples * ncombs;
+        double* probs = malloc(n * sizeof(double));
+        double* eprobs = malloc(n * sizeof(double));
+        cass_equal_int(bgen_genotype_read(expected, eprobs), 0);
+
+        /* Every other variant is left unread. */
+        if (i % 2 == 0) {
+            cass_equal_int(bgen_genotype_read(lazy, probs), 0);
+            for (size_t j = 0; j < n; ++j)
+                cass_cond(same_probability(probs[j], eprobs[j]));
+
+            /* Decompressed once, read as many times as needed. */
+            cass_equal_int(bgen_genotype_read(lazy, probs), 0);
+            for (size_t j = 0; j < n; ++j)
+                cass_cond(same_probability(probs[j], eprobs[j]));
+
+            for (uint32_t j = 0; j < nsamples; ++j)
+                cass_equal_int(bgen_genotype_missing(lazy, j),
+                               bgen_genotype_missing(expected, j));
+        }
+
+        free(eprobs);
+        free(probs);
+        bgen_genotype_close(expected);
+        bgen_genotype_close(lazy);
+    }
+
+    /* Dosages are decompressed on demand as well. */
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        struct bgen_genotype* lazy = bgen_file_open_genotype_lazy(bgen, offsets[i]);
+        struct bgen_genotype* expected = bgen_file_open_genotype(bgen, offsets[i]);
+        cass_cond(lazy != NULL);
+        cass_cond(expected != NULL);
+
+        if (bgen_genotype_nalleles(expected) == 2) {
+            double* dosages = malloc(nsamples * sizeof(double));
+            double* edosages = malloc(nsamples * sizeof(double));
+            cass_equal_int(bgen_genotype_read_dosage(lazy, dosages), 0);
+            cass_equal_int(bgen_genotype_read_dosage(expected, edosages), 0);
+            for (uint32_t j = 0; j < nsamples; ++j)
+                cass_cond(same_probability(dosages[j], edosages[j]));
+            free(edosages);
+            free(dosages);
+        }
+
+        bgen_genotype_close(expected);
+        bgen_genotype_close(lazy);
+    }
+
+    cass_cond(bgen_file_open_genotype_lazy(bgen, UINT64_MAX / 2) == NULL);
+
+    free(offsets);
+    bgen_file_close(bgen);
+}
+
+/* Metafiles are not created for layout 1: the variant headers are walked instead. */
+static uint64_t* layout1_offsets(char const* filepath, uint32_t nvariants)
+{
+    FILE* fp = fopen(filepath, "rb");
+    cass_cond(fp != NULL);
+
+    uint32_t offset = 0;
+    cass_cond(fread(&offset, sizeof(offset), 1, fp) == 1);
+    cass_equal_int(fseek(fp, (long)offset + 4, SEEK_SET), 0);
+
+    uint64_t* offsets = malloc(nvariants * sizeof(uint64_t));
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        uint32_t length = 0;
+        /* Number of samples, and position after the identifier and chromosome. */
+        cass_equal_int(fseek(fp, 4, SEEK_CUR), 0);
+        for (int j = 0; j < 3; ++j) {
+            uint16_t len = 0;
+            cass_cond(fread(&len, sizeof(len), 1, fp) == 1);
+            cass_equal_int(fseek(fp, len, SEEK_CUR), 0);
+        }
+        cass_equal_int(fseek(fp, 4, SEEK_CUR), 0);
+        for (int j = 0; j < 2; ++j) {
+            cass_cond(fread(&length, sizeof(length), 1, fp) == 1);
+            cass_equal_int(fseek(fp, (long)length, SEEK_CUR), 0);
+        }
+        offsets[i] = (uint64_t)ftell(fp);
+        cass_cond(fread(&length, sizeof(length), 1, fp) == 1);
+        cass_equal_int(fseek(fp, (long)length, SEEK_CUR), 0);
+    }
+
+    fclose(fp);
+    return offsets;
+}
+
+/* Layout 1 samples are diploid, and missing when their probabilities are. */
+void test_layout1(void)
+{
+    char const*       filepath = TEST_DATADIR "example.v11.bgen";
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = bgen_file_nvariants(bgen);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+    uint64_t* offsets = layout1_offsets(filepath, nvariants);
+    double*   probs = malloc((size_t)nsamples * 3 * sizeof(double));
+    uint32_t  nmissing = 0;
+
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        struct bgen_genotype* lazy = bgen_file_open_genotype_lazy(bgen, offsets[i]);
+        struct bgen_genotype* genotype = bgen_file_open_genotype(bgen, offsets[i]);
+        cass_cond(lazy != NULL);
+        cass_cond(genotype != NULL);
+
+        cass_equal_int(bgen_genotype_read(genotype, probs), 0);
+        for (uint32_t j = 0; j < nsamples; ++j) {
+            bool const missing = isnan(probs[j * 3]);
+            nmissing += missing;
+            cass_equal_int(bgen_genotype_ploidy(lazy, j), 2);
+            cass_equal_int(bgen_genotype_ploidy(genotype, j), 2);
+            cass_equal_int(bgen_genotype_missing(lazy, j), missing);
+            cass_equal_int(bgen_genotype_missing(genotype, j), missing);
+        }
+
+        bgen_genotype_close(genotype);
+        bgen_genotype_close(lazy);
+    }
+    cass_cond(nmissing > 0);
+
+    free(probs);
+    free(offsets);
+    bgen_file_close(bgen);
+}
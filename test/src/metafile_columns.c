@@ -0,0 +1,161 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <string.h>
+
+void test_against_04(void);
+void test_partition_lifetime(void);
+void test_columns(char const* filepath, char const* metafile_filepath, uint32_t npartitions);
+
+int main(void)
+{
+    test_against_04();
+    test_partition_lifetime();
+    test_columns(TEST_DATADIR "example.14bits.bgen",
+                 "metafile_columns.tmp/example.14bits.bgen.metafile", 7);
+    test_columns(TEST_DATADIR "complex.23bits.bgen",
+                 "metafile_columns.tmp/complex.23bits.bgen.metafile", 2);
+    test_columns(TEST_DATADIR "haplotypes.bgen",
+                 "metafile_columns.tmp/haplotypes.bgen.metafile", 1);
+    test_columns(TEST_DATADIR "roundtrip1.bgen",
+                 "metafile_columns.tmp/roundtrip1.bgen.metafile", 100);
+    return cass_status();
+}
+
+static int same_string(struct bgen_string a, struct bgen_string const* b)
+{
+    return a.length == b->length && (a.length == 0 || memcmp(a.data, b->data, a.length) == 0);
+}
+
+static void check_variant(struct bgen_metafile const* mf, uint32_t index,
+                          struct bgen_variant const* v)
+{
+    cass_cond(bgen_metafile_genotype_offset(mf, index) == v->genotype_offset);
+    cass_cond(bgen_metafile_position(mf, index) == v->position);
+    cass_equal_int(bgen_metafile_nalleles(mf, index), v->nalleles);
+    cass_cond(same_string(bgen_metafile_id(mf, index), v->id));
+    cass_cond(same_string(bgen_metafile_rsid(mf, index), v->rsid));
+    cass_cond(same_string(bgen_metafile_chrom(mf, index), v->chrom));
+    for (uint16_t j = 0; j < v->nalleles; ++j)
+        cass_cond(same_string(bgen_metafile_allele_id(mf, index, j), v->allele_ids[j]));
+    cass_cond(bgen_metafile_allele_id(mf, index, v->nalleles).length == 0);
+}
+
+/* Variants of a version 05 metafile match those of the version 04 one shipped with the
+ * tests. */
+void test_against_04(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "example.14bits.bgen");
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf04 =
+        bgen_metafile_open(TEST_DATADIR "example.14bits.bgen.metafile");
+    cass_cond(mf04 != NULL);
+    cass_equal_int(bgen_metafile_version(mf04), 4);
+    cass_cond(bgen_metafile_genotype_offset(mf04, 0) == 0);
+
+    struct bgen_metafile* mf05 = bgen_metafile_create(
+        bgen, "metafile_columns.tmp/example.14bits.bgen.metafile05", 3, 0);
+    cass_cond(mf05 != NULL);
+    cass_equal_int(bgen_metafile_version(mf05), 5);
+    cass_equal_int(bgen_metafile_nvariants(mf05), bgen_metafile_nvariants(mf04));
+    cass_equal_int(bgen_metafile_npartitions(mf05), 3);
+
+    uint32_t index = 0;
+    for (uint32_t p = 0; p < bgen_metafile_npartitions(mf04); ++p) {
+        struct bgen_partition const* partition = bgen_metafile_read_partition(mf04, p);
+        cass_cond(partition != NULL);
+        for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i)
+            check_variant(mf05, index++, bgen_partition_get_variant(partition, i));
+        bgen_partition_destroy(partition);
+    }
+    cass_equal_int(index, bgen_metafile_nvariants(mf05));
+
+    cass_equal_int(bgen_metafile_close(mf05), 0);
+    cass_equal_int(bgen_metafile_close(mf04), 0);
+    bgen_file_close(bgen);
+}
+
+void test_columns(char const* filepath, char const* metafile_filepath, uint32_t npartitions)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* created =
+        bgen_metafile_create(bgen, metafile_filepath, npartitions, 0);
+    cass_cond(created != NULL);
+    cass_equal_int(bgen_metafile_close(created), 0);
+
+    struct bgen_metafile* mf = bgen_metafile_open(metafile_filepath);
+    cass_cond(mf != NULL);
+    cass_equal_int(bgen_metafile_version(mf), 5);
+    cass_equal_int(bgen_metafile_nvariants(mf), bgen_file_nvariants(bgen));
+    cass_equal_int(bgen_metafile_npartitions(mf), npartitions);
+
+    uint32_t index = 0;
+    for (uint32_t p = 0; p < npartitions; ++p) {
+        struct bgen_partition const* partition = bgen_metafile_read_partition(mf, p);
+        cass_cond(partition != NULL);
+        for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i) {
+            struct bgen_variant const* v = bgen_partition_get_variant(partition, i);
+            check_variant(mf, index++, v);
+
+            struct bgen_genotype* genotype =
+                bgen_file_open_genotype(bgen, v->genotype_offset);
+            cass_cond(genotype != NULL);
+            cass_equal_int(bgen_genotype_nalleles(genotype), v->nalleles);
+            bgen_genotype_close(genotype);
+        }
+        bgen_partition_destroy(partition);
+    }
+    cass_equal_int(index, bgen_metafile_nvariants(mf));
+
+    /* Out of range. */
+    uint32_t const n = bgen_metafile_nvariants(mf);
+    cass_cond(bgen_metafile_genotype_offset(mf, n) == 0);
+    cass_cond(bgen_metafile_position(mf, n) == 0);
+    cass_equal_int(bgen_metafile_nalleles(mf, n), 0);
+    cass_cond(bgen_metafile_id(mf, n).length == 0);
+    cass_cond(bgen_metafile_read_partition(mf, npartitions) == NULL);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
+
+/* Partitions hold their own copy of the strings, and outlive the metafile. */
+void test_partition_lifetime(void)
+{
+    char const* filepaths[] = {TEST_DATADIR "example.14bits.bgen.metafile",
+                               "metafile_columns.tmp/example.14bits.bgen.metafile05"};
+
+    for (int i = 0; i < 2; ++i) {
+        struct bgen_metafile* mf = bgen_metafile_open(filepaths[i]);
+        cass_cond(mf != NULL);
+        uint32_t const               nvariants = bgen_metafile_nvariants(mf);
+        struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+        cass_cond(partition != NULL);
+        cass_equal_int(bgen_metafile_close(mf), 0);
+
+        struct bgen_variant const* first = bgen_partition_get_variant(partition, 0);
+        cass_cond(same_string(BGEN_STRING("SNPID_2"), first->id));
+        cass_cond(same_string(BGEN_STRING("RSID_2"), first->rsid));
+        cass_cond(same_string(BGEN_STRING("01"), first->chrom));
+        cass_equal_int(first->nalleles, 2);
+        cass_cond(same_string(BGEN_STRING("A"), first->allele_ids[0]));
+        cass_cond(same_string(BGEN_STRING("G"), first->allele_ids[1]));
+        cass_cond(bgen_partition_nvariants(partition) <= nvariants);
+
+        /* Chromosome names and allele ids are interned. */
+        for (uint32_t j = 1; j < bgen_partition_nvariants(partition); ++j) {
+            struct bgen_variant const* v = bgen_partition_get_variant(partition, j);
+            cass_cond(v->chrom == first->chrom);
+            for (uint16_t a = 0; a < v->nalleles; ++a) {
+                for (uint16_t b = 0; b < first->nalleles; ++b) {
+                    int const same = same_string(*v->allele_ids[a], first->allele_ids[b]);
+                    cass_equal_int(v->allele_ids[a] == first->allele_ids[b], same);
+                }
+            }
+        }
+
+        bgen_partition_destroy(partition);
+    }
+}
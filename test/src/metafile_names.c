@@ -0,0 +1,110 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <stdlib.h>
+#include <string.h>
+
+void test_names(char const* filepath, char const* metafile_filepath, unsigned nthreads);
+void test_no_name_index(void);
+
+int main(void)
+{
+    test_names(TEST_DATADIR "example.14bits.bgen",
+               "metafile_names.tmp/example.14bits.bgen.metafile", 0);
+    test_names(TEST_DATADIR "example.14bits.bgen",
+               "metafile_names.tmp/example.14bits.bgen.metafile", 4);
+    test_names(TEST_DATADIR "complex.23bits.bgen",
+               "metafile_names.tmp/complex.23bits.bgen.metafile", 0);
+    test_names(TEST_DATADIR "haplotypes.bgen", "metafile_names.tmp/haplotypes.bgen.metafile",
+               0);
+    test_names(TEST_DATADIR "roundtrip1.bgen", "metafile_names.tmp/roundtrip1.bgen.metafile",
+               2);
+    test_names(TEST_DATADIR "zero_len_chrom_id.bgen",
+               "metafile_names.tmp/zero_len_chrom_id.bgen.metafile", 0);
+    test_no_name_index();
+    return cass_status();
+}
+
+static char* copy_string(struct bgen_string str)
+{
+    char* s = malloc(str.length + 1);
+    if (str.length > 0)
+        memcpy(s, str.data, str.length);
+    s[str.length] = '\0';
+    return s;
+}
+
+static int same_string(struct bgen_string a, struct bgen_string b)
+{
+    return a.length == b.length && (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
+}
+
+static struct bgen_string name_of(struct bgen_metafile const* mf, uint32_t index, int rsid)
+{
+    return rsid ? bgen_metafile_rsid(mf, index) : bgen_metafile_id(mf, index);
+}
+
+/* Every name is found at the first variant having it. */
+static void check_lookup(struct bgen_metafile const* mf, int rsid)
+{
+    uint32_t const n = bgen_metafile_nvariants(mf);
+    char**         names = malloc(sizeof(char*) * (n + 1));
+    uint32_t*      indices = malloc(sizeof(uint32_t) * (n + 1));
+
+    for (uint32_t i = 0; i < n; ++i)
+        names[i] = copy_string(name_of(mf, i, rsid));
+    names[n] = "no such name";
+
+    char const* const* queries = (char const* const*)names;
+    int const          error = rsid ? bgen_metafile_lookup_rsids(mf, queries, n + 1, indices)
+                           : bgen_metafile_lookup_ids(mf, queries, n + 1, indices);
+    cass_equal_int(error, 0);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t first = 0;
+        while (!same_string(name_of(mf, first, rsid), name_of(mf, i, rsid)))
+            ++first;
+        cass_equal_int(indices[i], first);
+        free(names[i]);
+    }
+    cass_cond(indices[n] == BGEN_METAFILE_NOT_FOUND);
+
+    free(indices);
+    free(names);
+}
+
+void test_names(char const* filepath, char const* metafile_filepath, unsigned nthreads)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile_options const options = {nthreads, false, 0};
+    struct bgen_metafile*              created =
+        bgen_metafile_create_with_options(bgen, metafile_filepath, 1, &options);
+    cass_cond(created != NULL);
+    cass_equal_int(bgen_metafile_close(created), 0);
+
+    struct bgen_metafile* mf = bgen_metafile_open(metafile_filepath);
+    cass_cond(mf != NULL);
+
+    check_lookup(mf, 0);
+    check_lookup(mf, 1);
+
+    /* An empty batch. */
+    cass_equal_int(bgen_metafile_lookup_rsids(mf, NULL, 0, NULL), 0);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
+
+/* Metafiles of version 04 predate the name indices. */
+void test_no_name_index(void)
+{
+    struct bgen_metafile* mf = bgen_metafile_open(TEST_DATADIR "example.14bits.bgen.metafile");
+    cass_cond(mf != NULL);
+
+    char const* rsids[] = {"RSID_2"};
+    uint32_t    index = 0;
+    cass_equal_int(bgen_metafile_lookup_rsids(mf, rsids, 1, &index), 1);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+}
@@ -0,0 +1,96 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_parallel(char const* filepath, char const* metafile_filepath, uint32_t npartitions);
+void test_layout1(void);
+
+int main(void)
+{
+    test_parallel(TEST_DATADIR "example.14bits.bgen",
+                  "metafile_parallel.tmp/example.14bits.bgen.metafile", 7);
+    test_parallel(TEST_DATADIR "example.14bits.zstd.bgen",
+                  "metafile_parallel.tmp/example.14bits.zstd.bgen.metafile", 1);
+    test_parallel(TEST_DATADIR "complex.23bits.bgen",
+                  "metafile_parallel.tmp/complex.23bits.bgen.metafile", 2);
+    test_parallel(TEST_DATADIR "haplotypes.bgen",
+                  "metafile_parallel.tmp/haplotypes.bgen.metafile", 1);
+    test_parallel(TEST_DATADIR "roundtrip1.bgen",
+                  "metafile_parallel.tmp/roundtrip1.bgen.metafile", 100);
+    test_parallel(TEST_DATADIR "zero_len_chrom_id.bgen",
+                  "metafile_parallel.tmp/zero_len_chrom_id.bgen.metafile", 3);
+    test_layout1();
+    return cass_status();
+}
+
+static char* read_file(char const* filepath, long* size)
+{
+    FILE* stream = fopen(filepath, "rb");
+    cass_cond(stream != NULL);
+    cass_equal_int(fseek(stream, 0, SEEK_END), 0);
+    *size = ftell(stream);
+    cass_equal_int(fseek(stream, 0, SEEK_SET), 0);
+
+    char* data = malloc((size_t)*size);
+    cass_cond(fread(data, (size_t)*size, 1, stream) == 1);
+    fclose(stream);
+    return data;
+}
+
+static void create(struct bgen_file* bgen, char const* filepath, uint32_t npartitions,
+                   unsigned nthreads)
+{
+    struct bgen_metafile_options const options = {nthreads, false, 0};
+    struct bgen_metafile*              mf =
+        bgen_metafile_create_with_options(bgen, filepath, npartitions, &options);
+    cass_cond(mf != NULL);
+    cass_equal_int(bgen_metafile_nvariants(mf), bgen_file_nvariants(bgen));
+    cass_equal_int(bgen_metafile_npartitions(mf), npartitions);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+}
+
+/* Metafiles written on any number of threads are the same, byte for byte. */
+void test_parallel(char const* filepath, char const* metafile_filepath, uint32_t npartitions)
+{
+    unsigned const nthreads[] = {1, 2, 3, 8};
+    char           parallel_filepath[256];
+
+    snprintf(parallel_filepath, sizeof(parallel_filepath), "%s.parallel", metafile_filepath);
+
+    for (int mmap = 0; mmap < 2; ++mmap) {
+        struct bgen_file* bgen =
+            mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+        cass_cond(bgen != NULL);
+
+        create(bgen, metafile_filepath, npartitions, 0);
+        long  size = 0;
+        char* expected = read_file(metafile_filepath, &size);
+
+        for (size_t i = 0; i < sizeof(nthreads) / sizeof(nthreads[0]); ++i) {
+            create(bgen, parallel_filepath, npartitions, nthreads[i]);
+            long  psize = 0;
+            char* data = read_file(parallel_filepath, &psize);
+            cass_cond(psize == size);
+            cass_cond(psize == size && memcmp(data, expected, (size_t)size) == 0);
+            free(data);
+        }
+
+        free(expected);
+        bgen_file_close(bgen);
+    }
+}
+
+/* Layout 1 is refused, as it is by the sequential path. */
+void test_layout1(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "example.v11.bgen");
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile_options const options = {2, false, 0};
+    cass_cond(bgen_metafile_create_with_options(
+                  bgen, "metafile_parallel.tmp/example.v11.bgen.metafile", 1, &options) ==
+              NULL);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,133 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <stdlib.h>
+#include <string.h>
+
+void test_region(char const* filepath, char const* metafile_filepath, uint32_t npartitions,
+                 unsigned nthreads);
+void test_no_region_index(void);
+
+int main(void)
+{
+    test_region(TEST_DATADIR "example.14bits.bgen",
+                "metafile_region.tmp/example.14bits.bgen.metafile", 7, 0);
+    test_region(TEST_DATADIR "example.14bits.bgen",
+                "metafile_region.tmp/example.14bits.bgen.metafile", 1, 3);
+    test_region(TEST_DATADIR "complex.23bits.bgen",
+                "metafile_region.tmp/complex.23bits.bgen.metafile", 3, 0);
+    test_region(TEST_DATADIR "haplotypes.bgen", "metafile_region.tmp/haplotypes.bgen.metafile",
+                2, 0);
+    test_region(TEST_DATADIR "roundtrip1.bgen", "metafile_region.tmp/roundtrip1.bgen.metafile",
+                10, 2);
+    test_region(TEST_DATADIR "zero_len_chrom_id.bgen",
+                "metafile_region.tmp/zero_len_chrom_id.bgen.metafile", 4, 0);
+    test_no_region_index();
+    return cass_status();
+}
+
+static int on_chrom(struct bgen_metafile const* mf, uint32_t index, char const* chrom)
+{
+    struct bgen_string const name = bgen_metafile_chrom(mf, index);
+    size_t const             length = strlen(chrom);
+    return name.length == length && (length == 0 || memcmp(name.data, chrom, length) == 0);
+}
+
+static int in_region(struct bgen_metafile const* mf, uint32_t index, char const* chrom,
+                     uint32_t start, uint32_t end)
+{
+    uint32_t const position = bgen_metafile_position(mf, index);
+    return on_chrom(mf, index, chrom) && position >= start && position <= end;
+}
+
+static void check_region(struct bgen_metafile const* mf, char const* chrom, uint32_t start,
+                         uint32_t end)
+{
+    uint32_t const* indices = NULL;
+    uint32_t        n = 0;
+    cass_equal_int(bgen_metafile_query_region(mf, chrom, start, end, &indices, &n), 0);
+
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < bgen_metafile_nvariants(mf); ++i)
+        expected += (uint32_t)in_region(mf, i, chrom, start, end);
+    cass_equal_int(n, expected);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        cass_cond(in_region(mf, indices[i], chrom, start, end));
+        if (i > 0) {
+            uint32_t const a = bgen_metafile_position(mf, indices[i - 1]);
+            uint32_t const b = bgen_metafile_position(mf, indices[i]);
+            cass_cond(a < b || (a == b && indices[i - 1] < indices[i]));
+        }
+    }
+
+    uint32_t const size = (bgen_metafile_nvariants(mf) + bgen_metafile_npartitions(mf) - 1) /
+                          bgen_metafile_npartitions(mf);
+    for (uint32_t p = 0; p < bgen_metafile_npartitions(mf); ++p) {
+        int found = 0;
+        for (uint32_t i = p * size; i < (p + 1) * size && i < bgen_metafile_nvariants(mf); ++i)
+            found |= in_region(mf, i, chrom, start, end);
+        if (found)
+            cass_equal_int(bgen_metafile_partition_overlaps(mf, p, chrom, start, end), 1);
+    }
+    cass_equal_int(
+        bgen_metafile_partition_overlaps(mf, bgen_metafile_npartitions(mf), chrom, start, end),
+        0);
+}
+
+void test_region(char const* filepath, char const* metafile_filepath, uint32_t npartitions,
+                 unsigned nthreads)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile_options const options = {nthreads, false, 0};
+    struct bgen_metafile*              created =
+        bgen_metafile_create_with_options(bgen, metafile_filepath, npartitions, &options);
+    cass_cond(created != NULL);
+    cass_equal_int(bgen_metafile_close(created), 0);
+
+    struct bgen_metafile* mf = bgen_metafile_open(metafile_filepath);
+    cass_cond(mf != NULL);
+
+    uint32_t const n = bgen_metafile_nvariants(mf);
+    for (uint32_t i = 0; i < n; ++i) {
+        struct bgen_string const name = bgen_metafile_chrom(mf, i);
+        char*                    chrom = malloc(name.length + 1);
+        memcpy(chrom, name.data, name.length);
+        chrom[name.length] = '\0';
+
+        uint32_t const position = bgen_metafile_position(mf, i);
+        uint32_t const before = position > 1000 ? position - 1000 : 0;
+        check_region(mf, chrom, position, position);
+        check_region(mf, chrom, before, position);
+        check_region(mf, chrom, position, position + 5000);
+        check_region(mf, chrom, 0, UINT32_MAX);
+        free(chrom);
+    }
+
+    check_region(mf, "no such chromosome", 0, UINT32_MAX);
+
+    /* An empty region. */
+    uint32_t const* indices = NULL;
+    uint32_t        count = 1;
+    cass_equal_int(bgen_metafile_query_region(mf, "01", 10, 9, &indices, &count), 0);
+    cass_equal_int(count, 0);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
+
+/* Metafiles of version 04 predate the region index. */
+void test_no_region_index(void)
+{
+    struct bgen_metafile* mf = bgen_metafile_open(TEST_DATADIR "example.14bits.bgen.metafile");
+    cass_cond(mf != NULL);
+
+    uint32_t const* indices = NULL;
+    uint32_t        count = 0;
+    cass_equal_int(bgen_metafile_query_region(mf, "01", 0, UINT32_MAX, &indices, &count), 1);
+    cass_equal_int(count, 0);
+    cass_equal_int(bgen_metafile_partition_overlaps(mf, 0, "01", 0, UINT32_MAX), 1);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+}
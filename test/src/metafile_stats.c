@@ -0,0 +1,280 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_stats(char const* filepath, char const* metafile_filepath, int nbits);
+void test_without_stats(void);
+void test_known_values(void);
+
+int main(void)
+{
+    test_stats(TEST_DATADIR "example.14bits.bgen",
+               "metafile_stats.tmp/example.14bits.bgen.metafile", 14);
+    test_stats(TEST_DATADIR "example.14bits.zstd.bgen",
+               "metafile_stats.tmp/example.14bits.zstd.bgen.metafile", 14);
+    test_stats(TEST_DATADIR "complex.23bits.bgen",
+               "metafile_stats.tmp/complex.23bits.bgen.metafile", 23);
+    test_stats(TEST_DATADIR "haplotypes.bgen", "metafile_stats.tmp/haplotypes.bgen.metafile",
+               -1);
+    test_stats(TEST_DATADIR "roundtrip1.bgen", "metafile_stats.tmp/roundtrip1.bgen.metafile",
+               -1);
+    test_without_stats();
+    test_known_values();
+    return cass_status();
+}
+
+static int close_enough(double a, double b)
+{
+    if (isnan(a) || isnan(b))
+        return isnan(a) && isnan(b);
+    return fabs(a - b) <= 1e-9 * (1.0 + fabs(b));
+}
+
+/* Allele frequency and info score computed from the probabilities, as a reference. */
+static void expected_stats(struct bgen_genotype* genotype, uint32_t nsamples,
+                           double* frequency, double* info)
+{
+    unsigned const ncombs = bgen_genotype_ncombs(genotype);
+    double*        probs = malloc(sizeof(double) * nsamples * ncombs);
+    cass_equal_int(bgen_genotype_read(genotype, probs), 0);
+
+    double mean = 0.0;
+    double variance = 0.0;
+    double nalleles = 0.0;
+    for (uint32_t s = 0; s < nsamples; ++s) {
+        if (bgen_genotype_missing(genotype, s))
+            continue;
+
+        unsigned const ploidy = bgen_genotype_ploidy(genotype, s);
+        double const*  p = probs + (size_t)s * ncombs;
+        double         e = 0.0;
+        double         v = 0.0;
+        if (bgen_genotype_phased(genotype)) {
+            for (unsigned h = 0; h < ploidy; ++h) {
+                e += p[2 * h + 1];
+                v += p[2 * h] * p[2 * h + 1];
+            }
+        } else {
+            double f = 0.0;
+            for (unsigned j = 0; j <= ploidy; ++j) {
+                e += j * p[j];
+                f += j * j * p[j];
+            }
+            v = f - e * e;
+        }
+        mean += e;
+        variance += v;
+        nalleles += ploidy;
+    }
+    free(probs);
+
+    *frequency = nalleles > 0 ? mean / nalleles : NAN;
+    if (nalleles == 0)
+        *info = NAN;
+    else if (*frequency <= 0 || *frequency >= 1)
+        *info = 1.0;
+    else
+        *info = 1.0 - variance / (nalleles * *frequency * (1 - *frequency));
+}
+
+static struct bgen_metafile* create(struct bgen_file* bgen, char const* filepath,
+                                    unsigned nthreads)
+{
+    struct bgen_metafile_options const options = {nthreads, true, 0};
+    struct bgen_metafile*              mf =
+        bgen_metafile_create_with_options(bgen, filepath, 3, &options);
+    cass_cond(mf != NULL);
+    return mf;
+}
+
+static void check_stats(struct bgen_file* bgen, struct bgen_metafile const* mf, int nbits)
+{
+    uint32_t const            nvariants = bgen_metafile_nvariants(mf);
+    uint32_t const            nsamples = bgen_file_nsamples(bgen);
+    double const*             frequencies = bgen_metafile_allele_frequencies(mf);
+    double const*             infos = bgen_metafile_info_scores(mf);
+    struct bgen_variant_stats stats;
+
+    cass_cond(frequencies != NULL);
+    cass_cond(infos != NULL);
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        cass_equal_int(bgen_metafile_variant_stats(mf, i, &stats), 0);
+
+        uint64_t const        offset = bgen_metafile_genotype_offset(mf, i);
+        struct bgen_genotype* genotype = bgen_file_open_genotype(bgen, offset);
+        cass_cond(genotype != NULL);
+
+        if (nbits > 0)
+            cass_equal_int(stats.nbits, nbits);
+        cass_cond(stats.block_size > 0);
+        if (i + 1 < nvariants) {
+            uint64_t const next = bgen_metafile_genotype_offset(mf, i + 1);
+            cass_cond(offset + 4 + stats.block_size <= next);
+        }
+        cass_cond(stats.phased == bgen_genotype_phased(genotype));
+        cass_equal_int(stats.min_ploidy, bgen_genotype_min_ploidy(genotype));
+        cass_equal_int(stats.max_ploidy, bgen_genotype_max_ploidy(genotype));
+
+        uint32_t nmissing = 0;
+        for (uint32_t s = 0; s < nsamples; ++s)
+            nmissing += bgen_genotype_missing(genotype, s);
+        cass_equal_int(stats.nmissing, nmissing);
+
+        double frequency = NAN;
+        double info = NAN;
+        if (bgen_genotype_nalleles(genotype) == 2)
+            expected_stats(genotype, nsamples, &frequency, &info);
+        cass_cond(close_enough(stats.allele_frequency, frequency));
+        cass_cond(close_enough(stats.info, info));
+        cass_cond(close_enough(frequencies[i], frequency));
+        cass_cond(close_enough(infos[i], info));
+        if (!isnan(info))
+            cass_cond(info <= 1.0);
+
+        bgen_genotype_close(genotype);
+    }
+
+    cass_equal_int(bgen_metafile_variant_stats(mf, nvariants, &stats), 1);
+}
+
+static char* read_file(char const* filepath, long* size)
+{
+    FILE* stream = fopen(filepath, "rb");
+    cass_cond(stream != NULL);
+    cass_equal_int(fseek(stream, 0, SEEK_END), 0);
+    *size = ftell(stream);
+    cass_equal_int(fseek(stream, 0, SEEK_SET), 0);
+
+    char* data = malloc((size_t)*size);
+    cass_cond(fread(data, (size_t)*size, 1, stream) == 1);
+    fclose(stream);
+    return data;
+}
+
+/* Statistics are the same on any number of threads, and are found again once reopened. */
+void test_stats(char const* filepath, char const* metafile_filepath, int nbits)
+{
+    unsigned const nthreads[] = {0, 1, 3, 8};
+    char           other_filepath[256];
+
+    snprintf(other_filepath, sizeof(other_filepath), "%s.threads", metafile_filepath);
+
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf = create(bgen, metafile_filepath, 0);
+    check_stats(bgen, mf, nbits);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+
+    long  size = 0;
+    char* expected = read_file(metafile_filepath, &size);
+    for (int t = 1; t < 4; ++t) {
+        cass_equal_int(bgen_metafile_close(create(bgen, other_filepath, nthreads[t])), 0);
+        long  other_size = 0;
+        char* other = read_file(other_filepath, &other_size);
+        cass_cond(other_size == size);
+        cass_cond(other_size == size && memcmp(other, expected, (size_t)size) == 0);
+        free(other);
+    }
+    free(expected);
+
+    mf = bgen_metafile_open(metafile_filepath);
+    cass_cond(mf != NULL);
+    check_stats(bgen, mf, nbits);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+
+    bgen_file_close(bgen);
+}
+
+/* Statistics are only there when asked for. */
+void test_without_stats(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "example.14bits.bgen");
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(
+        bgen, "metafile_stats.tmp/example.14bits.bgen.metafile.nostats", 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_variant_stats stats;
+    cass_equal_int(bgen_metafile_variant_stats(mf, 0, &stats), 1);
+    cass_cond(bgen_metafile_allele_frequencies(mf) == NULL);
+    cass_cond(bgen_metafile_info_scores(mf) == NULL);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+
+    struct bgen_metafile* mf04 =
+        bgen_metafile_open(TEST_DATADIR "example.14bits.bgen.metafile");
+    cass_cond(mf04 != NULL);
+    cass_equal_int(bgen_metafile_variant_stats(mf04, 0, &stats), 1);
+    cass_cond(bgen_metafile_allele_frequencies(mf04) == NULL);
+    cass_equal_int(bgen_metafile_close(mf04), 0);
+
+    bgen_file_close(bgen);
+}
+
+/* Uncompressed, layout 2, five samples and two biallelic diploid variants of 8-bit
+ * probabilities (multiples of 1/255, so that 51, 153 and 204 stand for 0.2, 0.6 and 0.8). */
+static unsigned char const known_values[] = {
+    20, 0, 0, 0,                                    /* offset */
+    20, 0, 0, 0, 2, 0, 0, 0, 5, 0, 0, 0,            /* header length, variants, samples */
+    'b', 'g', 'e', 'n', 8, 0, 0, 0,                 /* magic number, flags */
+    2, 0, 'v', '1', 2, 0, 'r', '1', 1, 0, '1',      /* id, rsid, chrom */
+    100, 0, 0, 0, 2, 0,                             /* position, alleles */
+    1, 0, 0, 0, 'A', 1, 0, 0, 0, 'G',               /* allele ids */
+    25, 0, 0, 0,                                    /* genotype block length */
+    5, 0, 0, 0, 2, 0, 2, 2, 2, 2, 2, 2, 0x82,       /* unphased, the last sample missing */
+    0, 8, 255, 0, 0, 255, 0, 0, 51, 204, 0, 0,      /* AA, AG, GG, 0.2 AA + 0.8 AG */
+    2, 0, 'v', '2', 2, 0, 'r', '2', 1, 0, '1',      /* id, rsid, chrom */
+    200, 0, 0, 0, 2, 0,                             /* position, alleles */
+    1, 0, 0, 0, 'A', 1, 0, 0, 0, 'G',               /* allele ids */
+    25, 0, 0, 0,                                    /* genotype block length */
+    5, 0, 0, 0, 2, 0, 2, 2, 2, 2, 0x82, 0x82, 0x82, /* phased, the last three missing */
+    1, 8, 255, 0, 51, 153, 0, 0, 0, 0, 0, 0         /* A|G, then P(A) of 0.2 and 0.6 */
+};
+
+/* Statistics worked out by hand.
+ *
+ * Unphased: the dosages of G are 0, 1, 2 and 0.8, and their variances 0, 0, 0 and
+ * 0.8 - 0.8^2 = 0.16. Over 8 alleles, the frequency is 3.8 / 8 = 0.475 and the info score
+ * 1 - 0.16 / (8 * 0.475 * 0.525) = 367 / 399.
+ *
+ * Phased: the haplotypes carry G with probabilities 0, 1, 0.8 and 0.4, of variances 0, 0,
+ * 0.16 and 0.24. Over 4 alleles, the frequency is 2.2 / 4 = 0.55 and the info score
+ * 1 - 0.4 / (4 * 0.55 * 0.45) = 59 / 99. */
+void test_known_values(void)
+{
+    char const* filepath = "metafile_stats.tmp/known_values.bgen";
+    FILE*       stream = fopen(filepath, "wb");
+    cass_cond(stream != NULL);
+    cass_cond(fwrite(known_values, sizeof(known_values), 1, stream) == 1);
+    fclose(stream);
+
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    struct bgen_metafile* mf =
+        create(bgen, "metafile_stats.tmp/known_values.bgen.metafile", 1);
+    cass_equal_int(bgen_metafile_nvariants(mf), 2);
+
+    struct bgen_variant_stats stats;
+    cass_equal_int(bgen_metafile_variant_stats(mf, 0, &stats), 0);
+    cass_equal_int(stats.block_size, 25);
+    cass_equal_int(stats.nbits, 8);
+    cass_cond(!stats.phased);
+    cass_equal_int(stats.min_ploidy, 2);
+    cass_equal_int(stats.max_ploidy, 2);
+    cass_equal_int(stats.nmissing, 1);
+    cass_cond(close_enough(stats.allele_frequency, 0.475));
+    cass_cond(close_enough(stats.info, 367.0 / 399.0));
+
+    cass_equal_int(bgen_metafile_variant_stats(mf, 1, &stats), 0);
+    cass_cond(stats.phased);
+    cass_equal_int(stats.nmissing, 3);
+    cass_cond(close_enough(stats.allele_frequency, 0.55));
+    cass_cond(close_enough(stats.info, 59.0 / 99.0));
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
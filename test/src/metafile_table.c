@@ -0,0 +1,124 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+
+void test_table(char const* filepath, char const* metafile_filepath, uint32_t npartitions);
+void test_against_04(void);
+
+int main(void)
+{
+    test_table(TEST_DATADIR "example.14bits.bgen",
+               "metafile_table.tmp/example.14bits.bgen.metafile", 7);
+    test_table(TEST_DATADIR "complex.23bits.bgen",
+               "metafile_table.tmp/complex.23bits.bgen.metafile", 3);
+    test_table(TEST_DATADIR "haplotypes.bgen", "metafile_table.tmp/haplotypes.bgen.metafile",
+               1);
+    test_table(TEST_DATADIR "roundtrip1.bgen", "metafile_table.tmp/roundtrip1.bgen.metafile",
+               100);
+    test_against_04();
+    return cass_status();
+}
+
+static void check_table(struct bgen_metafile const* mf, struct bgen_variant_table const* table)
+{
+    uint32_t const n = bgen_metafile_nvariants(mf);
+    cass_equal_int(table->nvariants, n);
+
+    uint64_t string = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        cass_cond(table->genotype_offsets[i] == bgen_metafile_genotype_offset(mf, i));
+        cass_cond(table->positions[i] == bgen_metafile_position(mf, i));
+        cass_equal_int(table->nalleles[i], bgen_metafile_nalleles(mf, i));
+        cass_cond(table->chroms[i] < table->nchroms);
+        cass_cond(bgen_string_equal(table->chrom_names[table->chroms[i]],
+                                    bgen_metafile_chrom(mf, i)));
+        cass_cond(
+            bgen_string_equal(bgen_variant_table_chrom(table, i), bgen_metafile_chrom(mf, i)));
+        cass_cond(bgen_string_equal(bgen_variant_table_id(table, i), bgen_metafile_id(mf, i)));
+        cass_cond(
+            bgen_string_equal(bgen_variant_table_rsid(table, i), bgen_metafile_rsid(mf, i)));
+        for (uint16_t j = 0; j < table->nalleles[i]; ++j) {
+            cass_cond(bgen_string_equal(bgen_variant_table_allele_id(table, i, j),
+                                        bgen_metafile_allele_id(mf, i, j)));
+        }
+        cass_cond(bgen_variant_table_allele_id(table, i, table->nalleles[i]).length == 0);
+
+        /* Strings are laid out back to back, in order. */
+        cass_cond(table->first_string[i] == string);
+        string += 2 + (uint64_t)table->nalleles[i];
+    }
+    cass_cond(table->first_string[n] == string);
+    cass_cond(table->string_offsets[0] == 0);
+    for (uint64_t k = 0; k < string; ++k)
+        cass_cond(table->string_offsets[k] <= table->string_offsets[k + 1]);
+
+    /* Chromosome codes are distinct, and in order of first appearance. */
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        cass_cond(table->chroms[i] <= next);
+        if (table->chroms[i] == next)
+            ++next;
+    }
+    cass_equal_int(next, table->nchroms);
+    for (uint32_t a = 0; a < table->nchroms; ++a) {
+        for (uint32_t b = a + 1; b < table->nchroms; ++b)
+            cass_cond(!bgen_string_equal(table->chrom_names[a], table->chrom_names[b]));
+    }
+
+    /* Out of range. */
+    cass_cond(bgen_variant_table_id(table, n).length == 0);
+    cass_cond(bgen_variant_table_rsid(table, n).length == 0);
+    cass_cond(bgen_variant_table_chrom(table, n).length == 0);
+    cass_cond(bgen_variant_table_allele_id(table, n, 0).length == 0);
+}
+
+void test_table(char const* filepath, char const* metafile_filepath, uint32_t npartitions)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, npartitions, 0);
+    cass_cond(mf != NULL);
+
+    unsigned const nthreads[] = {0, 1, 3, 8};
+    for (int t = 0; t < 4; ++t) {
+        struct bgen_variant_table* table = bgen_metafile_load_table(mf, nthreads[t]);
+        cass_cond(table != NULL);
+        check_table(mf, table);
+
+        /* Offsets go straight to the genotype reader. */
+        for (uint32_t i = 0; i < table->nvariants; ++i) {
+            struct bgen_genotype* genotype =
+                bgen_file_open_genotype(bgen, table->genotype_offsets[i]);
+            cass_cond(genotype != NULL);
+            cass_equal_int(bgen_genotype_nalleles(genotype), table->nalleles[i]);
+            bgen_genotype_close(genotype);
+        }
+        bgen_variant_table_destroy(table);
+    }
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
+
+/* A version 04 metafile loads into the same table, which outlives it. */
+void test_against_04(void)
+{
+    struct bgen_metafile* mf04 =
+        bgen_metafile_open(TEST_DATADIR "example.14bits.bgen.metafile");
+    cass_cond(mf04 != NULL);
+    cass_equal_int(bgen_metafile_version(mf04), 4);
+    struct bgen_variant_table* table04 = bgen_metafile_load_table(mf04, 4);
+    cass_cond(table04 != NULL);
+    cass_equal_int(bgen_metafile_close(mf04), 0);
+
+    struct bgen_metafile* mf =
+        bgen_metafile_open("metafile_table.tmp/example.14bits.bgen.metafile");
+    cass_cond(mf != NULL);
+    check_table(mf, table04);
+    cass_cond(bgen_string_equal(bgen_variant_table_id(table04, 0), BGEN_STRING("SNPID_2")));
+    cass_cond(bgen_string_equal(bgen_variant_table_chrom(table04, 0), BGEN_STRING("01")));
+    cass_equal_int(table04->nchroms, 1);
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_variant_table_destroy(table04);
+}
@@ -0,0 +1,125 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_mmap(char const* filepath, char const* metafile_filepath);
+void test_uncompressed(void);
+
+int main(void)
+{
+    test_mmap(TEST_DATADIR "complex.23bits.bgen", "mmap.tmp/complex.23bits.bgen.metafile");
+    test_mmap(TEST_DATADIR "complex.23bits.uncompressed.bgen",
+              "mmap.tmp/complex.23bits.uncompressed.bgen.metafile");
+    test_mmap(TEST_DATADIR "haplotypes.bgen", "mmap.tmp/haplotypes.bgen.metafile");
+    test_mmap(TEST_DATADIR "example.32bits.bgen", "mmap.tmp/example.32bits.bgen.metafile");
+    test_uncompressed();
+    return cass_status();
+}
+
+void test_mmap(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    struct bgen_file* mapped = bgen_file_open_mmap(filepath);
+    cass_cond(bgen != NULL);
+    cass_cond(mapped != NULL);
+
+    cass_equal_int(bgen_file_nsamples(mapped), bgen_file_nsamples(bgen));
+    cass_equal_int(bgen_file_nvariants(mapped), bgen_file_nvariants(bgen));
+
+    struct bgen_metafile* mf = bgen_metafile_create(mapped, metafile_filepath, 2, 0);
+    cass_cond(mf != NULL);
+
+    uint32_t nsamples = bgen_file_nsamples(bgen);
+    for (uint32_t i = 0; i < bgen_metafile_npartitions(mf); ++i) {
+        struct bgen_partition const* partition = bgen_metafile_read_partition(mf, i);
+        for (uint32_t j = 0; j < bgen_partition_nvariants(partition); ++j) {
+            struct bgen_variant const* vm = bgen_partition_get_variant(partition, j);
+            struct bgen_genotype*      vg = bgen_file_open_genotype(bgen, vm->genotype_offset);
+            struct bgen_genotype* mvg = bgen_file_open_genotype(mapped, vm->genotype_offset);
+            cass_cond(vg != NULL);
+            cass_cond(mvg != NULL);
+
+            cass_equal_int(bgen_genotype_nalleles(mvg), bgen_genotype_nalleles(vg));
+            cass_equal_int(bgen_genotype_ncombs(mvg), bgen_genotype_ncombs(vg));
+            cass_equal_int(bgen_genotype_phased(mvg), bgen_genotype_phased(vg));
+            cass_equal_int(bgen_genotype_min_ploidy(mvg), bgen_genotype_min_ploidy(vg));
+            cass_equal_int(bgen_genotype_max_ploidy(mvg), bgen_genotype_max_ploidy(vg));
+
+            size_t  n = nsamples * bgen_genotype_ncombs(vg);
+            double* probs = malloc(n * sizeof(double));
+            double* mprobs = malloc(n * sizeof(double));
+            cass_equal_int(bgen_genotype_read(vg, probs), 0);
+            cass_equal_int(bgen_genotype_read(mvg, mprobs), 0);
+
+            for (uint32_t l = 0; l < nsamples; ++l) {
+                cass_equal_int(bgen_genotype_ploidy(mvg, l), bgen_genotype_ploidy(vg, l));
+                cass_equal_int(bgen_genotype_missing(mvg, l), bgen_genotype_missing(vg, l));
+            }
+            for (size_t l = 0; l < n; ++l)
+                cass_cond(same_probability(mprobs[l], probs[l]));
+
+            free(probs);
+            free(mprobs);
+            bgen_genotype_close(vg);
+            bgen_genotype_close(mvg);
+        }
+        bgen_partition_destroy(partition);
+    }
+
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(mapped);
+    bgen_file_close(bgen);
+}
+
+void test_uncompressed(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "complex.23bits.bgen");
+    struct bgen_file* ubgen = bgen_file_open(TEST_DATADIR "complex.23bits.uncompressed.bgen");
+    cass_cond(bgen != NULL);
+    cass_cond(ubgen != NULL);
+
+    struct bgen_metafile* mf =
+        bgen_metafile_create(bgen, "mmap.tmp/complex.23bits.bgen.metafile.1", 1, 0);
+    struct bgen_metafile* umf = bgen_metafile_create(
+        ubgen, "mmap.tmp/complex.23bits.uncompressed.bgen.metafile.1", 1, 0);
+    cass_cond(mf != NULL);
+    cass_cond(umf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    struct bgen_partition const* upartition = bgen_metafile_read_partition(umf, 0);
+
+    uint32_t nsamples = bgen_file_nsamples(bgen);
+    for (uint32_t i = 0; i < bgen_partition_nvariants(partition); ++i) {
+        struct bgen_variant const* vm = bgen_partition_get_variant(partition, i);
+        struct bgen_variant const* uvm = bgen_partition_get_variant(upartition, i);
+        struct bgen_genotype*      vg = bgen_file_open_genotype(bgen, vm->genotype_offset);
+        struct bgen_genotype*      uvg = bgen_file_open_genotype(ubgen, uvm->genotype_offset);
+        cass_cond(vg != NULL);
+        cass_cond(uvg != NULL);
+
+        cass_equal_int(bgen_genotype_ncombs(uvg), bgen_genotype_ncombs(vg));
+
+        size_t  n = nsamples * bgen_genotype_ncombs(vg);
+        double* probs = malloc(n * sizeof(double));
+        double* uprobs = malloc(n * sizeof(double));
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read(uvg, uprobs), 0);
+
+        for (size_t l = 0; l < n; ++l)
+            cass_cond(same_probability(uprobs[l], probs[l]));
+
+        free(probs);
+        free(uprobs);
+        bgen_genotype_close(vg);
+        bgen_genotype_close(uvg);
+    }
+
+    bgen_partition_destroy(partition);
+    bgen_partition_destroy(upartition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    cass_equal_int(bgen_metafile_close(umf), 0);
+    bgen_file_close(ubgen);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,76 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_open_genotypes(char const* filepath, char const* metafile_filepath, int mmap);
+
+int main(void)
+{
+    test_open_genotypes(TEST_DATADIR "example.14bits.bgen",
+                        "open_genotypes.tmp/example.14bits.bgen.metafile", 0);
+    test_open_genotypes(TEST_DATADIR "example.14bits.bgen",
+                        "open_genotypes.tmp/example.14bits.bgen.metafile", 1);
+    test_open_genotypes(TEST_DATADIR "example.14bits.zstd.bgen",
+                        "open_genotypes.tmp/example.14bits.zstd.bgen.metafile", 0);
+    test_open_genotypes(TEST_DATADIR "complex.23bits.uncompressed.bgen",
+                        "open_genotypes.tmp/complex.23bits.uncompressed.bgen.metafile", 0);
+    test_open_genotypes(TEST_DATADIR "haplotypes.bgen",
+                        "open_genotypes.tmp/haplotypes.bgen.metafile", 0);
+    return cass_status();
+}
+
+void test_open_genotypes(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    /* Scattered order, every variant appearing twice. */
+    uint32_t  n = 2 * nvariants;
+    uint64_t* scattered = malloc(n * sizeof(uint64_t));
+    for (uint32_t i = 0; i < n; ++i)
+        scattered[i] = offsets[(uint32_t)(((uint64_t)i * 7919) % nvariants)];
+
+    struct bgen_genotype** genotypes = malloc(n * sizeof(struct bgen_genotype*));
+    cass_equal_int(bgen_file_open_genotypes(bgen, scattered, n, genotypes), 0);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        struct bgen_genotype* expected = bgen_file_open_genotype(bgen, scattered[i]);
+        cass_cond(genotypes[i] != NULL);
+        cass_cond(expected != NULL);
+
+        unsigned ncombs = bgen_genotype_ncombs(expected);
+        cass_equal_int(bgen_genotype_ncombs(genotypes[i]), ncombs);
+        cass_equal_int(bgen_genotype_nalleles(genotypes[i]), bgen_genotype_nalleles(expected));
+
+        double* probs = malloc((size_t)nsamples * ncombs * sizeof(double));
+        double* eprobs = malloc((size_t)nsamples * ncombs * sizeof(double));
+        cass_equal_int(bgen_genotype_read(genotypes[i], probs), 0);
+        cass_equal_int(bgen_genotype_read(expected, eprobs), 0);
+        for (size_t j = 0; j < (size_t)nsamples * ncombs; ++j)
+            cass_cond(same_probability(probs[j], eprobs[j]));
+
+        free(eprobs);
+        free(probs);
+        bgen_genotype_close(expected);
+        bgen_genotype_close(genotypes[i]);
+    }
+
+    cass_equal_int(bgen_file_open_genotypes(bgen, scattered, 0, genotypes), 0);
+
+    /* A single bad offset fails the whole batch. */
+    scattered[n / 2] = UINT64_MAX / 2;
+    cass_equal_int(bgen_file_open_genotypes(bgen, scattered, n, genotypes), 1);
+    for (uint32_t i = 0; i < n; ++i)
+        cass_cond(genotypes[i] == NULL);
+
+    free(genotypes);
+    free(scattered);
+    free(offsets);
+    bgen_file_close(bgen);
+}
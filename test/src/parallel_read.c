@@ -0,0 +1,88 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_parallel_read(char const* filepath, char const* metafile_filepath);
+
+int main(void)
+{
+    test_parallel_read(TEST_DATADIR "complex.23bits.bgen",
+                       "parallel_read.tmp/complex.23bits.bgen.metafile");
+    test_parallel_read(TEST_DATADIR "haplotypes.bgen",
+                       "parallel_read.tmp/haplotypes.bgen.metafile");
+    test_parallel_read(TEST_DATADIR "example.14bits.bgen",
+                       "parallel_read.tmp/example.14bits.bgen.metafile");
+    return cass_status();
+}
+
+static int same_matrix(double const* a, double const* b, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (a[i] != b[i] && !(isnan(a[i]) && isnan(b[i])))
+            return 0;
+    }
+    return 1;
+}
+
+void test_parallel_read(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    struct bgen_file* mapped = bgen_file_open_mmap(filepath);
+    cass_cond(bgen != NULL);
+    cass_cond(mapped != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t                     nvariants = bgen_partition_nvariants(partition);
+    uint32_t                     nsamples = bgen_file_nsamples(bgen);
+
+    uint64_t* offsets = malloc(nvariants * sizeof(uint64_t));
+    unsigned  ncombs = 0;
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        offsets[i] = bgen_partition_get_variant(partition, i)->genotype_offset;
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[i]);
+        if (bgen_genotype_ncombs(vg) > ncombs)
+            ncombs = bgen_genotype_ncombs(vg);
+        bgen_genotype_close(vg);
+    }
+
+    size_t  size = (size_t)nvariants * nsamples * ncombs;
+    double* expected = malloc(size * sizeof(double));
+    double* matrix = malloc(size * sizeof(double));
+
+    for (int sample_major = 0; sample_major < 2; ++sample_major) {
+        struct bgen_read_options options = {ncombs, sample_major, 1, NULL, 0};
+        cass_equal_int(bgen_file_read_genotypes(bgen, offsets, nvariants, expected, &options),
+                       0);
+
+        unsigned nthreads[] = {0, 2, 3, 8, 64};
+        for (size_t i = 0; i < sizeof(nthreads) / sizeof(nthreads[0]); ++i) {
+            options.nthreads = nthreads[i];
+
+            memset(matrix, 0, size * sizeof(double));
+            cass_equal_int(
+                bgen_file_read_genotypes(bgen, offsets, nvariants, matrix, &options), 0);
+            cass_cond(same_matrix(matrix, expected, size));
+
+            memset(matrix, 0, size * sizeof(double));
+            cass_equal_int(
+                bgen_file_read_genotypes(mapped, offsets, nvariants, matrix, &options), 0);
+            cass_cond(same_matrix(matrix, expected, size));
+        }
+    }
+
+    /* Failures in worker threads are reported back to the caller. */
+    struct bgen_read_options options = {ncombs - 1, false, 4, NULL, 0};
+    cass_equal_int(bgen_file_read_genotypes(mapped, offsets, nvariants, matrix, &options), 1);
+
+    free(matrix);
+    free(expected);
+    free(offsets);
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(mapped);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,164 @@
+#include "../../src/thread.h"
+#include "bgen/bgen.h"
+#include "cass.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_positional_read(void);
+void test_shared_handle(char const* filepath, char const* metafile_filepath, int mmap);
+
+int main(void)
+{
+    test_positional_read();
+    test_shared_handle(TEST_DATADIR "complex.23bits.bgen",
+                       "positional_read.tmp/complex.23bits.bgen.metafile", 0);
+    test_shared_handle(TEST_DATADIR "example.14bits.zstd.bgen",
+                       "positional_read.tmp/example.14bits.zstd.bgen.metafile", 0);
+    test_shared_handle(TEST_DATADIR "example.14bits.bgen",
+                       "positional_read.tmp/example.14bits.bgen.metafile", 1);
+    return cass_status();
+}
+
+static double* read_probabilities(struct bgen_file* bgen, uint64_t offset, unsigned* ncombs)
+{
+    struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offset);
+    cass_cond(vg != NULL);
+    *ncombs = bgen_genotype_ncombs(vg);
+    double* probs = malloc(bgen_file_nsamples(bgen) * (*ncombs) * sizeof(double));
+    cass_equal_int(bgen_genotype_read(vg, probs), 0);
+    bgen_genotype_close(vg);
+    return probs;
+}
+
+void test_positional_read(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "complex.23bits.bgen");
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf =
+        bgen_metafile_create(bgen, "positional_read.tmp/complex.23bits.bgen.metafile", 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t                     nvariants = bgen_partition_nvariants(partition);
+    uint32_t                     nsamples = bgen_file_nsamples(bgen);
+
+    double** forward = malloc(nvariants * sizeof(double*));
+    unsigned ncombs = 0;
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        uint64_t offset = bgen_partition_get_variant(partition, i)->genotype_offset;
+        forward[i] = read_probabilities(bgen, offset, &ncombs);
+    }
+
+    /* Reading samples moves the file cursor, which must not affect genotype reads. */
+    for (uint32_t i = nvariants; i > 0; --i) {
+        struct bgen_samples* samples = bgen_file_read_samples(bgen);
+        cass_cond(samples != NULL);
+        bgen_samples_destroy(samples);
+
+        uint64_t offset = bgen_partition_get_variant(partition, i - 1)->genotype_offset;
+        double*  probs = read_probabilities(bgen, offset, &ncombs);
+
+        for (size_t j = 0; j < nsamples * ncombs; ++j) {
+            double a = probs[j], b = forward[i - 1][j];
+            cass_cond(a == b || (isnan(a) && isnan(b)));
+        }
+        free(probs);
+    }
+
+    for (uint32_t i = 0; i < nvariants; ++i)
+        free(forward[i]);
+    free(forward);
+
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
+
+#define NTHREADS 4
+
+struct reader_thread
+{
+    struct bgen_thread thread;
+    struct bgen_file*  bgen;
+    uint64_t const*    offsets;
+    double* const*     expected;
+    uint32_t           nvariants;
+    uint32_t           first; /* Variants are read from `first` on, wrapping around. */
+    unsigned           failures;
+};
+
+/* Assertions are not thread-safe: failures are counted, and checked once joined. */
+static void read_variants(void* arg)
+{
+    struct reader_thread* t = arg;
+    uint32_t const        nsamples = bgen_file_nsamples(t->bgen);
+
+    for (int round = 0; round < 3; ++round) {
+        for (uint32_t k = 0; k < t->nvariants; ++k) {
+            uint32_t const        i = (t->first + k) % t->nvariants;
+            struct bgen_genotype* vg = bgen_file_open_genotype(t->bgen, t->offsets[i]);
+            if (vg == NULL) {
+                ++t->failures;
+                continue;
+            }
+
+            size_t const n = (size_t)nsamples * bgen_genotype_ncombs(vg);
+            double*      probs = malloc(n * sizeof(double));
+            if (bgen_genotype_read(vg, probs))
+                ++t->failures;
+            for (size_t j = 0; j < n; ++j) {
+                double a = probs[j], b = t->expected[i][j];
+                if (!(a == b || (isnan(a) && isnan(b))))
+                    ++t->failures;
+            }
+            free(probs);
+            bgen_genotype_close(vg);
+        }
+    }
+}
+
+/* Several threads open and read genotypes from a single handler at once. */
+void test_shared_handle(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t const               nvariants = bgen_partition_nvariants(partition);
+
+    uint64_t* offsets = malloc(nvariants * sizeof(uint64_t));
+    double**  expected = malloc(nvariants * sizeof(double*));
+    unsigned  ncombs = 0;
+    for (uint32_t i = 0; i < nvariants; ++i) {
+        offsets[i] = bgen_partition_get_variant(partition, i)->genotype_offset;
+        expected[i] = read_probabilities(bgen, offsets[i], &ncombs);
+    }
+
+    struct reader_thread threads[NTHREADS];
+    for (unsigned t = 0; t < NTHREADS; ++t) {
+        threads[t].bgen = bgen;
+        threads[t].offsets = offsets;
+        threads[t].expected = expected;
+        threads[t].nvariants = nvariants;
+        threads[t].first = (uint32_t)(t * nvariants / NTHREADS);
+        threads[t].failures = 0;
+        cass_equal_int(bgen_thread_create(&threads[t].thread, read_variants, threads + t), 0);
+    }
+    for (unsigned t = 0; t < NTHREADS; ++t) {
+        bgen_thread_join(&threads[t].thread);
+        cass_equal_int(threads[t].failures, 0);
+    }
+
+    for (uint32_t i = 0; i < nvariants; ++i)
+        free(expected[i]);
+    free(expected);
+    free(offsets);
+
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,171 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_prefetch(char const* filepath, char const* metafile_filepath, int mmap);
+void test_no_reads(char const* filepath, char const* metafile_filepath, int mmap);
+
+int main(void)
+{
+    test_prefetch(TEST_DATADIR "example.14bits.bgen",
+                  "prefetch.tmp/example.14bits.bgen.metafile", 0);
+    test_prefetch(TEST_DATADIR "example.14bits.bgen",
+                  "prefetch.tmp/example.14bits.bgen.metafile", 1);
+    test_prefetch(TEST_DATADIR "complex.23bits.uncompressed.bgen",
+                  "prefetch.tmp/complex.23bits.uncompressed.bgen.metafile", 1);
+    test_prefetch(TEST_DATADIR "complex.23bits.zstd.bgen",
+                  "prefetch.tmp/complex.23bits.zstd.bgen.metafile", 0);
+    test_no_reads(TEST_DATADIR "example.14bits.bgen",
+                  "prefetch.tmp/example.14bits.bgen.metafile", 0);
+    test_no_reads(TEST_DATADIR "example.14bits.bgen",
+                  "prefetch.tmp/example.14bits.bgen.metafile", 1);
+    return cass_status();
+}
+
+static void compare(struct bgen_genotype* vg, struct bgen_genotype* expected,
+                    uint32_t nsamples)
+{
+    unsigned ncombs = bgen_genotype_ncombs(expected);
+    cass_equal_int(bgen_genotype_ncombs(vg), ncombs);
+
+    double* probs = malloc((size_t)nsamples * ncombs * sizeof(double));
+    double* eprobs = malloc((size_t)nsamples * ncombs * sizeof(double));
+    cass_equal_int(bgen_genotype_read(vg, probs), 0);
+    cass_equal_int(bgen_genotype_read(expected, eprobs), 0);
+    for (size_t i = 0; i < (size_t)nsamples * ncombs; ++i)
+        cass_cond(same_probability(probs[i], eprobs[i]));
+
+    free(eprobs);
+    free(probs);
+}
+
+void test_prefetch(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    cass_equal_int(bgen_file_prefetch(bgen, offsets, nvariants), 0);
+    cass_equal_int(bgen_file_prefetch(bgen, offsets + nvariants / 2, 1), 0);
+    cass_equal_int(bgen_file_prefetch(bgen, offsets, 0), 0);
+
+    /* Sparse offsets are prefetched one block at a time. */
+    uint64_t sparse[] = {offsets[0], offsets[nvariants / 2], offsets[nvariants - 1]};
+    cass_equal_int(bgen_file_prefetch(bgen, sparse, 3), 0);
+
+    /* Out of order offsets are prefetched one at a time. */
+    uint64_t reversed[] = {offsets[nvariants - 1], offsets[0]};
+    cass_equal_int(bgen_file_prefetch(bgen, reversed, 2), 0);
+
+    /* Nothing is read: a wrong offset is only a useless hint. */
+    uint64_t wrong = UINT64_MAX / 2;
+    cass_equal_int(bgen_file_prefetch(bgen, &wrong, 1), 0);
+
+    struct bgen_reader* reader = bgen_reader_create(bgen);
+    cass_cond(reader != NULL);
+
+    unsigned const windows[] = {1, 3, 64};
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); ++w) {
+        bgen_reader_stream(reader, offsets, nvariants, windows[w]);
+        for (uint32_t v = 0; v < nvariants; ++v) {
+            /* Going back once in a while must not break the stream. */
+            if (v % 5 == 4) {
+                struct bgen_genotype* vg = bgen_reader_open_genotype(reader, offsets[v - 2]);
+                cass_cond(vg != NULL);
+                bgen_genotype_close(vg);
+            }
+            struct bgen_genotype* vg = bgen_reader_open_genotype(reader, offsets[v]);
+            struct bgen_genotype* expected = bgen_file_open_genotype(bgen, offsets[v]);
+            cass_cond(vg != NULL);
+            cass_cond(expected != NULL);
+            compare(vg, expected, nsamples);
+            bgen_genotype_close(expected);
+            bgen_genotype_close(vg);
+        }
+    }
+    bgen_reader_stream(reader, NULL, 0, 0);
+
+    bgen_reader_destroy(reader);
+    free(offsets);
+    bgen_file_close(bgen);
+}
+
+#if defined(__linux__)
+/* Read system calls of the process so far, including those made to count them. */
+static uint64_t read_syscalls(void)
+{
+    uint64_t syscr = 0;
+    char     line[64];
+    FILE*    fp = fopen("/proc/self/io", "r");
+    cass_cond(fp != NULL);
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL)
+        if (sscanf(line, "syscr: %" SCNu64, &syscr) == 1)
+            break;
+    if (fp != NULL)
+        fclose(fp);
+    return syscr;
+}
+
+/* Kilobytes of the mappings of `filepath` that are in the page tables of the process. */
+static uint64_t resident_kb(char const* filepath)
+{
+    char const* name = strrchr(filepath, '/');
+    size_t      length = strlen(name);
+    uint64_t    total = 0;
+    bool        inside = false;
+    char        line[4096];
+    FILE*       fp = fopen("/proc/self/smaps", "r");
+    cass_cond(fp != NULL);
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        size_t n = strcspn(line, "\n");
+        line[n] = '\0';
+        uint64_t kb = 0;
+        /* Each mapping starts with its address range, in lowercase hexadecimal. */
+        if ((line[0] >= '0' && line[0] <= '9') || (line[0] >= 'a' && line[0] <= 'f'))
+            inside = n >= length && strcmp(line + n - length, name) == 0;
+        else if (inside && sscanf(line, "Rss: %" SCNu64, &kb) == 1)
+            total += kb;
+    }
+    if (fp != NULL)
+        fclose(fp);
+    return total;
+}
+#endif
+
+/* Prefetching must not wait on the disk: the file is neither read nor, if mapped, touched. */
+void test_no_reads(char const* filepath, char const* metafile_filepath, int mmap)
+{
+#if defined(__linux__)
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    bgen_file_close(bgen);
+
+    /* A fresh handler, with no page of the mapping touched yet. */
+    bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+    cass_cond(resident_kb(filepath) == 0);
+
+    uint64_t sparse[] = {offsets[0], offsets[nvariants / 2], offsets[nvariants - 1]};
+    uint64_t before = read_syscalls();
+    uint64_t const cost = read_syscalls() - before;
+
+    before = read_syscalls();
+    cass_equal_int(bgen_file_prefetch(bgen, offsets, nvariants), 0);
+    cass_equal_int(bgen_file_prefetch(bgen, sparse, 3), 0);
+    cass_cond(read_syscalls() - before == cost);
+    cass_cond(resident_kb(filepath) == 0);
+
+    free(offsets);
+    bgen_file_close(bgen);
+#endif
+}
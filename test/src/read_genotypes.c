@@ -0,0 +1,108 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_read_genotypes(char const* filepath, char const* metafile_filepath);
+void test_read_genotypes_default(void);
+
+int main(void)
+{
+    test_read_genotypes(TEST_DATADIR "complex.23bits.bgen",
+                        "read_genotypes.tmp/complex.23bits.bgen.metafile");
+    test_read_genotypes(TEST_DATADIR "haplotypes.bgen",
+                        "read_genotypes.tmp/haplotypes.bgen.metafile");
+    test_read_genotypes_default();
+    return cass_status();
+}
+
+void test_read_genotypes(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    unsigned ncombs = 0;
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        if (bgen_genotype_ncombs(vg) > ncombs)
+            ncombs = bgen_genotype_ncombs(vg);
+        bgen_genotype_close(vg);
+    }
+
+    size_t  size = (size_t)nvariants * nsamples * ncombs;
+    double* vmajor = malloc(size * sizeof(double));
+    double* smajor = malloc(size * sizeof(double));
+    float*  vmajor32 = malloc(size * sizeof(float));
+
+    struct bgen_read_options options = {ncombs, false, 1, NULL, 0};
+    cass_equal_int(bgen_file_read_genotypes(bgen, offsets, nvariants, vmajor, &options), 0);
+    cass_equal_int(bgen_file_read_genotypes32(bgen, offsets, nvariants, vmajor32, &options), 0);
+    options.sample_major = true;
+    cass_equal_int(bgen_file_read_genotypes64(bgen, offsets, nvariants, smajor, &options), 0);
+
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        unsigned              vncombs = bgen_genotype_ncombs(vg);
+        double*               probs = malloc(nsamples * vncombs * sizeof(double));
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+
+        for (uint32_t s = 0; s < nsamples; ++s) {
+            double const* vrow = vmajor + ((size_t)v * nsamples + s) * ncombs;
+            float const*  vrow32 = vmajor32 + ((size_t)v * nsamples + s) * ncombs;
+            double const* srow = smajor + ((size_t)s * nvariants + v) * ncombs;
+            for (unsigned c = 0; c < ncombs; ++c) {
+                double p = c < vncombs ? probs[s * vncombs + c] : NAN;
+                cass_cond(same_probability(vrow[c], p));
+                cass_cond(same_probability(srow[c], p));
+                cass_cond(same_probability(vrow32[c], (float)p));
+            }
+        }
+
+        free(probs);
+        bgen_genotype_close(vg);
+    }
+
+    if (ncombs > 1) {
+        options.ncombs = ncombs - 1;
+        cass_equal_int(bgen_file_read_genotypes(bgen, offsets, nvariants, vmajor, &options), 1);
+    }
+
+    free(vmajor);
+    free(smajor);
+    free(vmajor32);
+    free(offsets);
+    bgen_file_close(bgen);
+}
+
+void test_read_genotypes_default(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "example.14bits.bgen");
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets =
+        read_offsets(bgen, "read_genotypes.tmp/example.14bits.bgen.metafile", &nvariants);
+    uint32_t nsamples = bgen_file_nsamples(bgen);
+
+    double* matrix = malloc((size_t)nvariants * nsamples * 3 * sizeof(double));
+    cass_equal_int(bgen_file_read_genotypes(bgen, offsets, nvariants, matrix, NULL), 0);
+
+    double* probs = malloc(nsamples * 3 * sizeof(double));
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        for (size_t j = 0; j < nsamples * 3; ++j)
+            cass_cond(same_probability(matrix[(size_t)v * nsamples * 3 + j], probs[j]));
+        bgen_genotype_close(vg);
+    }
+
+    free(probs);
+    free(matrix);
+    free(offsets);
+    bgen_file_close(bgen);
+}
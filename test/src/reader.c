@@ -0,0 +1,135 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_reader(char const* filepath, char const* reference, char const* metafile_filepath);
+void test_short_frame(void);
+
+int main(void)
+{
+    test_reader(TEST_DATADIR "example.14bits.zstd.bgen", TEST_DATADIR "example.14bits.bgen",
+                "reader.tmp/example.14bits.zstd.bgen.metafile");
+    test_reader(TEST_DATADIR "complex.23bits.zstd.bgen", TEST_DATADIR "complex.23bits.bgen",
+                "reader.tmp/complex.23bits.zstd.bgen.metafile");
+    test_reader(TEST_DATADIR "complex.23bits.bgen", TEST_DATADIR "complex.23bits.bgen",
+                "reader.tmp/complex.23bits.bgen.metafile");
+    test_reader(TEST_DATADIR "haplotypes.bgen", TEST_DATADIR "haplotypes.bgen",
+                "reader.tmp/haplotypes.bgen.metafile");
+    test_short_frame();
+    return cass_status();
+}
+
+/* Both files hold the same variants, possibly compressed with different methods. */
+void test_reader(char const* filepath, char const* reference, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    struct bgen_file* mapped = bgen_file_open_mmap(filepath);
+    struct bgen_file* ref = bgen_file_open(reference);
+    cass_cond(bgen != NULL);
+    cass_cond(mapped != NULL);
+    cass_cond(ref != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nref = 0;
+    uint64_t* ref_offsets = read_offsets(ref, "reader.tmp/reference.metafile", &nref);
+    cass_equal_int(nvariants, nref);
+
+    struct bgen_reader* reader = bgen_reader_create(bgen);
+    struct bgen_reader* mreader = bgen_reader_create(mapped);
+    cass_cond(reader != NULL);
+    cass_cond(mreader != NULL);
+
+    uint32_t nsamples = bgen_file_nsamples(bgen);
+    /* Go through the variants twice so that every context is reused. */
+    for (uint32_t k = 0; k < 2 * nvariants; ++k) {
+        uint32_t              v = k % nvariants;
+        struct bgen_genotype* vg = bgen_reader_open_genotype(reader, offsets[v]);
+        struct bgen_genotype* mvg = bgen_reader_open_genotype(mreader, offsets[v]);
+        struct bgen_genotype* rvg = bgen_file_open_genotype(ref, ref_offsets[v]);
+        cass_cond(vg != NULL);
+        cass_cond(mvg != NULL);
+        cass_cond(rvg != NULL);
+
+        unsigned ncombs = bgen_genotype_ncombs(rvg);
+        cass_equal_int(bgen_genotype_ncombs(vg), ncombs);
+        cass_equal_int(bgen_genotype_ncombs(mvg), ncombs);
+
+        size_t  n = (size_t)nsamples * ncombs;
+        double* probs = malloc(n * sizeof(double));
+        double* mprobs = malloc(n * sizeof(double));
+        double* rprobs = malloc(n * sizeof(double));
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read(mvg, mprobs), 0);
+        cass_equal_int(bgen_genotype_read(rvg, rprobs), 0);
+
+        for (size_t i = 0; i < n; ++i) {
+            cass_cond(same_probability(probs[i], rprobs[i]));
+            cass_cond(same_probability(mprobs[i], rprobs[i]));
+        }
+
+        free(rprobs);
+        free(mprobs);
+        free(probs);
+        bgen_genotype_close(rvg);
+        bgen_genotype_close(mvg);
+        bgen_genotype_close(vg);
+    }
+
+    bgen_reader_destroy(mreader);
+    bgen_reader_destroy(reader);
+    free(ref_offsets);
+    free(offsets);
+    bgen_file_close(ref);
+    bgen_file_close(mapped);
+    bgen_file_close(bgen);
+}
+
+/* A zstd frame shorter than the size its block declares is an error, rather than leaving
+ * the previous variant's bytes in the recycled chunk. */
+void test_short_frame(void)
+{
+    struct bgen_file* bgen = bgen_file_open(TEST_DATADIR "example.14bits.zstd.bgen");
+    cass_cond(bgen != NULL);
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, "reader.tmp/short_frame.bgen.metafile", &nvariants);
+    bgen_file_close(bgen);
+
+    FILE* src = fopen(TEST_DATADIR "example.14bits.zstd.bgen", "rb");
+    FILE* dst = fopen("reader.tmp/short_frame.bgen", "wb");
+    cass_cond(src != NULL && dst != NULL);
+    int c = 0;
+    while ((c = fgetc(src)) != EOF)
+        fputc(c, dst);
+    fclose(src);
+    fclose(dst);
+
+    /* Declare one more uncompressed byte than the frame of the second variant holds. */
+    uint32_t length = 0;
+    dst = fopen("reader.tmp/short_frame.bgen", "r+b");
+    cass_cond(dst != NULL);
+    cass_equal_int(fseek(dst, (long)offsets[1] + 4, SEEK_SET), 0);
+    cass_cond(fread(&length, sizeof(length), 1, dst) == 1);
+    length += 1;
+    cass_equal_int(fseek(dst, (long)offsets[1] + 4, SEEK_SET), 0);
+    cass_cond(fwrite(&length, sizeof(length), 1, dst) == 1);
+    fclose(dst);
+
+    bgen = bgen_file_open("reader.tmp/short_frame.bgen");
+    cass_cond(bgen != NULL);
+    struct bgen_reader* reader = bgen_reader_create(bgen);
+    cass_cond(reader != NULL);
+
+    struct bgen_genotype* vg = bgen_reader_open_genotype(reader, offsets[0]);
+    cass_cond(vg != NULL);
+    bgen_genotype_close(vg);
+    cass_cond(bgen_reader_open_genotype(reader, offsets[1]) == NULL);
+    cass_cond(bgen_file_open_genotype(bgen, offsets[1]) == NULL);
+
+    bgen_reader_destroy(reader);
+    bgen_file_close(bgen);
+    free(offsets);
+}
@@ -0,0 +1,102 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_scan(char const* filepath, char const* metafile_filepath, int mmap);
+void test_stop_early(char const* filepath, char const* metafile_filepath);
+
+int main(void)
+{
+    test_scan(TEST_DATADIR "example.14bits.bgen", "scan.tmp/example.14bits.bgen.metafile", 0);
+    test_scan(TEST_DATADIR "example.14bits.bgen", "scan.tmp/example.14bits.bgen.metafile", 1);
+    test_scan(TEST_DATADIR "example.14bits.zstd.bgen",
+              "scan.tmp/example.14bits.zstd.bgen.metafile", 0);
+    test_scan(TEST_DATADIR "complex.23bits.uncompressed.bgen",
+              "scan.tmp/complex.23bits.uncompressed.bgen.metafile", 0);
+    test_scan(TEST_DATADIR "haplotypes.bgen", "scan.tmp/haplotypes.bgen.metafile", 1);
+    test_stop_early(TEST_DATADIR "example.14bits.bgen", "scan.tmp/example.14bits.bgen.metafile");
+    return cass_status();
+}
+
+void test_scan(char const* filepath, char const* metafile_filepath, int mmap)
+{
+    struct bgen_file* bgen = mmap ? bgen_file_open_mmap(filepath) : bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+    uint32_t  nsamples = bgen_file_nsamples(bgen);
+
+    /* Fewer buffers than variants, so that the reader has to wait for the caller. */
+    struct bgen_scan_options const options[] = {{1, 1, 1}, {3, 2, 4}, {2, 4, 64}};
+    for (size_t k = 0; k < sizeof(options) / sizeof(options[0]); ++k) {
+        struct bgen_scan* scan = bgen_scan_create(bgen, offsets, nvariants, options + k);
+        cass_cond(scan != NULL);
+
+        for (uint32_t v = 0; v < nvariants; ++v) {
+            double const*         probs = NULL;
+            struct bgen_genotype* vg = bgen_scan_next(scan, &probs);
+            struct bgen_genotype* expected = bgen_file_open_genotype(bgen, offsets[v]);
+            cass_cond(vg != NULL);
+            cass_cond(expected != NULL);
+
+            unsigned ncombs = bgen_genotype_ncombs(expected);
+            cass_equal_int(bgen_genotype_ncombs(vg), ncombs);
+
+            double* eprobs = malloc((size_t)nsamples * ncombs * sizeof(double));
+            cass_equal_int(bgen_genotype_read(expected, eprobs), 0);
+            for (size_t i = 0; i < (size_t)nsamples * ncombs; ++i)
+                cass_cond(same_probability(probs[i], eprobs[i]));
+
+            free(eprobs);
+            bgen_genotype_close(expected);
+        }
+
+        double const* probs = NULL;
+        cass_cond(bgen_scan_next(scan, &probs) == NULL);
+        cass_equal_int(bgen_scan_close(scan), 0);
+    }
+
+    /* A bad offset halfway through fails the scan. */
+    offsets[nvariants / 2] = UINT64_MAX / 2;
+    struct bgen_scan* scan = bgen_scan_create(bgen, offsets, nvariants, NULL);
+    cass_cond(scan != NULL);
+    uint32_t      ndelivered = 0;
+    double const* probs = NULL;
+    while (bgen_scan_next(scan, &probs) != NULL)
+        ++ndelivered;
+    cass_equal_int(ndelivered, nvariants / 2);
+    cass_equal_int(bgen_scan_close(scan), 1);
+
+    free(offsets);
+    bgen_file_close(bgen);
+}
+
+void test_stop_early(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    uint32_t  nvariants = 0;
+    uint64_t* offsets = read_offsets(bgen, metafile_filepath, &nvariants);
+
+    struct bgen_scan_options options = {2, 2, 2};
+    struct bgen_scan*        scan = bgen_scan_create(bgen, offsets, nvariants, &options);
+    cass_cond(scan != NULL);
+
+    double const* probs = NULL;
+    for (uint32_t v = 0; v < 5; ++v)
+        cass_cond(bgen_scan_next(scan, &probs) != NULL);
+    cass_equal_int(bgen_scan_close(scan), 0);
+
+    /* Nothing to deliver. */
+    scan = bgen_scan_create(bgen, offsets, 0, NULL);
+    cass_cond(scan != NULL);
+    cass_cond(bgen_scan_next(scan, &probs) == NULL);
+    cass_equal_int(bgen_scan_close(scan), 0);
+
+    free(offsets);
+    bgen_file_close(bgen);
+}
@@ -0,0 +1,104 @@
+#include "bgen/bgen.h"
+#include "cass.h"
+#include "helpers.h"
+#include <math.h>
+#include <stdlib.h>
+
+void test_subset(char const* filepath, char const* metafile_filepath);
+
+int main(void)
+{
+    test_subset(TEST_DATADIR "example.14bits.bgen", "subset.tmp/example.14bits.bgen.metafile");
+    test_subset(TEST_DATADIR "complex.23bits.bgen", "subset.tmp/complex.23bits.bgen.metafile");
+    test_subset(TEST_DATADIR "haplotypes.bgen", "subset.tmp/haplotypes.bgen.metafile");
+    return cass_status();
+}
+
+/* Every third sample backwards, plus the first one twice. */
+static uint32_t* select_samples(uint32_t nsamples, uint32_t* nselected)
+{
+    uint32_t* samples = malloc(((size_t)nsamples / 3 + 3) * sizeof(uint32_t));
+    uint32_t  n = 0;
+    for (uint32_t s = nsamples; s > 0; s -= s > 3 ? 3 : s)
+        samples[n++] = s - 1;
+    samples[n++] = 0;
+    samples[n++] = 0;
+    *nselected = n;
+    return samples;
+}
+
+void test_subset(char const* filepath, char const* metafile_filepath)
+{
+    struct bgen_file* bgen = bgen_file_open(filepath);
+    cass_cond(bgen != NULL);
+
+    struct bgen_metafile* mf = bgen_metafile_create(bgen, metafile_filepath, 1, 0);
+    cass_cond(mf != NULL);
+
+    struct bgen_partition const* partition = bgen_metafile_read_partition(mf, 0);
+    uint32_t                     nvariants = bgen_partition_nvariants(partition);
+    uint32_t                     nsamples = bgen_file_nsamples(bgen);
+
+    uint64_t* offsets = malloc(nvariants * sizeof(uint64_t));
+    unsigned  ncombs = 0;
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        offsets[v] = bgen_partition_get_variant(partition, v)->genotype_offset;
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        if (bgen_genotype_ncombs(vg) > ncombs)
+            ncombs = bgen_genotype_ncombs(vg);
+        bgen_genotype_close(vg);
+    }
+
+    uint32_t  nselected = 0;
+    uint32_t* samples = select_samples(nsamples, &nselected);
+
+    size_t  size = (size_t)nvariants * nselected * ncombs;
+    double* matrix = malloc(size * sizeof(double));
+    struct bgen_read_options options = {ncombs, false, 2, samples, nselected};
+    cass_equal_int(bgen_file_read_genotypes(bgen, offsets, nvariants, matrix, &options), 0);
+
+    for (uint32_t v = 0; v < nvariants; ++v) {
+        struct bgen_genotype* vg = bgen_file_open_genotype(bgen, offsets[v]);
+        unsigned              vncombs = bgen_genotype_ncombs(vg);
+        double*               probs = malloc((size_t)nsamples * vncombs * sizeof(double));
+        float*                probs32 = malloc((size_t)nsamples * vncombs * sizeof(float));
+        double*               subset = malloc((size_t)nselected * vncombs * sizeof(double));
+        float*                subset32 = malloc((size_t)nselected * vncombs * sizeof(float));
+
+        cass_equal_int(bgen_genotype_read(vg, probs), 0);
+        cass_equal_int(bgen_genotype_read32(vg, probs32), 0);
+        cass_equal_int(bgen_genotype_read_subset(vg, samples, nselected, subset), 0);
+        cass_equal_int(bgen_genotype_read_subset32(vg, samples, nselected, subset32), 0);
+
+        for (uint32_t i = 0; i < nselected; ++i) {
+            double const* row = matrix + ((size_t)v * nselected + i) * ncombs;
+            double const* row64 = subset + (size_t)i * vncombs;
+            float const*  row32 = subset32 + (size_t)i * vncombs;
+            size_t        j = (size_t)samples[i] * vncombs;
+            for (unsigned c = 0; c < ncombs; ++c) {
+                double p = c < vncombs ? probs[j + c] : NAN;
+                cass_cond(same_probability(row[c], p));
+                if (c < vncombs) {
+                    cass_cond(same_probability(row64[c], p));
+                    cass_cond(same_probability(row32[c], probs32[j + c]));
+                }
+            }
+        }
+
+        uint32_t wrong = nsamples;
+        cass_equal_int(bgen_genotype_read_subset(vg, &wrong, 1, subset), 1);
+
+        free(subset32);
+        free(subset);
+        free(probs32);
+        free(probs);
+        bgen_genotype_close(vg);
+    }
+
+    free(matrix);
+    free(samples);
+    free(offsets);
+    bgen_partition_destroy(partition);
+    cass_equal_int(bgen_metafile_close(mf), 0);
+    bgen_file_close(bgen);
+}